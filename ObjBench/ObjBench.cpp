@@ -0,0 +1,399 @@
+#include "pch.h"
+#include "ObjLoader.h"
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <sys/resource.h>
+
+// Benchmark de import de OBJ. Gera um corpus sintetico (1 MB, 100 MB e 1 GB;
+// triangulos e quads; com e sem normais e UVs), roda os importadores sobre cada
+// arquivo e escreve MB/s, vertices/s e pico de RSS em JSON.
+//
+// ObjBench [--corpus dir] [--sizes 1,100,1024] [--parsers mapped,parallel,streaming,stream]
+//          [--iterations n] [--stream-budget MB] [--out arquivo.json] [--regenerate]
+//
+// Um importador que falha vira uma entrada com "error" e os outros continuam; o
+// JSON sai do mesmo jeito e o codigo de saida passa a ser 1.
+
+namespace
+{
+    struct CorpusFile
+    {
+        std::string Path;
+        size_t TargetBytes = 0;
+        bool Quads = false;
+        bool Attributes = false;   // vt e vn em todos os vertices
+    };
+
+    struct ParserRun
+    {
+        std::string Parser;
+        double Seconds = 0.0;
+        size_t VertexCount = 0;
+        size_t IndexCount = 0;
+        size_t PeakRssBytes = 0;
+        size_t MemoryBudget = 0;   // so no streaming
+        std::string Error;
+    };
+
+    struct Options
+    {
+        std::string CorpusDir = "obj-bench-corpus";
+        std::vector<size_t> SizesMB = { 1, 100, 1024 };
+        std::vector<std::string> Parsers = { "mapped", "parallel", "streaming" };
+        int Iterations = 0;        // 0 = 3 abaixo de 256 MB, 1 acima
+        size_t StreamBudgetMB = 0; // 0 = o padrao de ObjStreamOptions, ou metade do arquivo se for maior
+        std::string OutPath;       // vazio = stdout
+        bool Regenerate = false;
+    };
+
+    std::vector<std::string> SplitList(const std::string& list)
+    {
+        std::vector<std::string> items;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    Options ParseOptions(int argc, char** argv)
+    {
+        Options options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::runtime_error("Falta o valor de " + arg);
+                return argv[++i];
+            };
+            if (arg == "--corpus") options.CorpusDir = value();
+            else if (arg == "--sizes") {
+                options.SizesMB.clear();
+                for (const std::string& size : SplitList(value())) options.SizesMB.push_back(std::stoull(size));
+            }
+            else if (arg == "--parsers") options.Parsers = SplitList(value());
+            else if (arg == "--iterations") options.Iterations = std::stoi(value());
+            else if (arg == "--stream-budget") options.StreamBudgetMB = std::stoull(value());
+            else if (arg == "--out") options.OutPath = value();
+            else if (arg == "--regenerate") options.Regenerate = true;
+            else throw std::runtime_error("Opcao desconhecida: " + arg);
+        }
+        return options;
+    }
+
+    // Gerador deterministico (LCG), para o corpus sair igual em toda maquina.
+    class Lcg
+    {
+    public:
+        float Next()
+        {
+            m_state = m_state * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<float>(m_state >> 40) / static_cast<float>(1u << 24);
+        }
+
+    private:
+        uint64_t m_state = 0x853C49E6748FEA9Bull;
+    };
+
+    void AppendFloat(std::string& out, float value)
+    {
+        char buffer[32];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 6);
+        out.append(buffer, result.ptr);
+    }
+
+    void AppendIndex(std::string& out, size_t value)
+    {
+        char buffer[24];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+
+    void AppendCorner(std::string& out, size_t index, bool attributes)
+    {
+        out += ' ';
+        AppendIndex(out, index);
+        if (attributes) {
+            out += '/';
+            AppendIndex(out, index);
+            out += '/';
+            AppendIndex(out, index);
+        }
+    }
+
+    // Grade de retalhos 16x16 lado a lado ate passar de TargetBytes; cada retalho
+    // escreve seus vertices e em seguida as faces, como um exportador faria.
+    void GenerateObj(const CorpusFile& file)
+    {
+        const size_t patchQuads = 16;
+        const size_t patchVertices = patchQuads + 1;
+
+        std::FILE* out = std::fopen(file.Path.c_str(), "wb");
+        if (!out) throw std::runtime_error("Nao foi possivel criar " + file.Path);
+
+        Lcg random;
+        std::string text = "# ObjBench corpus\no synthetic\n";
+        size_t written = 0;
+        size_t baseVertex = 1;
+        for (size_t patch = 0; written + text.size() < file.TargetBytes; ++patch) {
+            const float originX = static_cast<float>(patch % 64) * patchQuads;
+            const float originZ = static_cast<float>(patch / 64) * patchQuads;
+            for (size_t i = 0; i < patchVertices; ++i) {
+                for (size_t j = 0; j < patchVertices; ++j) {
+                    text += "v ";
+                    AppendFloat(text, originX + i);
+                    text += ' ';
+                    AppendFloat(text, random.Next());
+                    text += ' ';
+                    AppendFloat(text, originZ + j);
+                    text += '\n';
+                    if (file.Attributes) {
+                        text += "vt ";
+                        AppendFloat(text, static_cast<float>(i) / patchQuads);
+                        text += ' ';
+                        AppendFloat(text, static_cast<float>(j) / patchQuads);
+                        text += "\nvn ";
+                        AppendFloat(text, random.Next() - 0.5f);
+                        text += " 1.000000 ";
+                        AppendFloat(text, random.Next() - 0.5f);
+                        text += '\n';
+                    }
+                }
+            }
+            for (size_t i = 0; i < patchQuads; ++i) {
+                for (size_t j = 0; j < patchQuads; ++j) {
+                    const size_t a = baseVertex + i * patchVertices + j;
+                    const size_t b = a + 1;
+                    const size_t c = a + patchVertices;
+                    const size_t d = c + 1;
+                    if (file.Quads) {
+                        text += 'f';
+                        AppendCorner(text, a, file.Attributes);
+                        AppendCorner(text, b, file.Attributes);
+                        AppendCorner(text, d, file.Attributes);
+                        AppendCorner(text, c, file.Attributes);
+                        text += '\n';
+                    }
+                    else {
+                        text += 'f';
+                        AppendCorner(text, a, file.Attributes);
+                        AppendCorner(text, b, file.Attributes);
+                        AppendCorner(text, d, file.Attributes);
+                        text += "\nf";
+                        AppendCorner(text, a, file.Attributes);
+                        AppendCorner(text, d, file.Attributes);
+                        AppendCorner(text, c, file.Attributes);
+                        text += '\n';
+                    }
+                }
+            }
+            baseVertex += patchVertices * patchVertices;
+
+            if (text.size() >= (size_t(4) << 20)) {
+                if (std::fwrite(text.data(), 1, text.size(), out) != text.size()) {
+                    std::fclose(out);
+                    throw std::runtime_error("Falha ao gravar " + file.Path);
+                }
+                written += text.size();
+                text.clear();
+            }
+        }
+        const bool ok = std::fwrite(text.data(), 1, text.size(), out) == text.size();
+        if (std::fclose(out) != 0 || !ok) throw std::runtime_error("Falha ao gravar " + file.Path);
+    }
+
+    std::vector<CorpusFile> PrepareCorpus(const Options& options)
+    {
+        std::filesystem::create_directories(options.CorpusDir);
+
+        std::vector<CorpusFile> corpus;
+        for (size_t sizeMB : options.SizesMB) {
+            for (int quads = 0; quads < 2; ++quads) {
+                for (int attributes = 0; attributes < 2; ++attributes) {
+                    CorpusFile file;
+                    file.TargetBytes = sizeMB << 20;
+                    file.Quads = quads != 0;
+                    file.Attributes = attributes != 0;
+                    file.Path = (std::filesystem::path(options.CorpusDir) /
+                        (std::to_string(sizeMB) + "mb_" + (file.Quads ? "quad" : "tri") +
+                         (file.Attributes ? "_vtn" : "_v") + ".obj")).string();
+
+                    std::error_code ec;
+                    const uintmax_t size = std::filesystem::file_size(file.Path, ec);
+                    if (options.Regenerate || ec || size < file.TargetBytes) {
+                        std::cerr << "gerando " << file.Path << "\n";
+                        GenerateObj(file);
+                    }
+                    corpus.push_back(file);
+                }
+            }
+        }
+        return corpus;
+    }
+
+    // Zera o pico de RSS do processo, para medir cada import separadamente.
+    // Fora do Linux o pico e o do processo inteiro.
+    void ResetPeakRss()
+    {
+#ifdef __linux__
+        std::ofstream clearRefs("/proc/self/clear_refs");
+        clearRefs << "5";
+#endif
+    }
+
+    size_t PeakRssBytes()
+    {
+#ifdef __linux__
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 6, "VmHWM:") == 0) return std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+        }
+#endif
+        rusage usage = {};
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<size_t>(usage.ru_maxrss);
+#else
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+    }
+
+    void RunParser(const std::string& parser, const std::string& path, const ObjStreamOptions& streamOptions,
+        size_t& vertexCount, size_t& indexCount)
+    {
+        if (parser == "streaming") {
+            ObjStreamStats stats = load_model_from_obj_streaming(path, [](const ObjStreamBlock&) {}, streamOptions);
+            vertexCount = stats.VertexCount;
+            indexCount = stats.IndexCount;
+            return;
+        }
+
+        Model model;
+        if (parser == "mapped") model = load_model_from_obj(path);
+        else if (parser == "parallel") model = load_model_from_obj_parallel(path);
+        else if (parser == "stream") model = load_model_from_obj_stream(path);
+        else throw std::runtime_error("Parser desconhecido: " + parser);
+        vertexCount = model.vertices.size();
+        indexCount = model.indices.size();
+    }
+
+    // Orcamento do streaming: o escolhido na linha de comando ou, por padrao, o de
+    // ObjStreamOptions aumentado para metade do arquivo, para que o import grande
+    // nao passe o tempo trocando paginas de posicoes e normais com o disco.
+    ObjStreamOptions StreamOptionsFor(const Options& options, size_t fileBytes)
+    {
+        ObjStreamOptions streamOptions;
+        if (options.StreamBudgetMB > 0) streamOptions.MemoryBudget = options.StreamBudgetMB << 20;
+        else streamOptions.MemoryBudget = std::max(streamOptions.MemoryBudget, fileBytes / 2);
+        return streamOptions;
+    }
+
+    // Melhor tempo entre as iteracoes; o pico de RSS e o maior visto. Uma excecao
+    // do importador fica em run.Error.
+    ParserRun Measure(const std::string& parser, const std::string& path, const ObjStreamOptions& streamOptions, int iterations)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        ParserRun run;
+        run.Parser = parser;
+        run.Seconds = std::numeric_limits<double>::max();
+        if (parser == "streaming") run.MemoryBudget = streamOptions.MemoryBudget;
+        try {
+            for (int i = 0; i < iterations; ++i) {
+                ResetPeakRss();
+                auto start = Clock::now();
+                RunParser(parser, path, streamOptions, run.VertexCount, run.IndexCount);
+                run.Seconds = std::min(run.Seconds, std::chrono::duration<double>(Clock::now() - start).count());
+                run.PeakRssBytes = std::max(run.PeakRssBytes, PeakRssBytes());
+            }
+        }
+        catch (const std::exception& e) {
+            run.Error = e.what();
+        }
+        return run;
+    }
+
+    std::string JsonString(const std::string& value)
+    {
+        std::string out = "\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        const Options options = ParseOptions(argc, argv);
+        const std::vector<CorpusFile> corpus = PrepareCorpus(options);
+
+        bool failed = false;
+        std::ostringstream json;
+        json << std::fixed << std::setprecision(3);
+        json << "{\n  \"results\": [";
+        for (size_t f = 0; f < corpus.size(); ++f) {
+            const CorpusFile& file = corpus[f];
+            const size_t fileBytes = static_cast<size_t>(std::filesystem::file_size(file.Path));
+            const int iterations = options.Iterations > 0 ? options.Iterations
+                                                          : (fileBytes < (size_t(256) << 20) ? 3 : 1);
+
+            json << (f ? "," : "") << "\n    {\n";
+            json << "      \"file\": " << JsonString(file.Path) << ",\n";
+            json << "      \"bytes\": " << fileBytes << ",\n";
+            json << "      \"faces\": \"" << (file.Quads ? "quad" : "triangle") << "\",\n";
+            json << "      \"normals\": " << (file.Attributes ? "true" : "false") << ",\n";
+            json << "      \"uvs\": " << (file.Attributes ? "true" : "false") << ",\n";
+            json << "      \"iterations\": " << iterations << ",\n";
+            json << "      \"parsers\": [";
+            const ObjStreamOptions streamOptions = StreamOptionsFor(options, fileBytes);
+            for (size_t p = 0; p < options.Parsers.size(); ++p) {
+                std::cerr << options.Parsers[p] << ": " << file.Path << "\n";
+                const ParserRun run = Measure(options.Parsers[p], file.Path, streamOptions, iterations);
+                const double megabytes = fileBytes / (1024.0 * 1024.0);
+                json << (p ? "," : "") << "\n        { ";
+                json << "\"parser\": " << JsonString(run.Parser) << ", ";
+                if (run.MemoryBudget > 0) json << "\"memoryBudgetBytes\": " << run.MemoryBudget << ", ";
+                if (!run.Error.empty()) {
+                    std::cerr << "ObjBench: " << run.Parser << ": " << run.Error << "\n";
+                    json << "\"error\": " << JsonString(run.Error) << " }";
+                    failed = true;
+                    continue;
+                }
+                json << "\"seconds\": " << run.Seconds << ", ";
+                json << "\"mbPerSecond\": " << megabytes / run.Seconds << ", ";
+                json << "\"vertices\": " << run.VertexCount << ", ";
+                json << "\"indices\": " << run.IndexCount << ", ";
+                json << "\"verticesPerSecond\": " << run.VertexCount / run.Seconds << ", ";
+                json << "\"peakRssBytes\": " << run.PeakRssBytes << " }";
+            }
+            json << "\n      ]\n    }";
+        }
+        json << "\n  ]\n}\n";
+
+        if (options.OutPath.empty()) {
+            std::cout << json.str();
+        }
+        else {
+            std::ofstream out(options.OutPath, std::ios::binary | std::ios::trunc);
+            out << json.str();
+            if (!out) throw std::runtime_error("Nao foi possivel gravar " + options.OutPath);
+        }
+        return failed ? 1 : 0;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "ObjBench: " << e.what() << "\n";
+        return 1;
+    }
+}
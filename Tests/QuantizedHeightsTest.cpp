@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "Terrain.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+// Erro das alturas quantizadas: um campo fBm quantizado e depois editado com
+// pinceis e crateras precisa decodificar a ate MaxError() das alturas em float,
+// antes e depois de Store ampliar a faixa dos blocos. Tambem confere que as
+// edicoes do Terrain quantizado so mudam as amostras da regiao que devolvem.
+
+namespace
+{
+    int failures = 0;
+
+    void Check(bool ok, const char* what)
+    {
+        if (!ok) {
+            std::printf("FALHOU: %s\n", what);
+            ++failures;
+        }
+    }
+
+    bool Same(float a, float b)
+    {
+        return std::memcmp(&a, &b, sizeof(float)) == 0;
+    }
+
+    // Maior |decodificada - origem| no mapa todo.
+    float MaxDifference(const QuantizedHeights& heights, const Terrain& source)
+    {
+        std::vector<float> row(heights.Cols());
+        float difference = 0.0f;
+        for (int i = 0; i < heights.Rows(); ++i) {
+            heights.DecodeRow(i, 0, heights.Cols(), row.data());
+            for (int j = 0; j < heights.Cols(); ++j) {
+                difference = std::max(difference, std::fabs(row[j] - source.Height(i, j)));
+            }
+        }
+        return difference;
+    }
+
+    // Grava em heights a regiao de source, como Terrain::StoreRegion; retorna quantos
+    // blocos foram recodificados.
+    size_t StoreFrom(QuantizedHeights& heights, const Terrain& source, const TerrainRegion& region)
+    {
+        std::vector<float> values;
+        for (int i = region.BeginI; i < region.EndI; ++i) {
+            for (int j = region.BeginJ; j < region.EndJ; ++j) values.push_back(source.Height(i, j));
+        }
+        return heights.Store(region.BeginI, region.BeginJ, region.EndI, region.EndJ, values.data()).size();
+    }
+
+    // Edicao numero 'stroke': rebaixa sempre o mesmo ponto (como segurar a tecla) e
+    // intercala levantar, suavizar, nivelar e crateras em outros lugares.
+    TerrainRegion ApplyEdit(Terrain& terrain, int stroke, const TerrainStamp& crater)
+    {
+        TerrainBrush brush;
+        brush.X = 12.0f;
+        brush.Z = -30.0f;
+        brush.Radius = 6.0f;
+        brush.Strength = 0.064f;
+        brush.Mode = TerrainBrushMode::Lower;
+        switch (stroke % 40) {
+        case 10:
+            brush.Mode = TerrainBrushMode::Raise;
+            brush.X = -80.0f + stroke * 0.25f;
+            brush.Radius = 20.0f;
+            brush.Strength = 3.0f;
+            break;
+        case 20:
+            brush.Mode = TerrainBrushMode::Smooth;
+            brush.Radius = 25.0f;
+            brush.Strength = 0.5f;
+            break;
+        case 30:
+            brush.Mode = TerrainBrushMode::Flatten;
+            brush.X = 90.0f;
+            brush.Radius = 30.0f;
+            brush.Strength = 0.8f;
+            brush.TargetHeight = 55.0f;
+            break;
+        case 39:
+            return terrain.ApplyStamp(crater, -40.0f + stroke * 0.1f, 60.0f);
+        }
+        return terrain.ApplyBrush(brush);
+    }
+}
+
+int main()
+{
+    const int rows = 257;
+    const int cols = 257;
+    const int strokes = 600;
+    NoiseSettings noise;
+    noise.Amplitude = 40.0f;
+    noise.Frequency = 1.0f / 60.0f;
+    const TerrainStamp crater = MakeCraterStamp(15.0f, 6.0f, 2.0f, 1.0f);
+
+    // 1. Quantizacao e edicoes contra as alturas em float.
+    Terrain source(512.0f, 512.0f, rows, cols, noise);
+    QuantizedHeights heights(source.Heights(), rows, cols);
+    Check(MaxDifference(heights, source) <= heights.MaxError(), "fBm quantizado dentro de MaxError");
+
+    std::vector<float> row(cols);
+    bool rowsMatch = true;
+    for (int i = 0; i < rows; ++i) {
+        heights.DecodeRow(i, 3, cols, row.data());
+        for (int j = 3; j < cols; ++j) rowsMatch = rowsMatch && Same(row[j - 3], heights.Height(i, j));
+    }
+    Check(rowsMatch, "DecodeRow igual a Height");
+
+    const float initialError = heights.MaxError();
+    size_t encoded = 0;
+    float worst = 0.0f;
+    bool withinError = true;
+    for (int stroke = 0; stroke < strokes; ++stroke) {
+        encoded += StoreFrom(heights, source, ApplyEdit(source, stroke, crater));
+        const float difference = MaxDifference(heights, source);
+        worst = std::max(worst, difference / heights.MaxError());
+        withinError = withinError && difference <= heights.MaxError();
+    }
+    Check(withinError, "alturas editadas dentro de MaxError");
+    Check(encoded > 0, "as edicoes ampliaram a faixa de algum bloco");
+    std::printf("QuantizedHeights: MaxError %.3f mm -> %.3f mm, %zu blocos recodificados, pior erro %.2f de MaxError\n",
+        initialError * 1e3f, heights.MaxError() * 1e3f, encoded, worst);
+
+    // 2. Terrain quantizado: fora da regiao devolvida nada muda, e as normais
+    // atualizadas nela sao as de um recalculo completo.
+    Terrain quantized(512.0f, 512.0f, rows, cols, noise);
+    quantized.Quantize();
+    quantized.ComputeNormals();
+    std::vector<float> before(size_t(rows) * cols);
+    bool outsideSame = true;
+    for (int stroke = 0; stroke < strokes; ++stroke) {
+        for (int i = 0; i < rows; ++i) quantized.ReadHeightRow(i, 0, cols, before.data() + size_t(i) * cols);
+        const TerrainRegion region = ApplyEdit(quantized, stroke, crater);
+        for (int i = 0; i < rows; ++i) {
+            for (int j = 0; j < cols; ++j) {
+                const bool inside = i >= region.BeginI && i < region.EndI && j >= region.BeginJ && j < region.EndJ;
+                if (!inside) outsideSame = outsideSame && Same(before[size_t(i) * cols + j], quantized.Height(i, j));
+            }
+        }
+        if (stroke % 10 == 9) quantized.UpdateNormals(quantized.TakeDirtyRegion());
+    }
+    quantized.UpdateNormals(quantized.TakeDirtyRegion());
+    Check(outsideSame, "edicoes quantizadas so mudam a regiao devolvida");
+    const std::vector<uint32_t> updated = quantized.PackedNormals();
+    quantized.ComputeNormals();
+    Check(updated == quantized.PackedNormals(), "normais atualizadas iguais ao recalculo completo");
+
+    if (failures == 0) std::printf("QuantizedHeightsTest: ok\n");
+    return failures == 0 ? 0 : 1;
+}
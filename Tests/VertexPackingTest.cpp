@@ -0,0 +1,179 @@
+#include "pch.h"
+#include "VertexPacking.h"
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+// Erro de ida e volta de PackVertex/UnpackVertex contra os limites documentados em
+// VertexPacking.h: posicao ate Scale / 65535 / 2 por eixo (mais o arredondamento do
+// float) e normal abaixo de 0.0001 rad. Cobre AABBs extremos e achatados, vertices
+// nos cantos e fora do AABB, e normais degeneradas, nao unitarias e nas dobras do
+// octaedro.
+
+namespace
+{
+    int failures = 0;
+
+    void Check(bool ok, const char* what)
+    {
+        if (!ok) {
+            std::printf("FALHOU: %s\n", what);
+            ++failures;
+        }
+    }
+
+    const float NormalAngleBound = 0.0001f;
+
+    bool Finite(const DirectX::XMFLOAT3& v)
+    {
+        return std::isfinite(v.x) && std::isfinite(v.y) && std::isfinite(v.z);
+    }
+
+    float Angle(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+    {
+        const float cx = a.y * b.z - a.z * b.y;
+        const float cy = a.z * b.x - a.x * b.z;
+        const float cz = a.x * b.y - a.y * b.x;
+        return std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), a.x * b.x + a.y * b.y + a.z * b.z);
+    }
+
+    MeshBounds BoundsOf(const std::vector<Vertex>& vertices)
+    {
+        MeshBounds bounds;
+        bounds.Min = bounds.Max = vertices.front().Pos;
+        for (const Vertex& vertex : vertices) {
+            bounds.Min = { std::min(bounds.Min.x, vertex.Pos.x), std::min(bounds.Min.y, vertex.Pos.y), std::min(bounds.Min.z, vertex.Pos.z) };
+            bounds.Max = { std::max(bounds.Max.x, vertex.Pos.x), std::max(bounds.Max.y, vertex.Pos.y), std::max(bounds.Max.z, vertex.Pos.z) };
+        }
+        return bounds;
+    }
+
+    // Confere cada vertice contra os limites, independente de MeasureVertexPackingError,
+    // e depois o proprio MeasureVertexPackingError.
+    void CheckVertices(const std::vector<Vertex>& vertices, const char* what)
+    {
+        const VertexQuantization quantization = MakeVertexQuantization(BoundsOf(vertices));
+        const float* scale = &quantization.Scale.x;
+        const float* bias = &quantization.Bias.x;
+        bool positions = true;
+        bool normals = true;
+        for (const Vertex& vertex : vertices) {
+            const Vertex decoded = UnpackVertex(PackVertex(vertex, quantization), quantization);
+            const float* p0 = &vertex.Pos.x;
+            const float* p1 = &decoded.Pos.x;
+            for (int axis = 0; axis < 3; ++axis) {
+                const float bound = scale[axis] / 65535.0f * 0.5f + 4.0f * FLT_EPSILON * (std::fabs(bias[axis]) + std::fabs(scale[axis]));
+                positions = positions && std::fabs(p0[axis] - p1[axis]) <= bound;
+            }
+            const DirectX::XMFLOAT3& n = vertex.Normal;
+            if (n.x != 0.0f || n.y != 0.0f || n.z != 0.0f) normals = normals && Angle(n, decoded.Normal) <= NormalAngleBound;
+        }
+        const VertexPackingError error = MeasureVertexPackingError(vertices.data(), vertices.size(), quantization);
+        char message[160];
+        std::snprintf(message, sizeof(message), "%s: posicoes dentro do limite", what);
+        Check(positions, message);
+        std::snprintf(message, sizeof(message), "%s: normais dentro do limite", what);
+        Check(normals, message);
+        std::snprintf(message, sizeof(message), "%s: WithinBounds", what);
+        Check(error.WithinBounds(), message);
+        std::printf("%s: posicao %.3f do limite, normal %.2e rad\n", what, error.MaxPositionError, error.MaxNormalAngle);
+    }
+
+    DirectX::XMFLOAT3 Normalized(float x, float y, float z)
+    {
+        const float length = std::sqrt(x * x + y * y + z * z);
+        return { x / length, y / length, z / length };
+    }
+}
+
+int main()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    // 1. Normais: aleatorias, eixos (com -0), dobras do octaedro (z ~ 0, x ou y ~ 0)
+    // e nao unitarias. Posicoes aleatorias num AABB comum.
+    std::vector<Vertex> vertices;
+    for (int k = 0; k < 200000; ++k) {
+        Vertex vertex;
+        vertex.Pos = { unit(rng) * 3.0f, unit(rng) * 7.0f + 2.0f, unit(rng) * 0.5f };
+        vertex.Normal = Normalized(unit(rng), unit(rng), unit(rng));
+        vertices.push_back(vertex);
+    }
+    const float axes[][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+        { -0.0f, -0.0f, -1 }, { -0.0f, 1, -0.0f }, { 1, -0.0f, -0.0f } };
+    for (const auto& axis : axes) vertices.push_back({ { 0.0f, 0.0f, 0.0f }, { axis[0], axis[1], axis[2] } });
+    for (int k = 0; k < 20000; ++k) {
+        const float a = unit(rng);
+        const float b = unit(rng);
+        const float tiny = unit(rng) * 1e-6f;
+        vertices.push_back({ { 0.0f, 0.0f, 0.0f }, Normalized(a, b, tiny) });
+        vertices.push_back({ { 0.0f, 0.0f, 0.0f }, Normalized(tiny, a, b) });
+        vertices.push_back({ { 0.0f, 0.0f, 0.0f }, Normalized(a, tiny, b) });
+    }
+    for (int k = 0; k < 1000; ++k) {
+        const DirectX::XMFLOAT3 n = Normalized(unit(rng), unit(rng), unit(rng));
+        const float length = k % 2 ? 1000.0f : 1e-3f;
+        vertices.push_back({ { 0.0f, 0.0f, 0.0f }, { n.x * length, n.y * length, n.z * length } });
+    }
+    CheckVertices(vertices, "normais");
+
+    // Nao unitaria: a direcao sobrevive e a normal decodificada e unitaria.
+    for (size_t k = vertices.size() - 1000; k < vertices.size(); ++k) {
+        const DirectX::XMFLOAT3 n = UnpackVertex(PackVertex(vertices[k], VertexQuantization()), VertexQuantization()).Normal;
+        Check(std::fabs(std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z) - 1.0f) <= 1e-5f, "normal decodificada unitaria");
+    }
+
+    // Normal nula: nao ha direcao para preservar, mas a decodificada e finita e unitaria.
+    const Vertex zero = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+    const DirectX::XMFLOAT3 zeroNormal = UnpackVertex(PackVertex(zero, VertexQuantization()), VertexQuantization()).Normal;
+    Check(Finite(zeroNormal) && std::fabs(zeroNormal.x * zeroNormal.x + zeroNormal.y * zeroNormal.y + zeroNormal.z * zeroNormal.z - 1.0f) <= 1e-6f,
+        "normal nula decodifica finita e unitaria");
+
+    // 2. AABBs extremos: longe da origem, enorme, minusculo e achatado em um ou dois
+    // eixos; vertices nos oito cantos e no meio.
+    struct Box
+    {
+        const char* Name;
+        DirectX::XMFLOAT3 Min;
+        DirectX::XMFLOAT3 Max;
+    };
+    const Box boxes[] = {
+        { "AABB longe da origem", { 1.0e5f, -2.0e5f, 3.0e5f }, { 1.0e5f + 3.0f, -2.0e5f + 1.0f, 3.0e5f + 0.25f } },
+        { "AABB enorme", { -1.0e7f, -5.0e6f, -1.0e7f }, { 1.0e7f, 5.0e6f, 1.0e7f } },
+        { "AABB minusculo", { 1.0e-3f, 2.0e-3f, -1.0e-3f }, { 1.0e-3f + 1.0e-6f, 2.0e-3f + 1.0e-6f, -1.0e-3f + 1.0e-6f } },
+        { "AABB achatado em y", { -10.0f, 4.0f, -10.0f }, { 10.0f, 4.0f, 10.0f } },
+        { "AABB achatado em x e z", { 2.0f, -1.0f, -3.0f }, { 2.0f, 1.0f, -3.0f } },
+    };
+    for (const Box& box : boxes) {
+        std::vector<Vertex> corners;
+        std::uniform_real_distribution<float> t(0.0f, 1.0f);
+        for (int k = 0; k < 8; ++k) {
+            corners.push_back({ { k & 1 ? box.Max.x : box.Min.x, k & 2 ? box.Max.y : box.Min.y, k & 4 ? box.Max.z : box.Min.z }, { 0.0f, 1.0f, 0.0f } });
+        }
+        for (int k = 0; k < 20000; ++k) {
+            const float tx = t(rng);
+            const float ty = t(rng);
+            const float tz = t(rng);
+            corners.push_back({ { box.Min.x + (box.Max.x - box.Min.x) * tx, box.Min.y + (box.Max.y - box.Min.y) * ty,
+                box.Min.z + (box.Max.z - box.Min.z) * tz }, Normalized(unit(rng), unit(rng), unit(rng)) });
+        }
+        CheckVertices(corners, box.Name);
+    }
+
+    // 3. Fora do AABB (por exemplo uma quantizacao antiga depois de uma edicao): a
+    // posicao satura na face mais proxima em vez de dar a volta.
+    MeshBounds bounds;
+    bounds.Min = { -1.0f, -1.0f, -1.0f };
+    bounds.Max = { 1.0f, 1.0f, 1.0f };
+    const VertexQuantization quantization = MakeVertexQuantization(bounds);
+    const Vertex outside = { { 5.0f, -3.0f, 0.5f }, { 0.0f, 1.0f, 0.0f } };
+    const DirectX::XMFLOAT3 clamped = UnpackVertex(PackVertex(outside, quantization), quantization).Pos;
+    Check(clamped.x == 1.0f && clamped.y == -1.0f && std::fabs(clamped.z - 0.5f) <= 2.0f / 65535.0f * 0.5f + 1e-6f,
+        "posicao fora do AABB satura na borda");
+    Check(!MeasureVertexPackingError(&outside, 1, quantization).WithinBounds(), "posicao fora do AABB acusa erro acima do limite");
+
+    if (failures == 0) std::printf("VertexPackingTest: ok\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -1,10 +1,13 @@
 #include "pch.h"
 #include "Application.h"
+#include "ObjLoader.h"
+#include "GlbLoader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 #include <cmath>
-#include <fstream>
-#include <sstream>
-#include <map>
-#include <tuple>
+#include <filesystem>
+#include <optional>
 #include <stdexcept>
 
 
@@ -22,136 +25,6 @@ Physics::Physics() :
     DirectX::XMStoreFloat4(&orientation, DirectX::XMQuaternionIdentity());
 }
 
-Terrain::Terrain(float w, float d, int rows, int cols)
-    : width(w), depth(d), verticesPerRow(rows), verticesPerCol(cols) {
-    GenerateHeightMap();
-}
-
-void Terrain::GenerateHeightMap() {
-    heightMap.resize(verticesPerRow);
-    for (int i = 0; i < verticesPerRow; i++) {
-        heightMap[i].resize(verticesPerCol);
-        for (int j = 0; j < verticesPerCol; j++) {
-            float x = (i - verticesPerRow / 2.0f) * (width / verticesPerRow);
-            float z = (j - verticesPerCol / 2.0f) * (depth / verticesPerCol);
-            heightMap[i][j] = 5.0f * sinf(x * 0.1f) * cosf(z * 0.1f);
-        }
-    }
-}
-
-float Terrain::GetHeightAt(float x, float z) {
-    float fx = (x + width / 2) / width * (verticesPerRow - 1);
-    float fz = (z + depth / 2) / depth * (verticesPerCol - 1);
-
-    int ix = (int)fx;
-    int iz = (int)fz;
-
-    if (ix < 0 || ix >= verticesPerRow - 1 || iz < 0 || iz >= verticesPerCol - 1)
-        return 0.0f;
-
-    float fracX = fx - ix;
-    float fracZ = fz - iz;
-
-    float h00 = heightMap[ix][iz];
-    float h10 = heightMap[ix + 1][iz];
-    float h01 = heightMap[ix][iz + 1];
-    float h11 = heightMap[ix + 1][iz + 1];
-
-    float h0 = h00 * (1 - fracX) + h10 * fracX;
-    float h1 = h01 * (1 - fracX) + h11 * fracX;
-
-    return h0 * (1 - fracZ) + h1 * fracZ;
-}
-
-Model Terrain::GenerateTerrainMesh() {
-    Model terrainModel;
-
-    for (int i = 0; i < verticesPerRow; i++) {
-        for (int j = 0; j < verticesPerCol; j++) {
-            Vertex vertex;
-            vertex.Pos.x = (i - verticesPerRow / 2.0f) * (width / verticesPerRow);
-            vertex.Pos.y = heightMap[i][j];
-            vertex.Pos.z = (j - verticesPerCol / 2.0f) * (depth / verticesPerCol);
-
-            vertex.Normal = CalculateNormal(i, j);
-
-            vertex.Albedo = { 0.4f, 0.3f, 0.1f };
-            vertex.Metallic = 0.0f;
-            vertex.Roughness = 0.9f;
-            vertex.AO = 1.0f;
-
-            terrainModel.vertices.push_back(vertex);
-        }
-    }
-
-    for (int i = 0; i < verticesPerRow - 1; i++) {
-        for (int j = 0; j < verticesPerCol - 1; j++) {
-            int topLeft = i * verticesPerCol + j;
-            int topRight = topLeft + 1;
-            int bottomLeft = (i + 1) * verticesPerCol + j;
-            int bottomRight = bottomLeft + 1;
-
-            terrainModel.indices.push_back(topLeft);
-            terrainModel.indices.push_back(bottomLeft);
-            terrainModel.indices.push_back(topRight);
-
-            terrainModel.indices.push_back(topRight);
-            terrainModel.indices.push_back(bottomLeft);
-            terrainModel.indices.push_back(bottomRight);
-        }
-    }
-
-    return terrainModel;
-}
-
-DirectX::XMFLOAT3 Terrain::CalculateNormal(int i, int j) {
-    DirectX::XMFLOAT3 normal = { 0, 1, 0 };
-
-    if (i > 0 && i < verticesPerRow - 1 && j > 0 && j < verticesPerCol - 1) {
-        float hL = heightMap[i - 1][j];
-        float hR = heightMap[i + 1][j];
-        float hD = heightMap[i][j - 1];
-        float hU = heightMap[i][j + 1];
-
-        normal.x = hL - hR;
-        normal.z = hD - hU;
-        normal.y = 2.0f * (width / verticesPerRow);
-
-        DirectX::XMVECTOR n = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&normal));
-        DirectX::XMStoreFloat3(&normal, n);
-    }
-
-    return normal;
-}
-
-
-void Application::BuildLightCircle()
-{
-    const int segments = 32;
-    const float radius = 2.0f;
-    std::vector<SimpleVertex> vertices;
-
-    vertices.push_back({ {0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f} });
-
-    for (int i = 0; i <= segments; ++i)
-    {
-        float angle = (float)i / segments * 2.0f * DirectX::XM_PI;
-        float x = radius * cosf(angle);
-        float z = radius * sinf(angle);
-        vertices.push_back({ {x, 0.0f, z}, {1.0f, 1.0f, 0.0f} });
-    }
-
-    m_lightCircleVertexCount = (UINT)vertices.size();
-
-    const UINT vbByteSize = (UINT)vertices.size() * sizeof(SimpleVertex);
-
-    m_lightCircleVertexBufferGPU = CreateDefaultBuffer(vertices.data(), vbByteSize, m_lightCircleVertexBufferUploader);
-
-    m_lightCircleVbv.BufferLocation = m_lightCircleVertexBufferGPU->GetGPUVirtualAddress();
-    m_lightCircleVbv.StrideInBytes = sizeof(SimpleVertex);
-    m_lightCircleVbv.SizeInBytes = vbByteSize;
-}
-
 void Application::BuildShadersAndPso()
 {
     Microsoft::WRL::ComPtr<ID3DBlob> vsByteCode = nullptr;
@@ -182,12 +55,8 @@ void Application::BuildShadersAndPso()
 
     m_inputLayout =
     {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "ALBEDO", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "METALLIC", 0, DXGI_FORMAT_R32_FLOAT, 0, 36, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "ROUGHNESS", 0, DXGI_FORMAT_R32_FLOAT, 0, 40, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "AO", 0, DXGI_FORMAT_R32_FLOAT, 0, 44, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
     };
 
     D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
@@ -214,93 +83,34 @@ void Application::BuildShadersAndPso()
         OutputDebugStringA("Falha ao criar Pipeline State Object principal\n");
         ThrowIfFailed(hr);
     }
-}
 
-Model load_model_from_obj(const std::string& path)
-{
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        throw std::runtime_error("Nao foi possivel abrir o arquivo do modelo: " + path);
+    // Terreno: mesmo PS, com o VS do CDLOD lendo a grade do patch.
+    Microsoft::WRL::ComPtr<ID3DBlob> terrainVsByteCode = nullptr;
+    hr = D3DCompileFromFile(L"terrain_shaders.hlsl", nullptr, D3D_COMPILE_STANDARD_FILE_INCLUDE, "TerrainVS", "vs_5_1", compileFlags, 0, &terrainVsByteCode, &errorBlob);
+    if (FAILED(hr))
+    {
+        if (errorBlob)
+        {
+            OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+        }
+        ThrowIfFailed(hr);
     }
 
-    Model model;
-    std::vector<DirectX::XMFLOAT3> temp_positions;
-    std::vector<DirectX::XMFLOAT3> temp_normals;
-    std::vector<DirectX::XMFLOAT2> temp_texcoords;
-    std::map<std::tuple<int, int, int>, unsigned int> index_map;
+    const D3D12_INPUT_ELEMENT_DESC terrainInputLayout[] =
+    {
+        { "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "SKIRT", 0, DXGI_FORMAT_R32_FLOAT, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
+    };
+    psoDesc.InputLayout = { terrainInputLayout, _countof(terrainInputLayout) };
+    psoDesc.pRootSignature = m_terrainRootSignature.Get();
+    psoDesc.VS = { reinterpret_cast<BYTE*>(terrainVsByteCode->GetBufferPointer()), terrainVsByteCode->GetBufferSize() };
 
-    std::string line;
-    while (std::getline(file, line))
+    hr = m_d3dDevice->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_terrainPso));
+    if (FAILED(hr))
     {
-        std::stringstream ss(line);
-        std::string prefix;
-        ss >> prefix;
-
-        if (prefix == "v") {
-            DirectX::XMFLOAT3 position;
-            ss >> position.x >> position.z >> position.y;
-            position.z = -position.z;
-            temp_positions.push_back(position);
-        }
-        else if (prefix == "vn") {
-            DirectX::XMFLOAT3 normal;
-            ss >> normal.x >> normal.z >> normal.y;
-            normal.z = -normal.z;
-            temp_normals.push_back(normal);
-        }
-        else if (prefix == "vt") {
-            DirectX::XMFLOAT2 uv;
-            ss >> uv.x >> uv.y;
-            temp_texcoords.push_back(uv);
-        }
-        else if (prefix == "f") {
-            std::string vertex_data;
-            std::vector<unsigned int> temp_face_indices;
-            while (ss >> vertex_data) {
-                std::stringstream vertex_ss(vertex_data);
-                int v_idx = 0, vt_idx = 0, vn_idx = 0;
-                char slash;
-                vertex_ss >> v_idx >> slash >> vt_idx >> slash >> vn_idx;
-                if (v_idx == 0) {
-                    vertex_ss.clear();
-                    vertex_ss.seekg(0);
-                    vertex_ss >> v_idx;
-                }
-                v_idx--; vt_idx--; vn_idx--;
-                std::tuple<int, int, int> key = { v_idx, vt_idx, vn_idx };
-                if (index_map.count(key)) {
-                    temp_face_indices.push_back(index_map[key]);
-                }
-                else {
-                    if (v_idx < 0 || v_idx >= temp_positions.size()) continue;
-                    Vertex new_vertex;
-                    new_vertex.Pos = temp_positions[v_idx];
-                    if (vn_idx >= 0 && vn_idx < temp_normals.size()) {
-                        new_vertex.Normal = temp_normals[vn_idx];
-                    }
-                    else {
-                        new_vertex.Normal = { 0.0f, 1.0f, 0.0f };
-                    }
-                    float height_factor = (new_vertex.Pos.y + 1.0f) * 0.5f;
-                    new_vertex.Albedo = { 1.0f, 1.0f, 1.0f };
-                    new_vertex.Metallic = 0.1f + height_factor * 0.8f;
-                    new_vertex.Roughness = 0.2f + (1.0f - height_factor) * 0.6f;
-                    new_vertex.AO = 0.8f + height_factor * 0.2f;
-                    unsigned int new_index = static_cast<unsigned int>(model.vertices.size());
-                    model.vertices.push_back(new_vertex);
-                    index_map[key] = new_index;
-                    temp_face_indices.push_back(new_index);
-                }
-            }
-            for (size_t i = 0; i < temp_face_indices.size() - 2; ++i) {
-                model.indices.push_back(temp_face_indices[0]);
-                model.indices.push_back(temp_face_indices[i + 1]);
-                model.indices.push_back(temp_face_indices[i + 2]);
-            }
-        }
+        OutputDebugStringA("Falha ao criar Pipeline State Object do terreno\n");
+        ThrowIfFailed(hr);
     }
-    file.close();
-    return model;
 }
 
 LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -320,15 +130,18 @@ LRESULT CALLBACK MainWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
 
 Application::Application(HINSTANCE hInstance) : m_hAppInst(hInstance)
 {
+    // O tempo ate o primeiro frame conta desde aqui; terreno e modelo sao
+    // gerados e lidos no pool, fora deste caminho.
+    m_startTime = std::chrono::steady_clock::now();
     DirectX::XMStoreFloat4x4(&m_world, DirectX::XMMatrixIdentity());
     m_lightPosition = { 2000.0f, 3000.0f, 1500.0f };
-
-    m_terrain = std::make_unique<Terrain>();
     m_physics = std::make_unique<Physics>();
 }
 
 Application::~Application()
 {
+    // Carregamentos ainda em andamento usam o device e os membros; termina o pool antes.
+    m_loadPool.reset();
     if (m_d3dDevice != nullptr)
         FlushCommandQueue();
 }
@@ -340,16 +153,16 @@ bool Application::Initialize()
 
     OnResize();
 
-    ThrowIfFailed(m_commandList->Reset(m_directCmdListAlloc.Get(), nullptr));
-    BuildGeometry();
-    BuildTerrainGeometry();
+    // Modelo e terreno carregam no pool enquanto a janela ja desenha; Run os
+    // adota quando ficarem prontos.
+    m_loadPool = std::make_unique<ThreadPool>();
+    m_uploadQueue = std::make_unique<UploadQueue>(m_d3dDevice.Get(), *m_loadPool);
+    m_modelLoad = Spawn(LoadModelAsync("Models/mustang.obj"));
+    m_terrainLoad = Spawn(LoadTerrainAsync());
+
     BuildRootSignature();
+    BuildTerrainRootSignature();
     BuildShadersAndPso();
-    ThrowIfFailed(m_commandList->Close());
-
-    ID3D12CommandList* cmdsLists[] = { m_commandList.Get() };
-    m_commandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
-    FlushCommandQueue();
 
     return true;
 }
@@ -366,8 +179,14 @@ int Application::Run()
         }
         else
         {
+            PollLoads();
             Update(0.016f);
             Draw();
+            if (!m_firstFrameShown)
+            {
+                m_firstFrameShown = true;
+                OutputDebugStringA(("Primeiro frame em " + std::to_string(MillisecondsSinceStart()) + " ms\n").c_str());
+            }
         }
     }
     return (int)msg.wParam;
@@ -412,18 +231,36 @@ void Application::UpdatePhysics(float dt)
     DirectX::XMStoreFloat3(&m_physics->angularVelocity, angularVel);
 
     // --- VERIFICAR COLISO COM TERRENO ---
-    float terrainHeight = m_terrain->GetHeightAt(m_physics->position.x, m_physics->position.z);
+    // Centro e quatro pontos em volta da base, numa so consulta contra os triangulos
+    // desenhados; o ponto mais alto do chao decide o contato e a normal do quique.
+    const float contactRadius = 1.0f;
+    const float contactX[5] = { 0.0f, contactRadius, -contactRadius, 0.0f, 0.0f };
+    const float contactZ[5] = { 0.0f, 0.0f, 0.0f, contactRadius, -contactRadius };
+    float pointX[5], pointZ[5], groundY[5], normalX[5], normalY[5], normalZ[5];
+    for (int k = 0; k < 5; ++k) {
+        pointX[k] = m_physics->position.x + contactX[k];
+        pointZ[k] = m_physics->position.z + contactZ[k];
+    }
+    m_terrain->GetSurfacesAt(pointX, pointZ, { groundY, normalX, normalY, normalZ });
+    const int contact = int(std::max_element(groundY, groundY + 5) - groundY);
+    const DirectX::XMVECTOR groundNormal = DirectX::XMVectorSet(normalX[contact], normalY[contact], normalZ[contact], 0.0f);
+
+    float terrainHeight = groundY[contact];
     float modelBottom = m_physics->position.y - 2.0f; // Ajuste conforme o tamanho do seu modelo
 
     if (modelBottom <= terrainHeight) {
         // Corrige a posio para ficar em cima do terreno
         m_physics->position.y = terrainHeight + 2.0f;
 
-        if (!m_physics->onGround && m_physics->velocity.y < 0) {
-            float impactSpeed = abs(m_physics->velocity.y);
+        // Velocidade contra a face, ao longo da normal dela.
+        DirectX::XMVECTOR velocity = DirectX::XMLoadFloat3(&m_physics->velocity);
+        const float intoGround = DirectX::XMVectorGetX(DirectX::XMVector3Dot(velocity, groundNormal));
+
+        if (!m_physics->onGround && intoGround < 0) {
+            float impactSpeed = abs(intoGround);
 
-            // Aplicar quique
-            m_physics->velocity.y = -m_physics->velocity.y * m_physics->bounciness;
+            // Aplicar quique: reflete a componente normal
+            velocity = DirectX::XMVectorSubtract(velocity, DirectX::XMVectorScale(groundNormal, (1.0f + m_physics->bounciness) * intoGround));
 
             // 4. APLICAR TORQUE NA COLISO
             // Gera um torque aleatrio para fazer o objeto tombar de forma imprevisvel
@@ -439,10 +276,16 @@ void Application::UpdatePhysics(float dt)
 
             // Se a velocidade for muito baixa, parar o quique
             if (impactSpeed < 1.0f) {
-                m_physics->velocity.y = 0;
+                velocity = DirectX::XMVectorSubtract(velocity,
+                    DirectX::XMVectorScale(groundNormal, DirectX::XMVectorGetX(DirectX::XMVector3Dot(velocity, groundNormal))));
                 m_physics->onGround = true;
             }
         }
+        else if (m_physics->onGround && intoGround < 0) {
+            // Apoiado: so a componente tangente sobra, e o modelo escorrega na rampa.
+            velocity = DirectX::XMVectorSubtract(velocity, DirectX::XMVectorScale(groundNormal, intoGround));
+        }
+        DirectX::XMStoreFloat3(&m_physics->velocity, velocity);
     }
     else {
         m_physics->onGround = false;
@@ -494,7 +337,30 @@ void Application::Update(float dt)
 
     m_Camera.UpdateViewMatrix();
 
-    UpdatePhysics(dt);
+    const DirectX::XMFLOAT3 cameraPos = m_Camera.GetPosition3f();
+    if (m_terrain) m_terrain->UpdateResidency(cameraPos.x, cameraPos.z, kTerrainResidencyRadius);
+
+    // G cava sob a camera enquanto estiver apertado; C abre uma cratera onde o cursor aponta.
+    if (m_terrainQuarterIndexCount > 0 && !m_terrain->IsStreamed()) {
+        if (GetAsyncKeyState('G') & 0x8000) {
+            TerrainBrush brush;
+            brush.Mode = TerrainBrushMode::Lower;
+            brush.X = cameraPos.x;
+            brush.Z = cameraPos.z;
+            brush.Radius = 16.0f;
+            brush.Strength = 4.0f * dt;
+            m_terrain->ApplyBrush(brush);
+        }
+        const bool craterKeyDown = (GetAsyncKeyState('C') & 0x8000) != 0;
+        if (craterKeyDown && !m_craterKeyDown) {
+            const TerrainHit hit = PickTerrain(m_LastMousePos);
+            if (hit.Hit) m_terrain->ApplyStamp(m_craterStamp, hit.Position.x, hit.Position.z);
+        }
+        m_craterKeyDown = craterKeyDown;
+    }
+
+    // Sem chao ainda, o modelo esperaria caindo; a fisica comeca com o terreno.
+    if (m_terrain) UpdatePhysics(dt);
 
     static float lightAngle = 0.0f;
     lightAngle += dt * 0.5f;
@@ -523,29 +389,155 @@ void Application::Draw()
     m_commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
 
     m_commandList->OMSetRenderTargets(1, &rtvHandle, true, &dsvHandle);
-    m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
 
     DirectX::XMMATRIX view = m_Camera.GetView();
     DirectX::XMMATRIX proj = m_Camera.GetProjection();
     DirectX::XMFLOAT3 cameraPos = m_Camera.GetPosition3f();
     DirectX::XMFLOAT3 lightColor = { 300.0f, 300.0f, 300.0f };
 
+    // Terreno e modelo chegam do carregamento assincrono; ate la o frame sai sem eles.
+    if (m_terrainQuarterIndexCount > 0) {
+        UploadTerrainEdits();
+        DrawTerrain(view, proj, cameraPos, lightColor);
+    }
+    if (m_modelIndexBufferGPU) DrawModel(view, proj, cameraPos, lightColor);
+
+    auto presentBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_swapChainBuffer[currentBackBuffer].Get(),
+        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+    m_commandList->ResourceBarrier(1, &presentBarrier);
+
+    ThrowIfFailed(m_commandList->Close());
+    ID3D12CommandList* cmdsLists[] = { m_commandList.Get() };
+    m_commandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+    ThrowIfFailed(m_swapChain->Present(1, 0));
+    FlushCommandQueue();
+}
+
+void Application::DrawTerrain(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos, const DirectX::XMFLOAT3& lightColor)
+{
+    m_commandList->SetPipelineState(m_terrainPso.Get());
+    m_commandList->SetGraphicsRootSignature(m_terrainRootSignature.Get());
     m_commandList->IASetVertexBuffers(0, 1, &m_terrainVbv);
     m_commandList->IASetIndexBuffer(&m_terrainIbv);
     m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-    DirectX::XMMATRIX terrainWorld = DirectX::XMMatrixIdentity();
-    DirectX::XMMATRIX terrainWorldViewProj = terrainWorld * view * proj;
-    terrainWorldViewProj = DirectX::XMMatrixTranspose(terrainWorldViewProj);
+    DirectX::XMMATRIX viewProj = view * proj;
+    DirectX::XMMATRIX viewProjT = DirectX::XMMatrixTranspose(viewProj);
 
-    m_commandList->SetGraphicsRoot32BitConstants(0, 16, &terrainWorldViewProj, 0);
+    m_commandList->SetGraphicsRoot32BitConstants(0, 16, &viewProjT, 0);
     m_commandList->SetGraphicsRoot32BitConstants(1, 4, &cameraPos, 0);
     m_commandList->SetGraphicsRoot32BitConstants(2, 4, &m_lightPosition, 0);
     m_commandList->SetGraphicsRoot32BitConstants(3, 4, &lightColor, 0);
-    m_commandList->SetGraphicsRoot32BitConstants(4, 16, &terrainWorld, 0);
+    m_commandList->SetGraphicsRoot32BitConstants(4, 6, &m_terrainMaterial, 0);
+    m_commandList->SetGraphicsRoot32BitConstants(6, 8, &m_terrainLayout, 0);
+    m_commandList->SetGraphicsRootShaderResourceView(7, m_terrainHeightBufferGPU->GetGPUVirtualAddress());
+    m_commandList->SetGraphicsRootShaderResourceView(8, m_terrainNormalBufferGPU->GetGPUVirtualAddress());
+
+    // Um draw por no; nos que so cobrem parte da area desenham os quartos marcados.
+    m_terrainQuadtree.Select(viewProj, cameraPos, m_terrainPatches, m_terrainLodStats);
+    for (const TerrainPatch& patch : m_terrainPatches)
+    {
+        m_commandList->SetGraphicsRoot32BitConstants(5, 8, &patch, 0);
+        if (patch.QuarterMask == 0xF)
+        {
+            m_commandList->DrawIndexedInstanced(m_terrainQuarterIndexCount * 4, 1, 0, 0, 0);
+            continue;
+        }
+        for (UINT q = 0; q < 4; ++q)
+        {
+            if (patch.QuarterMask & (1u << q))
+                m_commandList->DrawIndexedInstanced(m_terrainQuarterIndexCount, 1, q * m_terrainQuarterIndexCount, 0, 0);
+        }
+    }
+}
+
+void Application::UploadTerrainEdits()
+{
+    const TerrainRegion edited = m_terrain->TakeDirtyRegion();
+    if (edited.Empty()) return;
+
+    // As normais dependem dos vizinhos, entao a regiao devolvida ja vem com a borda.
+    const TerrainRegion region = m_terrain->UpdateNormals(edited);
+    m_terrainQuadtree.UpdateBounds(*m_terrain, region);
+    m_terrainPyramid.Update(edited);
+
+    // So as linhas tocadas sobem, cada uma do trecho [BeginJ, EndJ); alturas e
+    // normais tem 4 bytes por amostra e dividem o mesmo buffer de upload.
+    static_assert(sizeof(float) == sizeof(uint32_t));
+    const UINT64 cols = UINT64(m_terrain->verticesPerCol);
+    const UINT64 rows = UINT64(region.EndI - region.BeginI);
+    const UINT64 rowBytes = UINT64(region.EndJ - region.BeginJ) * sizeof(float);
+    const UINT64 blockBytes = rows * rowBytes;
+    if (2 * blockBytes > m_terrainEditUploadSize)
+    {
+        m_terrainEditUploadSize = std::max(2 * blockBytes, 2 * m_terrainEditUploadSize);
+        auto heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+        auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(m_terrainEditUploadSize);
+        ThrowIfFailed(m_d3dDevice->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&m_terrainEditUpload)));
+        // Fica mapeado: Draw espera a GPU no fim de cada frame antes de reescrever.
+        ThrowIfFailed(m_terrainEditUpload->Map(0, nullptr, reinterpret_cast<void**>(&m_terrainEditMapped)));
+    }
+
+    const uint32_t* normals = m_terrain->PackedNormals().data();
+    for (UINT64 r = 0; r < rows; ++r)
+    {
+        const size_t first = size_t((region.BeginI + r) * cols + region.BeginJ);
+        m_terrain->ReadHeightRow(region.BeginI + int(r), region.BeginJ, region.EndJ,
+            reinterpret_cast<float*>(m_terrainEditMapped + r * rowBytes));
+        memcpy(m_terrainEditMapped + blockBytes + r * rowBytes, normals + first, size_t(rowBytes));
+    }
+
+    ID3D12Resource* targets[] = { m_terrainHeightBufferGPU.Get(), m_terrainNormalBufferGPU.Get() };
+    D3D12_RESOURCE_BARRIER barriers[2];
+    for (int b = 0; b < 2; ++b)
+        barriers[b] = CD3DX12_RESOURCE_BARRIER::Transition(targets[b], D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
+    m_commandList->ResourceBarrier(2, barriers);
 
-    m_commandList->DrawIndexedInstanced(m_terrainIndexCount, 1, 0, 0, 0);
+    // Linhas inteiras sao contiguas no buffer e viram uma copia so.
+    const bool fullRows = rowBytes == cols * sizeof(float);
+    for (int b = 0; b < 2; ++b)
+    {
+        const UINT64 source = b * blockBytes;
+        const UINT64 destination = (UINT64(region.BeginI) * cols + region.BeginJ) * sizeof(float);
+        if (fullRows)
+        {
+            m_commandList->CopyBufferRegion(targets[b], destination, m_terrainEditUpload.Get(), source, blockBytes);
+            continue;
+        }
+        for (UINT64 r = 0; r < rows; ++r)
+            m_commandList->CopyBufferRegion(targets[b], destination + r * cols * sizeof(float), m_terrainEditUpload.Get(), source + r * rowBytes, rowBytes);
+    }
 
+    for (int b = 0; b < 2; ++b)
+        barriers[b] = CD3DX12_RESOURCE_BARRIER::Transition(targets[b], D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+    m_commandList->ResourceBarrier(2, barriers);
+}
+
+TerrainHit Application::PickTerrain(POINT cursor) const
+{
+    // Do plano proximo ao distante pelo pixel: MaxDistance 1 cobre o segmento todo.
+    const DirectX::XMMATRIX view = m_Camera.GetView();
+    const DirectX::XMMATRIX proj = m_Camera.GetProjection();
+    const float width = float(m_ClientWidth);
+    const float height = float(m_ClientHeight);
+    const DirectX::XMVECTOR nearPoint = DirectX::XMVector3Unproject(DirectX::XMVectorSet(float(cursor.x), float(cursor.y), 0.0f, 1.0f),
+        0.0f, 0.0f, width, height, 0.0f, 1.0f, proj, view, DirectX::XMMatrixIdentity());
+    const DirectX::XMVECTOR farPoint = DirectX::XMVector3Unproject(DirectX::XMVectorSet(float(cursor.x), float(cursor.y), 1.0f, 1.0f),
+        0.0f, 0.0f, width, height, 0.0f, 1.0f, proj, view, DirectX::XMMatrixIdentity());
+
+    TerrainRay ray;
+    DirectX::XMStoreFloat3(&ray.Origin, nearPoint);
+    DirectX::XMStoreFloat3(&ray.Direction, DirectX::XMVectorSubtract(farPoint, nearPoint));
+    ray.MaxDistance = 1.0f;
+    return m_terrainPyramid.Raycast(ray);
+}
+
+void Application::DrawModel(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos, const DirectX::XMFLOAT3& lightColor)
+{
+    m_commandList->SetPipelineState(m_pso.Get());
+    m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
     m_commandList->IASetVertexBuffers(0, 1, &m_modelVbv);
     m_commandList->IASetIndexBuffer(&m_modelIbv);
     m_commandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -559,45 +551,176 @@ void Application::Draw()
     m_commandList->SetGraphicsRoot32BitConstants(2, 4, &m_lightPosition, 0);
     m_commandList->SetGraphicsRoot32BitConstants(3, 4, &lightColor, 0);
     m_commandList->SetGraphicsRoot32BitConstants(4, 16, &world, 0);
+    m_commandList->SetGraphicsRoot32BitConstants(5, 8, &m_modelQuantization, 0);
 
-    m_commandList->DrawIndexedInstanced(m_modelIndexCount, 1, 0, 0, 0);
+    // As faixas vem agrupadas por material; so troca as constantes quando ele muda.
+    UINT boundMaterial = UINT_MAX;
+    auto bindMaterial = [&](UINT material)
+    {
+        if (material == boundMaterial || material >= m_modelMaterials.size()) return;
+        m_commandList->SetGraphicsRoot32BitConstants(6, 6, &m_modelMaterials[material], 0);
+        boundMaterial = material;
+    };
 
-    auto presentBarrier = CD3DX12_RESOURCE_BARRIER::Transition(m_swapChainBuffer[currentBackBuffer].Get(),
-        D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-    m_commandList->ResourceBarrier(1, &presentBarrier);
+    // LOD mais grosseiro com erro abaixo de um pixel; o nivel 0 passa pelo culling de meshlets.
+    const float lodPixelError = 1.0f;
+    m_modelLod = SelectLod(m_modelLods.data(), m_modelLods.size(), m_modelBounds, world, proj, cameraPos,
+        m_screenViewport.Height, lodPixelError);
 
-    ThrowIfFailed(m_commandList->Close());
-    ID3D12CommandList* cmdsLists[] = { m_commandList.Get() };
-    m_commandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+    if (m_modelLod > 0)
+    {
+        // Faixas do LOD herdam o AABB da faixa completa, entao o culling por parte continua valendo.
+        const MeshLod& lod = m_modelLods[m_modelLod];
+        CullSubmeshes(world * view * proj, m_modelLodRanges.data() + lod.FirstRange, lod.RangeCount, m_modelDrawRanges, m_modelCullStats);
+        for (const DrawRange& range : m_modelDrawRanges)
+        {
+            bindMaterial(range.Material);
+            m_commandList->DrawIndexedInstanced(range.IndexCount, 1, range.IndexStart, (INT)range.BaseVertex, 0);
+        }
+        m_modelCullStats.Triangles = m_modelLods[0].TriangleCount;
+        ShowCullStats();
+    }
+    else if (m_modelMeshlets.Meshlets.empty())
+    {
+        CullSubmeshes(world * view * proj, m_modelSubmeshes.data(), m_modelSubmeshes.size(), m_modelDrawRanges, m_modelCullStats);
+        for (const DrawRange& range : m_modelDrawRanges)
+        {
+            bindMaterial(range.Material);
+            m_commandList->DrawIndexedInstanced(range.IndexCount, 1, range.IndexStart, (INT)range.BaseVertex, 0);
+        }
+        ShowCullStats();
+    }
+    else
+    {
+        // So as partes dentro do frustum e, nelas, os meshlets dentro do frustum e virados para a camera.
+        DirectX::XMVECTOR cameraWorld = DirectX::XMLoadFloat3(&cameraPos);
+        DirectX::XMMATRIX invWorld = DirectX::XMMatrixInverse(nullptr, world);
+        DirectX::XMFLOAT3 cameraLocal;
+        DirectX::XMStoreFloat3(&cameraLocal, DirectX::XMVector3TransformCoord(cameraWorld, invWorld));
+
+        CullMeshlets(world * view * proj, cameraLocal, m_modelMeshlets, m_modelDrawRanges, m_modelCullStats);
+        for (const DrawRange& range : m_modelDrawRanges)
+        {
+            bindMaterial(range.Material);
+            m_commandList->DrawIndexedInstanced(range.IndexCount, 1, range.IndexStart, (INT)range.BaseVertex, 0);
+        }
+        ShowCullStats();
+    }
+}
 
-    ThrowIfFailed(m_swapChain->Present(1, 0));
-    FlushCommandQueue();
+void Application::ShowCullStats()
+{
+    if (m_modelCullStats.VisibleTriangles == m_shownVisibleTriangles &&
+        m_terrainLodStats.Triangles == m_shownTerrainTriangles) return;
+    m_shownVisibleTriangles = m_modelCullStats.VisibleTriangles;
+    m_shownTerrainTriangles = m_terrainLodStats.Triangles;
+
+    std::wstring caption = m_mainWndCaption +
+        L" | Triangulos: " + std::to_wstring(m_modelCullStats.VisibleTriangles) +
+        L" / " + std::to_wstring(m_modelCullStats.Triangles) +
+        L" | Partes: " + std::to_wstring(m_modelCullStats.VisibleParts) +
+        L" / " + std::to_wstring(m_modelCullStats.Parts) +
+        L" | Meshlets: " + std::to_wstring(m_modelCullStats.VisibleMeshlets) +
+        L" / " + std::to_wstring(m_modelCullStats.Meshlets) +
+        L" | Draws: " + std::to_wstring(m_modelCullStats.DrawRanges) +
+        L" | LOD: " + std::to_wstring(m_modelLod) +
+        L" | Terreno: " + std::to_wstring(m_terrainLodStats.Triangles) +
+        L" tri em " + std::to_wstring(m_terrainLodStats.Patches) + L" nos";
+    SetWindowText(m_hMainWnd, caption.c_str());
 }
 
-void Application::BuildTerrainGeometry()
+Task<LoadedTerrain> Application::LoadTerrainAsync()
 {
-    Model terrainModel = m_terrain->GenerateTerrainMesh();
+    co_await m_loadPool->Schedule();
 
-    if (terrainModel.vertices.empty() || terrainModel.indices.empty())
+    LoadedTerrain terrain;
+    // Um terreno importado com ImportRawHeightmap ao lado do executavel substitui o
+    // gerado e e lido do disco em blocos.
+    if (std::filesystem::exists(kTerrainTilePath))
+        terrain.Source = std::make_unique<Terrain>(kTerrainTilePath, kTerrainTileBudget);
+    else
     {
-        throw std::runtime_error("O terreno gerado est vazio.");
+        // 2 km de lado com o mesmo espacamento (4 m) do terreno antigo de 200 m; 512 celulas
+        // fecham uma quadtree exata com patches de 32 quads.
+        NoiseSettings noise;
+        noise.Type = NoiseType::DomainWarped;
+        noise.Frequency = 1.0f / 600.0f;
+        noise.Amplitude = 40.0f;
+        terrain.Source = std::make_unique<Terrain>(2052.0f, 2052.0f, 513, 513, noise);
+        const NoiseStats& stats = terrain.Source->GenerationStats();
+        OutputDebugStringA(("Terreno gerado: " + std::to_string(stats.Samples) + " amostras em " +
+            std::to_string(int(stats.Seconds * 1000.0)) + " ms (" +
+            std::to_string(int(stats.SamplesPerSecond() / 1000.0)) + " mil amostras/s, " +
+            std::to_string(stats.Threads) + " threads)\n").c_str());
+
+        // Alturas em 16 bits por bloco: metade da memoria, erro bem abaixo de 1 cm.
+        const size_t floatBytes = size_t(terrain.Source->verticesPerRow) * terrain.Source->verticesPerCol * sizeof(float);
+        terrain.Source->Quantize();
+        const QuantizedHeights& quantized = terrain.Source->Quantized();
+        OutputDebugStringA(("Alturas quantizadas: " + std::to_string(quantized.MemoryBytes() / 1024) + " KB (" +
+            std::to_string(floatBytes / 1024) + " KB em float), erro maximo " +
+            std::to_string(quantized.MaxError() * 1000.0f) + " mm\n").c_str());
+    }
+    Terrain& loaded = *terrain.Source;
+
+    // So a grade de um patch, as alturas e as normais vao para a GPU; o vertex
+    // shader monta cada no selecionado a partir delas.
+    // Um terreno em blocos pode nao caber na memoria nem na GPU: o desenho usa uma
+    // copia reamostrada e so as consultas de altura leem os blocos.
+    std::optional<Terrain> overview;
+    Terrain* source = &loaded;
+    if (loaded.IsStreamed())
+    {
+        overview.emplace(loaded.Resampled(std::min(loaded.verticesPerRow, kTerrainOverviewSamples),
+            std::min(loaded.verticesPerCol, kTerrainOverviewSamples)));
+        source = &*overview;
     }
 
-    const UINT vbByteSize = (UINT)terrainModel.vertices.size() * sizeof(Vertex);
-    const UINT ibByteSize = (UINT)terrainModel.indices.size() * sizeof(unsigned int);
-
-    m_terrainVertexBufferGPU = CreateDefaultBuffer(terrainModel.vertices.data(), vbByteSize, m_terrainVertexBufferUploader);
-    m_terrainIndexBufferGPU = CreateDefaultBuffer(terrainModel.indices.data(), ibByteSize, m_terrainIndexBufferUploader);
-
-    m_terrainVbv.BufferLocation = m_terrainVertexBufferGPU->GetGPUVirtualAddress();
-    m_terrainVbv.StrideInBytes = sizeof(Vertex);
-    m_terrainVbv.SizeInBytes = vbByteSize;
-
-    m_terrainIbv.BufferLocation = m_terrainIndexBufferGPU->GetGPUVirtualAddress();
-    m_terrainIbv.Format = DXGI_FORMAT_R32_UINT;
-    m_terrainIbv.SizeInBytes = ibByteSize;
-
-    m_terrainIndexCount = (UINT)terrainModel.indices.size();
+    terrain.Quadtree.Build(*source);
+    if (!loaded.IsStreamed()) terrain.Pyramid.Build(loaded);
+    const TerrainLodSettings& lodSettings = terrain.Quadtree.Settings();
+    const TerrainPatchMesh patch = BuildTerrainPatchMesh(lodSettings.PatchQuads);
+    // A GPU continua recebendo float; um terreno quantizado e decodificado aqui.
+    std::vector<float> decoded;
+    if (source->IsQuantized())
+    {
+        decoded.resize(size_t(source->verticesPerRow) * source->verticesPerCol);
+        for (int i = 0; i < source->verticesPerRow; ++i)
+            source->ReadHeightRow(i, 0, source->verticesPerCol, decoded.data() + size_t(i) * source->verticesPerCol);
+    }
+    const std::vector<float>& heights = source->IsQuantized() ? decoded : source->Heights();
+    source->ComputeNormals();
+    const std::vector<uint32_t>& normals = source->PackedNormals();
+
+    std::vector<UploadQueue::BufferUpload> uploads(4);
+    uploads[0].Data = patch.Vertices.data();
+    uploads[0].Size = patch.Vertices.size() * sizeof(TerrainPatchVertex);
+    uploads[1].Data = patch.Indices.data();
+    uploads[1].Size = patch.Indices.size() * sizeof(uint16_t);
+    uploads[2].Data = heights.data();
+    uploads[2].Size = heights.size() * sizeof(float);
+    uploads[3].Data = normals.data();
+    uploads[3].Size = normals.size() * sizeof(uint32_t);
+    co_await m_uploadQueue->UploadBuffers(uploads);
+
+    terrain.PatchVertexBuffer = uploads[0].Resource;
+    terrain.PatchIndexBuffer = uploads[1].Resource;
+    terrain.HeightBuffer = uploads[2].Resource;
+    terrain.NormalBuffer = uploads[3].Resource;
+
+    terrain.Vbv.BufferLocation = terrain.PatchVertexBuffer->GetGPUVirtualAddress();
+    terrain.Vbv.StrideInBytes = sizeof(TerrainPatchVertex);
+    terrain.Vbv.SizeInBytes = (UINT)uploads[0].Size;
+
+    terrain.Ibv.BufferLocation = terrain.PatchIndexBuffer->GetGPUVirtualAddress();
+    terrain.Ibv.Format = DXGI_FORMAT_R16_UINT;
+    terrain.Ibv.SizeInBytes = (UINT)uploads[1].Size;
+
+    terrain.QuarterIndexCount = patch.QuarterIndexCount;
+    terrain.Layout = MakeTerrainHeightLayout(*source, lodSettings);
+    terrain.Surface = Terrain::GroundMaterial();
+    OutputDebugStringA(("Terreno: pronto em " + std::to_string(MillisecondsSinceStart()) + " ms\n").c_str());
+    co_return terrain;
 }
 
 LRESULT Application::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
@@ -727,7 +850,7 @@ void Application::OnResize()
     m_screenViewport.MaxDepth = 1.0f;
 
     m_scissorRect = { 0, 0, m_ClientWidth, m_ClientHeight };
-    m_Camera.SetLens(0.25f * DirectX::XM_PI, (float)m_ClientWidth / m_ClientHeight, 1.0f, 1000.0f);
+    m_Camera.SetLens(0.25f * DirectX::XM_PI, (float)m_ClientWidth / m_ClientHeight, 1.0f, 4000.0f);
 }
 
 bool Application::InitWindow()
@@ -741,7 +864,8 @@ bool Application::InitWindow()
     wc.hbrBackground = (HBRUSH)GetStockObject(NULL_BRUSH);
     wc.lpszClassName = L"MainWnd";
     if (!RegisterClass(&wc)) return false;
-    m_hMainWnd = CreateWindow(L"MainWnd", L"Modelo OBJ com Terreno e Fsica - DirectX 12", WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, m_ClientWidth, m_ClientHeight, 0, 0, m_hAppInst, this);
+    m_mainWndCaption = L"Modelo OBJ com Terreno e Fsica - DirectX 12";
+    m_hMainWnd = CreateWindow(L"MainWnd", m_mainWndCaption.c_str(), WS_OVERLAPPEDWINDOW, CW_USEDEFAULT, CW_USEDEFAULT, m_ClientWidth, m_ClientHeight, 0, 0, m_hAppInst, this);
     if (!m_hMainWnd) return false;
     ShowWindow(m_hMainWnd, SW_SHOW);
     UpdateWindow(m_hMainWnd);
@@ -830,67 +954,204 @@ void Application::CreateDsvDescriptorHeap()
 
 void Application::BuildRootSignature()
 {
-    CD3DX12_ROOT_PARAMETER slotRootParameter[5] = {};
+    CD3DX12_ROOT_PARAMETER slotRootParameter[7] = {};
     slotRootParameter[0].InitAsConstants(16, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
     slotRootParameter[1].InitAsConstants(4, 1, 0, D3D12_SHADER_VISIBILITY_PIXEL);
     slotRootParameter[2].InitAsConstants(4, 2, 0, D3D12_SHADER_VISIBILITY_PIXEL);
     slotRootParameter[3].InitAsConstants(4, 3, 0, D3D12_SHADER_VISIBILITY_PIXEL);
     slotRootParameter[4].InitAsConstants(16, 4, 0, D3D12_SHADER_VISIBILITY_VERTEX);
-    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    slotRootParameter[5].InitAsConstants(8, 5, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    slotRootParameter[6].InitAsConstants(6, 6, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(7, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
     Microsoft::WRL::ComPtr<ID3DBlob> serializedRootSig = nullptr;
     Microsoft::WRL::ComPtr<ID3DBlob> errorBlob = nullptr;
     ThrowIfFailed(D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, &serializedRootSig, &errorBlob));
     ThrowIfFailed(m_d3dDevice->CreateRootSignature(0, serializedRootSig->GetBufferPointer(), serializedRootSig->GetBufferSize(), IID_PPV_ARGS(m_rootSignature.GetAddressOf())));
 }
 
-void Application::BuildGeometry()
+// Mesmas constantes de pixel do modelo; no lugar da matriz world e da quantizacao
+// entram o no selecionado (b7), a grade de alturas (b8) e as alturas (t0).
+void Application::BuildTerrainRootSignature()
+{
+    CD3DX12_ROOT_PARAMETER slotRootParameter[9] = {};
+    slotRootParameter[0].InitAsConstants(16, 0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    slotRootParameter[1].InitAsConstants(4, 1, 0, D3D12_SHADER_VISIBILITY_ALL);
+    slotRootParameter[2].InitAsConstants(4, 2, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    slotRootParameter[3].InitAsConstants(4, 3, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    slotRootParameter[4].InitAsConstants(6, 6, 0, D3D12_SHADER_VISIBILITY_PIXEL);
+    slotRootParameter[5].InitAsConstants(8, 7, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    slotRootParameter[6].InitAsConstants(8, 8, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    slotRootParameter[7].InitAsShaderResourceView(0, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    slotRootParameter[8].InitAsShaderResourceView(1, 0, D3D12_SHADER_VISIBILITY_VERTEX);
+    CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(9, slotRootParameter, 0, nullptr, D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
+    Microsoft::WRL::ComPtr<ID3DBlob> serializedRootSig = nullptr;
+    Microsoft::WRL::ComPtr<ID3DBlob> errorBlob = nullptr;
+    ThrowIfFailed(D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1, &serializedRootSig, &errorBlob));
+    ThrowIfFailed(m_d3dDevice->CreateRootSignature(0, serializedRootSig->GetBufferPointer(), serializedRootSig->GetBufferSize(), IID_PPV_ARGS(m_terrainRootSignature.GetAddressOf())));
+}
+
+Task<LoadedMesh> Application::LoadModelAsync(std::string modelPath)
 {
-    Model model = load_model_from_obj("Models/mustang.obj");
+    co_await m_loadPool->Schedule();
+
+    const std::string cachePath = MeshCachePathFor(modelPath);
 
-    if (model.vertices.empty() || model.indices.empty())
+    // O .xmesh e mapeado e enviado direto para a GPU; o modelo de origem so e
+    // lido quando o cache nao existe ou ficou mais antigo que ele.
+    LoadedMesh mesh;
+    MeshCacheView cached;
+    Model model;
+    std::vector<uint16_t> indices16;
+    std::vector<PackedVertex> packedVertices;
+    const PackedVertex* vertices = nullptr;
+    const void* indices = nullptr;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    size_t indexStride = sizeof(unsigned int);
+
+    if (LoadMeshCache(cachePath, modelPath, cached))
     {
-        throw std::runtime_error("O modelo carregado esta vazio ou em um formato nao suportado. Verifique o arquivo .obj e o parser.");
+        vertices = cached.Vertices;
+        vertexCount = cached.VertexCount;
+        mesh.Quantization = cached.Quantization;
+        indices = cached.Indices;
+        indexCount = cached.IndexCount;
+        indexStride = cached.IndexStride;
+        mesh.Submeshes.assign(cached.Submeshes, cached.Submeshes + cached.SubmeshCount);
+        mesh.Meshlets.assign(cached.Meshlets, cached.Meshlets + cached.MeshletCount);
+        mesh.Lods.assign(cached.Lods, cached.Lods + cached.LodCount);
+        mesh.LodRanges.assign(cached.LodRanges, cached.LodRanges + cached.LodRangeCount);
+        mesh.Materials.assign(cached.Materials, cached.Materials + cached.MaterialCount);
+        mesh.Bounds = cached.Bounds;
     }
+    else
+    {
+        // Exportacoes em .glb ja vem binarias; qualquer outra extensao e lida como .obj.
+        const bool isGlb = modelPath.size() >= 4 && _stricmp(modelPath.c_str() + modelPath.size() - 4, ".glb") == 0;
+        model = isGlb ? load_model_from_glb(modelPath) : load_model_from_obj_parallel(modelPath);
+
+        MeshOptimizeOptions optimizeOptions;
+        optimizeOptions.OptimizeOverdraw = true;
+        MeshOptimizeReport report = OptimizeMesh(model, optimizeOptions);
+        OutputDebugStringA((modelPath + ": " + report.ToString() + "\n").c_str());
+
+        // Malhas com mais de 65536 vertices viram varias faixas de 16 bits.
+        SplitMeshForIndex16(model);
+        mesh.Submeshes = GetSubmeshes(model);
+        mesh.Meshlets = BuildMeshlets(model);
+
+        GenerateLods(model);
+        mesh.Lods = model.lods;
+        mesh.LodRanges = model.lodRanges;
+        for (const MeshLod& lod : model.lods)
+        {
+            OutputDebugStringA((modelPath + ": LOD " + std::to_string(lod.TriangleCount) + " triangulos, erro " +
+                std::to_string(lod.Error) + "\n").c_str());
+        }
 
-    const UINT vbByteSize = (UINT)model.vertices.size() * sizeof(Vertex);
-    const UINT ibByteSize = (UINT)model.indices.size() * sizeof(unsigned int);
-
-    m_modelVertexBufferGPU = CreateDefaultBuffer(model.vertices.data(), vbByteSize, m_modelVertexBufferUploader);
-    m_modelIndexBufferGPU = CreateDefaultBuffer(model.indices.data(), ibByteSize, m_modelIndexBufferUploader);
-
-    m_modelVbv.BufferLocation = m_modelVertexBufferGPU->GetGPUVirtualAddress();
-    m_modelVbv.StrideInBytes = sizeof(Vertex);
-    m_modelVbv.SizeInBytes = vbByteSize;
+        if (!model.vertices.empty() && !model.indices.empty() && !WriteMeshCache(cachePath, modelPath, model, mesh.Meshlets))
+        {
+            OutputDebugStringA(("Nao foi possivel gravar o cache " + cachePath + "\n").c_str());
+        }
+        mesh.Bounds = ComputeMeshBounds(model.vertices.data(), model.vertices.size());
+        mesh.Quantization = MakeVertexQuantization(mesh.Bounds);
+        PackVertices(model.vertices.data(), model.vertices.size(), mesh.Quantization, packedVertices);
+        if (!MeasureVertexPackingError(model.vertices.data(), model.vertices.size(), mesh.Quantization).WithinBounds())
+        {
+            OutputDebugStringA((modelPath + ": erro de quantizacao dos vertices acima do limite\n").c_str());
+        }
+        vertices = packedVertices.data();
+        vertexCount = packedVertices.size();
+        indexCount = model.indices.size();
+        if (PackIndices16(model.indices.data(), indexCount, indices16))
+        {
+            indices = indices16.data();
+            indexStride = sizeof(uint16_t);
+        }
+        else
+        {
+            indices = model.indices.data();
+        }
+        mesh.Materials = GetMaterials(model);
+    }
 
-    m_modelIbv.BufferLocation = m_modelIndexBufferGPU->GetGPUVirtualAddress();
-    m_modelIbv.Format = DXGI_FORMAT_R32_UINT;
-    m_modelIbv.SizeInBytes = ibByteSize;
+    if (vertexCount == 0 || indexCount == 0)
+    {
+        throw std::runtime_error("O modelo carregado esta vazio ou em um formato nao suportado. Verifique o arquivo .obj e o parser.");
+    }
 
-    m_modelIndexCount = (UINT)model.indices.size();
+    // 'cached' segura o mapeamento ate a copia terminar.
+    co_await UploadMeshAsync(mesh, vertices, vertexCount, indices, indexCount, indexStride);
+    OutputDebugStringA((modelPath + ": pronto em " + std::to_string(MillisecondsSinceStart()) + " ms\n").c_str());
+    co_return mesh;
 }
 
-Microsoft::WRL::ComPtr<ID3D12Resource> Application::CreateDefaultBuffer(const void* initData, UINT64 byteSize, Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer)
+Task<void> Application::UploadMeshAsync(LoadedMesh& mesh, const void* vertices, size_t vertexCount,
+    const void* indices, size_t indexCount, size_t indexStride)
 {
-    Microsoft::WRL::ComPtr<ID3D12Resource> defaultBuffer;
-    auto heapPropsDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
-    auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
-    ThrowIfFailed(m_d3dDevice->CreateCommittedResource(&heapPropsDefault, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&defaultBuffer)));
-
-    auto heapPropsUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-    ThrowIfFailed(m_d3dDevice->CreateCommittedResource(&heapPropsUpload, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&uploadBuffer)));
-
-    D3D12_SUBRESOURCE_DATA subResourceData = {};
-    subResourceData.pData = initData;
-    subResourceData.RowPitch = byteSize;
-    subResourceData.SlicePitch = subResourceData.RowPitch;
-
-    auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST);
-    m_commandList->ResourceBarrier(1, &barrier);
+    const UINT vbByteSize = (UINT)vertexCount * sizeof(PackedVertex);
+    const UINT ibByteSize = (UINT)(indexCount * indexStride);
+
+    std::vector<UploadQueue::BufferUpload> uploads(2);
+    uploads[0].Data = vertices;
+    uploads[0].Size = vbByteSize;
+    uploads[1].Data = indices;
+    uploads[1].Size = ibByteSize;
+    co_await m_uploadQueue->UploadBuffers(uploads);
+
+    mesh.VertexBuffer = uploads[0].Resource;
+    mesh.IndexBuffer = uploads[1].Resource;
+
+    mesh.Vbv.BufferLocation = mesh.VertexBuffer->GetGPUVirtualAddress();
+    mesh.Vbv.StrideInBytes = sizeof(PackedVertex);
+    mesh.Vbv.SizeInBytes = vbByteSize;
+
+    mesh.Ibv.BufferLocation = mesh.IndexBuffer->GetGPUVirtualAddress();
+    mesh.Ibv.Format = indexStride == sizeof(uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+    mesh.Ibv.SizeInBytes = ibByteSize;
+    mesh.IndexCount = (UINT)indexCount;
+}
 
-    UpdateSubresources<1>(m_commandList.Get(), defaultBuffer.Get(), uploadBuffer.Get(), 0, 0, 1, &subResourceData);
+void Application::PollLoads()
+{
+    // Take relanca a excecao do carregamento, que sobe ate o catch do WinMain.
+    if (m_terrainLoad.Ready())
+    {
+        LoadedTerrain terrain = m_terrainLoad.Take();
+        m_terrainVertexBufferGPU = terrain.PatchVertexBuffer;
+        m_terrainIndexBufferGPU = terrain.PatchIndexBuffer;
+        m_terrainHeightBufferGPU = terrain.HeightBuffer;
+        m_terrainNormalBufferGPU = terrain.NormalBuffer;
+        m_terrainVbv = terrain.Vbv;
+        m_terrainIbv = terrain.Ibv;
+        m_terrainLayout = terrain.Layout;
+        m_terrainQuadtree = std::move(terrain.Quadtree);
+        m_terrainPyramid = std::move(terrain.Pyramid);
+        m_terrainMaterial = terrain.Surface;
+        m_terrainQuarterIndexCount = terrain.QuarterIndexCount;
+        m_terrain = std::move(terrain.Source);
+        // A camera comeca logo acima do chao, que pode passar da altura inicial dela.
+        m_Camera.SetPosition({ 0.0f, m_terrain->GetHeightAt(0.0f, -5.0f) + 10.0f, -5.0f });
+    }
 
-    barrier = CD3DX12_RESOURCE_BARRIER::Transition(defaultBuffer.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_GENERIC_READ);
-    m_commandList->ResourceBarrier(1, &barrier);
+    if (m_modelLoad.Ready())
+    {
+        LoadedMesh model = m_modelLoad.Take();
+        m_modelVertexBufferGPU = model.VertexBuffer;
+        m_modelIndexBufferGPU = model.IndexBuffer;
+        m_modelVbv = model.Vbv;
+        m_modelIbv = model.Ibv;
+        m_modelQuantization = model.Quantization;
+        m_modelSubmeshes = std::move(model.Submeshes);
+        m_modelMeshlets.Assign(model.Meshlets.data(), model.Meshlets.size(), m_modelSubmeshes.data(), m_modelSubmeshes.size());
+        m_modelLods = std::move(model.Lods);
+        m_modelLodRanges = std::move(model.LodRanges);
+        m_modelMaterials = std::move(model.Materials);
+        m_modelBounds = model.Bounds;
+    }
+}
 
-    return defaultBuffer;
+long long Application::MillisecondsSinceStart() const
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_startTime).count();
 }
\ No newline at end of file
@@ -2,30 +2,18 @@
 
 #include "pch.h"
 #include "Camera.h"
+#include "Mesh.h"
+#include "Meshlet.h"
+#include "Task.h"
+#include "TerrainQuadtree.h"
+#include "TerrainRaycast.h"
+#include "ThreadPool.h"
+#include "UploadQueue.h"
+#include "VertexPacking.h"
+#include <chrono>
 #include <vector>
 #include <string>
 
-struct Vertex
-{
-    DirectX::XMFLOAT3 Pos;
-    DirectX::XMFLOAT3 Normal;
-    DirectX::XMFLOAT3 Albedo;
-    float Metallic;
-    float Roughness;
-    float AO;
-};
-
-struct SimpleVertex
-{
-    DirectX::XMFLOAT3 Pos;
-    DirectX::XMFLOAT3 Color;
-};
-
-struct Model {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned int> indices;
-};
-
 struct Physics {
     DirectX::XMFLOAT3 position;
     DirectX::XMFLOAT3 velocity;
@@ -41,20 +29,39 @@ struct Physics {
     Physics();
 };
 
-class Terrain {
-public:
-    float width, depth;
-    int verticesPerRow, verticesPerCol;
-
-    Terrain(float w = 200.0f, float d = 200.0f, int rows = 50, int cols = 50);
-
-    void GenerateHeightMap();
-    float GetHeightAt(float x, float z);
-    Model GenerateTerrainMesh();
+// Malha ja enviada para a GPU por um carregamento assincrono, pronta para
+// ser adotada pelo frame.
+struct LoadedMesh
+{
+    Microsoft::WRL::ComPtr<ID3D12Resource> VertexBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> IndexBuffer;
+    D3D12_VERTEX_BUFFER_VIEW Vbv = {};
+    D3D12_INDEX_BUFFER_VIEW Ibv = {};
+    UINT IndexCount = 0;
+    VertexQuantization Quantization;
+    std::vector<Submesh> Submeshes;
+    std::vector<Meshlet> Meshlets;
+    std::vector<MeshLod> Lods;
+    std::vector<Submesh> LodRanges;
+    std::vector<Material> Materials;
+    MeshBounds Bounds;
+};
 
-private:
-    std::vector<std::vector<float>> heightMap;
-    DirectX::XMFLOAT3 CalculateNormal(int i, int j);
+// Terreno pronto para o CDLOD: a grade de patch compartilhada e as alturas ja na GPU.
+struct LoadedTerrain
+{
+    Microsoft::WRL::ComPtr<ID3D12Resource> PatchVertexBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> PatchIndexBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> HeightBuffer;
+    Microsoft::WRL::ComPtr<ID3D12Resource> NormalBuffer;
+    D3D12_VERTEX_BUFFER_VIEW Vbv = {};
+    D3D12_INDEX_BUFFER_VIEW Ibv = {};
+    UINT QuarterIndexCount = 0;
+    TerrainHeightLayout Layout;
+    TerrainQuadtree Quadtree;
+    TerrainHeightPyramid Pyramid;   // vazia no modo em blocos
+    Material Surface;
+    std::unique_ptr<Terrain> Source;   // gerado ou aberto no pool; Pyramid aponta para ele
 };
 
 class Application
@@ -75,6 +82,11 @@ private:
     void Update(float dt);
     void UpdatePhysics(float dt);
     void Draw();
+    void DrawTerrain(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos, const DirectX::XMFLOAT3& lightColor);
+    void UploadTerrainEdits();
+    // Primeiro ponto do terreno sob o pixel 'cursor' da janela.
+    TerrainHit PickTerrain(POINT cursor) const;
+    void DrawModel(DirectX::FXMMATRIX view, DirectX::CXMMATRIX proj, const DirectX::XMFLOAT3& cameraPos, const DirectX::XMFLOAT3& lightColor);
 
     bool InitWindow();
     bool InitDirect3D();
@@ -86,21 +98,29 @@ private:
     void FlushCommandQueue();
 
     void BuildRootSignature();
+    void BuildTerrainRootSignature();
     void BuildShadersAndPso();
-    void BuildGeometry();
-    void BuildTerrainGeometry();
-    void BuildLightCircle();
-
-    Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
-        const void* initData,
-        UINT64 byteSize,
-        Microsoft::WRL::ComPtr<ID3D12Resource>& uploadBuffer);
+    // Leitura e upload rodam no m_loadPool; PollLoads adota o resultado no inicio do frame.
+    Task<LoadedMesh> LoadModelAsync(std::string modelPath);
+    Task<LoadedTerrain> LoadTerrainAsync();
+    Task<void> UploadMeshAsync(LoadedMesh& mesh, const void* vertices, size_t vertexCount,
+        const void* indices, size_t indexCount, size_t indexStride);
+    void PollLoads();
+    long long MillisecondsSinceStart() const;
+    void ShowCullStats();
 
 protected:
     static const int SwapChainBufferCount = 2;
+    // Terreno em blocos (HeightTiles.h): arquivo, memoria residente, raio mantido em
+    // volta da camera e resolucao maxima da copia desenhada.
+    static constexpr const char* kTerrainTilePath = "terrain.xht";
+    static constexpr size_t kTerrainTileBudget = size_t(256) << 20;
+    static constexpr float kTerrainResidencyRadius = 1024.0f;
+    static constexpr int kTerrainOverviewSamples = 2049;
 
     HINSTANCE m_hAppInst = nullptr;
     HWND m_hMainWnd = nullptr;
+    std::wstring m_mainWndCaption;
     bool m_appPaused = false;
     bool m_minimized = false;
     bool m_maximized = false;
@@ -136,30 +156,49 @@ protected:
 
     Microsoft::WRL::ComPtr<ID3D12RootSignature> m_rootSignature = nullptr;
     Microsoft::WRL::ComPtr<ID3D12PipelineState> m_pso = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12RootSignature> m_terrainRootSignature = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12PipelineState> m_terrainPso = nullptr;
     std::vector<D3D12_INPUT_ELEMENT_DESC> m_inputLayout;
 
     Microsoft::WRL::ComPtr<ID3D12Resource> m_modelVertexBufferGPU = nullptr;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_modelVertexBufferUploader = nullptr;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_modelIndexBufferGPU = nullptr;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_modelIndexBufferUploader = nullptr;
 
     D3D12_VERTEX_BUFFER_VIEW m_modelVbv = {};
     D3D12_INDEX_BUFFER_VIEW m_modelIbv = {};
-    UINT m_modelIndexCount = 0;
+    std::vector<Submesh> m_modelSubmeshes;
+    MeshletSet m_modelMeshlets;
+    std::vector<DrawRange> m_modelDrawRanges;
+    MeshletCullStats m_modelCullStats;
+    size_t m_shownVisibleTriangles = ~size_t(0);
+    std::vector<MeshLod> m_modelLods;
+    std::vector<Submesh> m_modelLodRanges;
+    MeshBounds m_modelBounds;
+    size_t m_modelLod = 0;
+    VertexQuantization m_modelQuantization;
+    std::vector<Material> m_modelMaterials;
 
     Microsoft::WRL::ComPtr<ID3D12Resource> m_terrainVertexBufferGPU = nullptr;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_terrainVertexBufferUploader = nullptr;
     Microsoft::WRL::ComPtr<ID3D12Resource> m_terrainIndexBufferGPU = nullptr;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_terrainIndexBufferUploader = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_terrainHeightBufferGPU = nullptr;
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_terrainNormalBufferGPU = nullptr;
 
     D3D12_VERTEX_BUFFER_VIEW m_terrainVbv = {};
     D3D12_INDEX_BUFFER_VIEW m_terrainIbv = {};
-    UINT m_terrainIndexCount = 0;
-
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_lightCircleVertexBufferGPU = nullptr;
-    Microsoft::WRL::ComPtr<ID3D12Resource> m_lightCircleVertexBufferUploader = nullptr;
-    D3D12_VERTEX_BUFFER_VIEW m_lightCircleVbv = {};
-    UINT m_lightCircleVertexCount = 0;
+    UINT m_terrainQuarterIndexCount = 0;
+    TerrainHeightLayout m_terrainLayout;
+    TerrainQuadtree m_terrainQuadtree;
+    TerrainHeightPyramid m_terrainPyramid;
+    std::vector<TerrainPatch> m_terrainPatches;
+    TerrainLodStats m_terrainLodStats;
+    size_t m_shownTerrainTriangles = ~size_t(0);
+    Material m_terrainMaterial;
+
+    // Edicoes do terreno: as linhas alteradas das alturas e normais passam por aqui.
+    Microsoft::WRL::ComPtr<ID3D12Resource> m_terrainEditUpload = nullptr;
+    uint8_t* m_terrainEditMapped = nullptr;
+    UINT64 m_terrainEditUploadSize = 0;
+    TerrainStamp m_craterStamp = MakeCraterStamp(20.0f, 6.0f, 2.0f, 1.0f);
+    bool m_craterKeyDown = false;
 
     DirectX::XMFLOAT4X4 m_world;
     DirectX::XMFLOAT3 m_lightPosition = { 0.0f, 0.0f, 0.0f };
@@ -168,6 +207,14 @@ protected:
     POINT m_LastMousePos;
 
 
-    std::unique_ptr<Terrain> m_terrain;
+    std::unique_ptr<Terrain> m_terrain;   // nulo ate PollLoads adotar o terreno carregado
     std::unique_ptr<Physics> m_physics;
+
+    std::chrono::steady_clock::time_point m_startTime;
+    bool m_firstFrameShown = false;
+    AsyncResult<LoadedMesh> m_modelLoad;
+    AsyncResult<LoadedTerrain> m_terrainLoad;
+    std::unique_ptr<UploadQueue> m_uploadQueue;
+    // Por ultimo: e destruido primeiro, antes dos membros que os carregamentos usam.
+    std::unique_ptr<ThreadPool> m_loadPool;
 };
\ No newline at end of file
@@ -10,6 +10,7 @@ public:
     DirectX::XMMATRIX GetProjection() const;
 
     DirectX::XMFLOAT3 GetPosition3f() const { return m_Position; }
+    void SetPosition(const DirectX::XMFLOAT3& position) { m_Position = position; }
 
     void SetLens(float fovY, float aspect, float zn, float zf);
     void UpdateViewMatrix();
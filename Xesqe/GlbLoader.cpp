@@ -0,0 +1,663 @@
+#include "pch.h"
+#include "GlbLoader.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace
+{
+    const uint32_t GlbMagic = 0x46546C67;       // "glTF"
+    const uint32_t GlbChunkJson = 0x4E4F534A;   // "JSON"
+    const uint32_t GlbChunkBin = 0x004E4942;    // "BIN\0"
+
+    const unsigned GlByte = 5120;
+    const unsigned GlUnsignedByte = 5121;
+    const unsigned GlShort = 5122;
+    const unsigned GlUnsignedShort = 5123;
+    const unsigned GlUnsignedInt = 5125;
+    const unsigned GlFloat = 5126;
+    const unsigned GlTriangles = 4;
+
+    [[noreturn]] void GlbError(const std::string& what)
+    {
+        throw std::runtime_error("Arquivo .glb invalido ou nao suportado: " + what);
+    }
+
+    // Arvore JSON minima: so o necessario para ler o chunk JSON do glTF.
+    struct JsonValue
+    {
+        enum class Kind { Null, Bool, Number, String, Array, Object };
+
+        Kind kind = Kind::Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string text;
+        std::vector<JsonValue> items;
+        std::vector<std::pair<std::string, JsonValue>> members;
+
+        const JsonValue* Find(const char* key) const
+        {
+            for (const auto& member : members) {
+                if (member.first == key) return &member.second;
+            }
+            return nullptr;
+        }
+    };
+
+    class JsonReader
+    {
+    public:
+        JsonReader(const char* p, const char* end) : m_p(p), m_end(end) {}
+
+        JsonValue ReadDocument()
+        {
+            JsonValue value = ReadValue(0);
+            SkipSpace();
+            if (m_p != m_end) GlbError("JSON com conteudo depois do documento");
+            return value;
+        }
+
+    private:
+        static constexpr int MaxDepth = 64;
+
+        void SkipSpace()
+        {
+            while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) ++m_p;
+        }
+
+        bool Consume(char c)
+        {
+            SkipSpace();
+            if (m_p < m_end && *m_p == c) {
+                ++m_p;
+                return true;
+            }
+            return false;
+        }
+
+        void Expect(char c)
+        {
+            if (!Consume(c)) GlbError(std::string("JSON sem '") + c + "'");
+        }
+
+        void ExpectLiteral(const char* literal)
+        {
+            const size_t length = std::strlen(literal);
+            if (static_cast<size_t>(m_end - m_p) < length || std::memcmp(m_p, literal, length) != 0) GlbError("JSON com literal invalido");
+            m_p += length;
+        }
+
+        JsonValue ReadValue(int depth)
+        {
+            if (depth > MaxDepth) GlbError("JSON aninhado demais");
+            SkipSpace();
+            if (m_p == m_end) GlbError("JSON truncado");
+
+            JsonValue value;
+            switch (*m_p) {
+            case '{':
+                ++m_p;
+                value.kind = JsonValue::Kind::Object;
+                if (Consume('}')) break;
+                do {
+                    SkipSpace();
+                    std::string key = ReadString();
+                    Expect(':');
+                    value.members.emplace_back(std::move(key), ReadValue(depth + 1));
+                } while (Consume(','));
+                Expect('}');
+                break;
+            case '[':
+                ++m_p;
+                value.kind = JsonValue::Kind::Array;
+                if (Consume(']')) break;
+                do {
+                    value.items.push_back(ReadValue(depth + 1));
+                } while (Consume(','));
+                Expect(']');
+                break;
+            case '"':
+                value.kind = JsonValue::Kind::String;
+                value.text = ReadString();
+                break;
+            case 't':
+                ExpectLiteral("true");
+                value.kind = JsonValue::Kind::Bool;
+                value.boolean = true;
+                break;
+            case 'f':
+                ExpectLiteral("false");
+                value.kind = JsonValue::Kind::Bool;
+                break;
+            case 'n':
+                ExpectLiteral("null");
+                break;
+            default: {
+                value.kind = JsonValue::Kind::Number;
+                auto result = std::from_chars(m_p, m_end, value.number);
+                if (result.ec != std::errc()) GlbError("JSON com numero invalido");
+                m_p = result.ptr;
+                break;
+            }
+            }
+            return value;
+        }
+
+        unsigned ReadHex4()
+        {
+            if (m_end - m_p < 4) GlbError("JSON com escape \\u truncado");
+            unsigned code = 0;
+            auto result = std::from_chars(m_p, m_p + 4, code, 16);
+            if (result.ec != std::errc() || result.ptr != m_p + 4) GlbError("JSON com escape \\u invalido");
+            m_p += 4;
+            return code;
+        }
+
+        static void AppendUtf8(std::string& out, unsigned code)
+        {
+            if (code < 0x80) {
+                out += static_cast<char>(code);
+            }
+            else if (code < 0x800) {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else if (code < 0x10000) {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        std::string ReadString()
+        {
+            if (m_p == m_end || *m_p != '"') GlbError("JSON sem string onde era esperada");
+            ++m_p;
+            std::string text;
+            for (;;) {
+                if (m_p == m_end) GlbError("JSON com string sem fim");
+                char c = *m_p++;
+                if (c == '"') break;
+                if (c != '\\') {
+                    text += c;
+                    continue;
+                }
+                if (m_p == m_end) GlbError("JSON com string sem fim");
+                c = *m_p++;
+                switch (c) {
+                case '"': case '\\': case '/': text += c; break;
+                case 'b': text += '\b'; break;
+                case 'f': text += '\f'; break;
+                case 'n': text += '\n'; break;
+                case 'r': text += '\r'; break;
+                case 't': text += '\t'; break;
+                case 'u': {
+                    unsigned code = ReadHex4();
+                    // Par de surrogates UTF-16 vira um unico codigo.
+                    if (code >= 0xD800 && code < 0xDC00 && m_end - m_p >= 6 && m_p[0] == '\\' && m_p[1] == 'u') {
+                        m_p += 2;
+                        const unsigned low = ReadHex4();
+                        if (low >= 0xDC00 && low < 0xE000) code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        else {
+                            AppendUtf8(text, code);
+                            code = low;
+                        }
+                    }
+                    AppendUtf8(text, code);
+                    break;
+                }
+                default:
+                    GlbError("JSON com escape invalido");
+                }
+            }
+            return text;
+        }
+
+        const char* m_p;
+        const char* m_end;
+    };
+
+    // Leitura tolerante de campos: ausente devolve o padrao, tipo errado e erro.
+    const JsonValue* FindArray(const JsonValue& object, const char* key)
+    {
+        const JsonValue* value = object.Find(key);
+        if (value && value->kind != JsonValue::Kind::Array) GlbError(std::string("'") + key + "' nao e um array");
+        return value;
+    }
+
+    double GetNumber(const JsonValue& object, const char* key, double fallback)
+    {
+        const JsonValue* value = object.Find(key);
+        if (!value) return fallback;
+        if (value->kind != JsonValue::Kind::Number) GlbError(std::string("'") + key + "' nao e um numero");
+        return value->number;
+    }
+
+    size_t ToIndex(const JsonValue& value, const char* what)
+    {
+        if (value.kind != JsonValue::Kind::Number || value.number < 0.0 || value.number > 9007199254740992.0 ||
+            value.number != std::floor(value.number)) {
+            GlbError(std::string("'") + what + "' nao e um inteiro valido");
+        }
+        return static_cast<size_t>(value.number);
+    }
+
+    size_t GetIndex(const JsonValue& object, const char* key, size_t fallback)
+    {
+        const JsonValue* value = object.Find(key);
+        return value ? ToIndex(*value, key) : fallback;
+    }
+
+    size_t GetRequiredIndex(const JsonValue& object, const char* key)
+    {
+        const JsonValue* value = object.Find(key);
+        if (!value) GlbError(std::string("'") + key + "' ausente");
+        return ToIndex(*value, key);
+    }
+
+    const JsonValue& GetElement(const JsonValue& root, const char* arrayKey, size_t index)
+    {
+        const JsonValue* array = FindArray(root, arrayKey);
+        if (!array || index >= array->items.size()) GlbError(std::string("referencia fora de '") + arrayKey + "'");
+        return array->items[index];
+    }
+
+    // Le ate 'count' numeros de um array JSON opcional.
+    void GetFloats(const JsonValue& object, const char* key, float* values, size_t count)
+    {
+        const JsonValue* array = FindArray(object, key);
+        if (!array) return;
+        if (array->items.size() != count) GlbError(std::string("'") + key + "' com tamanho errado");
+        for (size_t i = 0; i < count; ++i) {
+            if (array->items[i].kind != JsonValue::Kind::Number) GlbError(std::string("'") + key + "' com valor nao numerico");
+            values[i] = static_cast<float>(array->items[i].number);
+        }
+    }
+
+    size_t ComponentSize(unsigned componentType)
+    {
+        switch (componentType) {
+        case GlByte: case GlUnsignedByte: return 1;
+        case GlShort: case GlUnsignedShort: return 2;
+        case GlUnsignedInt: case GlFloat: return 4;
+        default: return 0;
+        }
+    }
+
+    unsigned ComponentCountOf(const std::string& type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        GlbError("tipo de accessor '" + type + "'");
+    }
+
+    // Resolve accessor -> bufferView -> chunk BIN, conferindo que todos os
+    // elementos ficam dentro da view e a view dentro do chunk.
+    GlbAccessor ReadAccessor(const JsonValue& root, size_t index, const uint8_t* bin, size_t binSize)
+    {
+        const JsonValue& accessor = GetElement(root, "accessors", index);
+        if (accessor.Find("sparse")) GlbError("accessor esparso");
+        const JsonValue* viewIndex = accessor.Find("bufferView");
+        if (!viewIndex) GlbError("accessor sem bufferView");
+        const JsonValue& view = GetElement(root, "bufferViews", ToIndex(*viewIndex, "bufferView"));
+        if (GetIndex(view, "buffer", 0) != 0) GlbError("bufferView fora do chunk BIN");
+
+        const JsonValue* type = accessor.Find("type");
+        if (!type || type->kind != JsonValue::Kind::String) GlbError("accessor sem tipo");
+
+        GlbAccessor result;
+        result.ComponentType = static_cast<unsigned>(GetRequiredIndex(accessor, "componentType"));
+        result.ComponentCount = ComponentCountOf(type->text);
+        result.Count = GetRequiredIndex(accessor, "count");
+        const JsonValue* normalized = accessor.Find("normalized");
+        result.Normalized = normalized && normalized->kind == JsonValue::Kind::Bool && normalized->boolean;
+
+        const size_t elementSize = result.ElementSize();
+        if (elementSize == 0) GlbError("componentType " + std::to_string(result.ComponentType));
+        const size_t viewOffset = GetIndex(view, "byteOffset", 0);
+        const size_t viewLength = GetRequiredIndex(view, "byteLength");
+        const size_t viewStride = GetIndex(view, "byteStride", 0);
+        const size_t accessorOffset = GetIndex(accessor, "byteOffset", 0);
+        result.Stride = viewStride ? viewStride : elementSize;
+
+        if (viewOffset > binSize || viewLength > binSize - viewOffset) GlbError("bufferView fora do chunk BIN");
+        if (result.Stride < elementSize || result.Stride > 256) GlbError("byteStride invalido");
+        if (result.Count > 0 && (result.Count > viewLength || accessorOffset > viewLength ||
+            (result.Count - 1) * result.Stride + elementSize > viewLength - accessorOffset)) {
+            GlbError("accessor fora do bufferView");
+        }
+
+        result.Data = bin + viewOffset + accessorOffset;
+        return result;
+    }
+
+    XMFLOAT3 ReadFloat3(const GlbAccessor& accessor, size_t i)
+    {
+        XMFLOAT3 value;
+        std::memcpy(&value, accessor.Data + i * accessor.Stride, sizeof(value));
+        return value;
+    }
+
+    unsigned int ReadIndex(const GlbAccessor& accessor, size_t i)
+    {
+        const uint8_t* p = accessor.Data + i * accessor.Stride;
+        if (accessor.ComponentType == GlUnsignedByte) return *p;
+        if (accessor.ComponentType == GlUnsignedShort) {
+            uint16_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    bool IsFloat3(const GlbAccessor& accessor)
+    {
+        return accessor.ComponentType == GlFloat && accessor.ComponentCount == 3;
+    }
+
+    XMMATRIX NodeLocalMatrix(const JsonValue& node)
+    {
+        if (node.Find("matrix")) {
+            // Coluna-maior com vetores coluna no glTF = linha-maior com vetores linha aqui.
+            XMFLOAT4X4 matrix;
+            GetFloats(node, "matrix", &matrix.m[0][0], 16);
+            return XMLoadFloat4x4(&matrix);
+        }
+        float scale[3] = { 1.0f, 1.0f, 1.0f };
+        float rotation[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+        float translation[3] = { 0.0f, 0.0f, 0.0f };
+        GetFloats(node, "scale", scale, 3);
+        GetFloats(node, "rotation", rotation, 4);
+        GetFloats(node, "translation", translation, 3);
+        return XMMatrixMultiply(XMMatrixMultiply(XMMatrixScaling(scale[0], scale[1], scale[2]),
+            XMMatrixRotationQuaternion(XMVectorSet(rotation[0], rotation[1], rotation[2], rotation[3]))),
+            XMMatrixTranslation(translation[0], translation[1], translation[2]));
+    }
+
+    void CollectInstances(const JsonValue& root, size_t nodeIndex, FXMMATRIX parent, size_t depth,
+        size_t meshCount, std::vector<GlbInstance>& instances)
+    {
+        const JsonValue* nodes = FindArray(root, "nodes");
+        // Mais niveis que nos so acontece com ciclo na hierarquia.
+        if (!nodes || depth > nodes->items.size()) GlbError("hierarquia de nos invalida");
+        const JsonValue& node = GetElement(root, "nodes", nodeIndex);
+        const XMMATRIX world = XMMatrixMultiply(NodeLocalMatrix(node), parent);
+
+        const JsonValue* mesh = node.Find("mesh");
+        if (mesh) {
+            GlbInstance instance;
+            instance.Mesh = ToIndex(*mesh, "mesh");
+            if (instance.Mesh >= meshCount) GlbError("referencia fora de 'meshes'");
+            XMStoreFloat4x4(&instance.World, world);
+            instances.push_back(instance);
+        }
+        if (const JsonValue* children = FindArray(node, "children")) {
+            for (const JsonValue& child : children->items) {
+                CollectInstances(root, ToIndex(child, "children"), world, depth + 1, meshCount, instances);
+            }
+        }
+    }
+
+    Material ToMaterial(const GlbMaterial& source)
+    {
+        Material material;
+        material.Albedo = { source.BaseColor.x, source.BaseColor.y, source.BaseColor.z };
+        material.Metallic = source.Metallic;
+        material.Roughness = source.Roughness;
+        material.AO = 1.0f;
+        return material;
+    }
+
+    void AppendPrimitive(Model& model, const GlbPrimitive& primitive, FXMMATRIX world)
+    {
+        const size_t baseVertex = model.vertices.size();
+        const size_t firstIndex = model.indices.size();
+        const size_t vertexCount = primitive.Positions.Count;
+
+        if (primitive.Indices.Data) {
+            const size_t count = primitive.Indices.Count;
+            model.indices.resize(firstIndex + count);
+            unsigned int* out = model.indices.data() + firstIndex;
+            if (primitive.Indices.ComponentType == GlUnsignedInt && primitive.Indices.IsPacked()) {
+                std::memcpy(out, primitive.Indices.Data, count * sizeof(unsigned int));
+            }
+            else {
+                for (size_t i = 0; i < count; ++i) out[i] = ReadIndex(primitive.Indices, i);
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (out[i] >= vertexCount) GlbError("indice fora do accessor POSITION");
+                out[i] += static_cast<unsigned int>(baseVertex);
+            }
+        }
+        else {
+            for (size_t i = 0; i < vertexCount; ++i) model.indices.push_back(static_cast<unsigned int>(baseVertex + i));
+        }
+        model.indices.resize(firstIndex + (model.indices.size() - firstIndex) / 3 * 3);
+
+        // Normais usam a matriz de cofatores (inversa transposta a menos da escala).
+        XMFLOAT4X4 m;
+        XMStoreFloat4x4(&m, world);
+        const XMVECTOR r0 = XMVectorSet(m(0, 0), m(0, 1), m(0, 2), 0.0f);
+        const XMVECTOR r1 = XMVectorSet(m(1, 0), m(1, 1), m(1, 2), 0.0f);
+        const XMVECTOR r2 = XMVectorSet(m(2, 0), m(2, 1), m(2, 2), 0.0f);
+        const XMVECTOR c0 = XMVector3Cross(r1, r2);
+        const XMVECTOR c1 = XMVector3Cross(r2, r0);
+        const XMVECTOR c2 = XMVector3Cross(r0, r1);
+        const bool mirrored = XMVectorGetX(XMVector3Dot(r0, c0)) < 0.0f;
+
+        const bool hasNormals = primitive.Normals.Data && primitive.Normals.Count >= vertexCount;
+        model.vertices.reserve(baseVertex + vertexCount);
+        for (size_t i = 0; i < vertexCount; ++i) {
+            XMFLOAT3 position = ReadFloat3(primitive.Positions, i);
+            XMStoreFloat3(&position, XMVector3TransformCoord(XMLoadFloat3(&position), world));
+            position.z = -position.z;
+
+            XMFLOAT3 normal = { 0.0f, 1.0f, 0.0f };
+            if (hasNormals) {
+                const XMFLOAT3 n = ReadFloat3(primitive.Normals, i);
+                XMVECTOR v = XMVectorMultiplyAdd(XMVectorReplicate(n.x), c0,
+                    XMVectorMultiplyAdd(XMVectorReplicate(n.y), c1, XMVectorScale(c2, n.z)));
+                if (mirrored) v = XMVectorNegate(v);
+                if (XMVectorGetX(XMVector3LengthSq(v)) > 0.0f) XMStoreFloat3(&normal, XMVector3Normalize(v));
+                normal.z = -normal.z;
+            }
+            Vertex vertex;
+            vertex.Pos = position;
+            vertex.Normal = normal;
+            model.vertices.push_back(vertex);
+        }
+
+        // Inverter z troca a orientacao; uma matriz espelhada ja tinha trocado.
+        unsigned int* indices = model.indices.data() + firstIndex;
+        const size_t indexCount = model.indices.size() - firstIndex;
+        if (!mirrored) {
+            for (size_t t = 0; t < indexCount; t += 3) std::swap(indices[t + 1], indices[t + 2]);
+        }
+
+        if (!hasNormals) {
+            // Soma das normais de face (ponderadas pela area), no mesmo sentido de OptimizeOverdraw.
+            std::vector<XMFLOAT3> sums(vertexCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+            for (size_t t = 0; t < indexCount; t += 3) {
+                const XMVECTOR p0 = XMLoadFloat3(&model.vertices[indices[t + 0]].Pos);
+                const XMVECTOR p1 = XMLoadFloat3(&model.vertices[indices[t + 1]].Pos);
+                const XMVECTOR p2 = XMLoadFloat3(&model.vertices[indices[t + 2]].Pos);
+                const XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+                for (size_t k = 0; k < 3; ++k) {
+                    XMFLOAT3& sum = sums[indices[t + k] - baseVertex];
+                    XMStoreFloat3(&sum, XMVectorAdd(XMLoadFloat3(&sum), n));
+                }
+            }
+            for (size_t i = 0; i < vertexCount; ++i) {
+                const XMVECTOR n = XMLoadFloat3(&sums[i]);
+                if (XMVectorGetX(XMVector3LengthSq(n)) > 0.0f) XMStoreFloat3(&model.vertices[baseVertex + i].Normal, XMVector3Normalize(n));
+            }
+        }
+    }
+}
+
+size_t GlbAccessor::ElementSize() const
+{
+    return ComponentSize(ComponentType) * ComponentCount;
+}
+
+GlbFile::GlbFile(const std::string& path)
+    : m_file(path)
+{
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(m_file.Data());
+    const size_t size = m_file.Size();
+    auto readU32 = [&](size_t offset) {
+        uint32_t value;
+        std::memcpy(&value, data + offset, sizeof(value));
+        return value;
+    };
+
+    if (size < 20 || readU32(0) != GlbMagic) GlbError(path + " nao e um .glb");
+    if (readU32(4) != 2) GlbError(path + " nao e glTF 2.0");
+    const size_t length = std::min<size_t>(readU32(8), size);
+
+    // Chunks: JSON obrigatorio e primeiro; BIN opcional logo depois.
+    const size_t jsonLength = readU32(12);
+    if (readU32(16) != GlbChunkJson || jsonLength > length - 20) GlbError(path + ": chunk JSON invalido");
+    const char* json = m_file.Data() + 20;
+
+    const uint8_t* bin = nullptr;
+    size_t binSize = 0;
+    const size_t binHeader = 20 + ((jsonLength + 3) & ~size_t(3));
+    if (binHeader + 8 <= length && readU32(binHeader + 4) == GlbChunkBin) {
+        binSize = readU32(binHeader);
+        if (binSize > length - binHeader - 8) GlbError(path + ": chunk BIN invalido");
+        bin = data + binHeader + 8;
+    }
+
+    const JsonValue root = JsonReader(json, json + jsonLength).ReadDocument();
+    if (root.kind != JsonValue::Kind::Object) GlbError(path + ": JSON sem objeto raiz");
+
+    if (const JsonValue* buffers = FindArray(root, "buffers")) {
+        if (buffers->items.size() > 1 || (!buffers->items.empty() && buffers->items[0].Find("uri"))) {
+            GlbError(path + ": buffers externos");
+        }
+        if (!buffers->items.empty() && GetRequiredIndex(buffers->items[0], "byteLength") > binSize) {
+            GlbError(path + ": buffer maior que o chunk BIN");
+        }
+    }
+
+    if (const JsonValue* materials = FindArray(root, "materials")) {
+        for (const JsonValue& source : materials->items) {
+            GlbMaterial material;
+            if (const JsonValue* pbr = source.Find("pbrMetallicRoughness")) {
+                GetFloats(*pbr, "baseColorFactor", &material.BaseColor.x, 4);
+                material.Metallic = static_cast<float>(GetNumber(*pbr, "metallicFactor", material.Metallic));
+                material.Roughness = static_cast<float>(GetNumber(*pbr, "roughnessFactor", material.Roughness));
+            }
+            m_materials.push_back(material);
+        }
+    }
+
+    if (const JsonValue* meshes = FindArray(root, "meshes")) {
+        for (const JsonValue& source : meshes->items) {
+            GlbMesh mesh;
+            if (const JsonValue* name = source.Find("name")) mesh.Name = name->text;
+            const JsonValue* primitives = FindArray(source, "primitives");
+            if (!primitives) GlbError(path + ": mesh sem primitives");
+
+            for (const JsonValue& prim : primitives->items) {
+                const JsonValue* attributes = prim.Find("attributes");
+                if (GetIndex(prim, "mode", GlTriangles) != GlTriangles || !attributes || !attributes->Find("POSITION")) continue;
+
+                GlbPrimitive primitive;
+                primitive.Positions = ReadAccessor(root, GetRequiredIndex(*attributes, "POSITION"), bin, binSize);
+                if (!IsFloat3(primitive.Positions)) GlbError(path + ": POSITION precisa ser float VEC3");
+                if (attributes->Find("NORMAL")) {
+                    primitive.Normals = ReadAccessor(root, GetRequiredIndex(*attributes, "NORMAL"), bin, binSize);
+                    if (!IsFloat3(primitive.Normals)) GlbError(path + ": NORMAL precisa ser float VEC3");
+                }
+                if (prim.Find("indices")) {
+                    primitive.Indices = ReadAccessor(root, GetRequiredIndex(prim, "indices"), bin, binSize);
+                    const unsigned type = primitive.Indices.ComponentType;
+                    if (primitive.Indices.ComponentCount != 1 || (type != GlUnsignedByte && type != GlUnsignedShort && type != GlUnsignedInt)) {
+                        GlbError(path + ": tipo de indice invalido");
+                    }
+                }
+                if (prim.Find("material")) {
+                    const size_t material = GetRequiredIndex(prim, "material");
+                    if (material >= m_materials.size()) GlbError(path + ": referencia fora de 'materials'");
+                    primitive.Material = static_cast<int>(material);
+                }
+                mesh.Primitives.push_back(primitive);
+            }
+            m_meshes.push_back(std::move(mesh));
+        }
+    }
+
+    // Sem cenas, cada mesh aparece uma vez na origem.
+    const JsonValue* scenes = FindArray(root, "scenes");
+    if (scenes && !scenes->items.empty()) {
+        const JsonValue& scene = GetElement(root, "scenes", GetIndex(root, "scene", 0));
+        if (const JsonValue* nodes = FindArray(scene, "nodes")) {
+            for (const JsonValue& node : nodes->items) {
+                CollectInstances(root, ToIndex(node, "nodes"), XMMatrixIdentity(), 0, m_meshes.size(), m_instances);
+            }
+        }
+    }
+    else {
+        for (size_t i = 0; i < m_meshes.size(); ++i) {
+            GlbInstance instance;
+            instance.Mesh = i;
+            XMStoreFloat4x4(&instance.World, XMMatrixIdentity());
+            m_instances.push_back(instance);
+        }
+    }
+}
+
+Model load_model_from_glb(const std::string& path)
+{
+    GlbFile file(path);
+
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for (const GlbInstance& instance : file.Instances()) {
+        for (const GlbPrimitive& primitive : file.Meshes()[instance.Mesh].Primitives) {
+            vertexCount += primitive.Positions.Count;
+            indexCount += primitive.Indices.Data ? primitive.Indices.Count : primitive.Positions.Count;
+        }
+    }
+
+    Model model;
+    model.vertices.reserve(vertexCount);
+    model.indices.reserve(indexCount);
+    // Materiais do arquivo na mesma ordem; primitivas sem material usam o
+    // padrao do glTF, acrescentado no fim da tabela.
+    for (const GlbMaterial& material : file.Materials()) model.materials.push_back(ToMaterial(material));
+    const unsigned int defaultMaterial = static_cast<unsigned int>(model.materials.size());
+    model.materials.push_back(ToMaterial(GlbMaterial()));
+
+    // Cada instancia (no da cena) e uma parte.
+    std::vector<SubmeshRun> runs;
+    for (size_t i = 0; i < file.Instances().size(); ++i) {
+        const GlbInstance& instance = file.Instances()[i];
+        const XMMATRIX world = XMLoadFloat4x4(&instance.World);
+        for (const GlbPrimitive& primitive : file.Meshes()[instance.Mesh].Primitives) {
+            SubmeshRun run;
+            run.IndexStart = model.indices.size();
+            run.Material = primitive.Material >= 0 ? static_cast<unsigned int>(primitive.Material) : defaultMaterial;
+            run.Part = static_cast<unsigned int>(i);
+            runs.push_back(run);
+            AppendPrimitive(model, primitive, world);
+        }
+    }
+    BuildSubmeshes(model, runs);
+    return model;
+}
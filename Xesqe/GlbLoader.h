@@ -0,0 +1,77 @@
+#pragma once
+#include "Mesh.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+
+// Visao de um accessor do glTF direto no chunk BIN do arquivo mapeado, sem copia.
+// Valida enquanto o GlbFile de origem existir.
+struct GlbAccessor
+{
+    const uint8_t* Data = nullptr;  // primeiro elemento; nulo se o accessor nao existe
+    size_t Count = 0;
+    size_t Stride = 0;              // bytes entre elementos consecutivos
+    unsigned ComponentType = 0;     // codigo GL: 5121 ubyte, 5123 ushort, 5125 uint, 5126 float...
+    unsigned ComponentCount = 0;    // 1 = SCALAR, 3 = VEC3...
+    bool Normalized = false;
+
+    size_t ElementSize() const;
+    // Elementos contiguos: a faixa [Data, Data + Count * Stride) pode ir inteira para um buffer.
+    bool IsPacked() const { return Stride == ElementSize(); }
+};
+
+struct GlbPrimitive
+{
+    GlbAccessor Positions;          // float VEC3
+    GlbAccessor Normals;            // float VEC3, opcional
+    GlbAccessor Indices;            // ubyte, ushort ou uint; Data nulo = sem indices
+    int Material = -1;
+};
+
+struct GlbMesh
+{
+    std::string Name;
+    std::vector<GlbPrimitive> Primitives;   // so triangulos (mode 4)
+};
+
+// Fatores de pbrMetallicRoughness; texturas sao ignoradas.
+struct GlbMaterial
+{
+    DirectX::XMFLOAT4 BaseColor = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float Metallic = 1.0f;
+    float Roughness = 1.0f;
+};
+
+// Uma mesh posicionada por um no da cena, com a transformacao acumulada
+// (convencao do glTF: Y para cima, mao direita).
+struct GlbInstance
+{
+    size_t Mesh = 0;
+    DirectX::XMFLOAT4X4 World;
+};
+
+// Arquivo .glb (glTF 2.0 binario) mapeado na memoria. Le o JSON uma vez e
+// expoe meshes, materiais e instancias; os dados dos vertices e indices ficam
+// no mapeamento. Lanca std::runtime_error para arquivos invalidos ou recursos
+// nao suportados (buffers externos, accessors esparsos).
+class GlbFile
+{
+public:
+    explicit GlbFile(const std::string& path);
+
+    const std::vector<GlbMesh>& Meshes() const { return m_meshes; }
+    const std::vector<GlbMaterial>& Materials() const { return m_materials; }
+    const std::vector<GlbInstance>& Instances() const { return m_instances; }
+
+private:
+    MappedFile m_file;
+    std::vector<GlbMesh> m_meshes;
+    std::vector<GlbMaterial> m_materials;
+    std::vector<GlbInstance> m_instances;
+};
+
+// Carrega todas as instancias da cena num unico Model com indices globais, como
+// load_model_from_obj, com uma Submesh por (instancia, material). Converte para mao esquerda
+// (z invertido, ordem dos triangulos trocada); primitivas sem normais recebem
+// normais suavizadas. Indices uint32 contiguos sao copiados em bloco.
+Model load_model_from_glb(const std::string& path);
@@ -0,0 +1,281 @@
+#include "pch.h"
+#include "HeightTiles.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    uint64_t TileOffset(uint32_t key)
+    {
+        return HeightTileAlignment + uint64_t(key) * HeightTileBytes;
+    }
+
+    // Pede ao SO para ler o bloco agora, em vez de uma falha de pagina por vez.
+    void WillNeed(const uint16_t* samples)
+    {
+#ifdef _WIN32
+        WIN32_MEMORY_RANGE_ENTRY range = { const_cast<uint16_t*>(samples), SIZE_T(HeightTileBytes) };
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+        madvise(const_cast<uint16_t*>(samples), HeightTileBytes, MADV_WILLNEED);
+#endif
+    }
+}
+
+void ImportRawHeightmap(const RawHeightmapDesc& desc, const std::string& outPath)
+{
+    MappedFile raw(desc.Path);
+    uint32_t samplesX = desc.SamplesX;
+    uint32_t samplesZ = desc.SamplesZ;
+    if (samplesX == 0 && samplesZ == 0) {
+        samplesX = samplesZ = uint32_t(std::lround(std::sqrt(double(raw.Size() / 2))));
+    }
+    if (samplesX < 2 || samplesZ < 2 || uint64_t(samplesX) * samplesZ * 2 != raw.Size()) {
+        throw std::runtime_error("O tamanho do heightmap nao confere com as dimensoes: " + desc.Path);
+    }
+
+    HeightTileHeader header;
+    header.SamplesX = samplesX;
+    header.SamplesZ = samplesZ;
+    header.TilesX = (samplesX - 1 + HeightTileQuads - 1) / HeightTileQuads;
+    header.TilesZ = (samplesZ - 1 + HeightTileQuads - 1) / HeightTileQuads;
+    header.SpacingX = desc.SpacingX;
+    header.SpacingZ = desc.SpacingZ;
+    header.HeightScale = desc.HeightScale;
+    header.HeightOffset = desc.HeightOffset;
+
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Nao foi possivel criar o arquivo: " + outPath);
+    }
+    std::vector<char> first(HeightTileAlignment, 0);
+    std::memcpy(first.data(), &header, sizeof(header));
+    out.write(first.data(), first.size());
+
+    // Um bloco por vez; amostras alem da borda repetem a ultima linha/coluna.
+    const unsigned char* src = reinterpret_cast<const unsigned char*>(raw.Data());
+    std::vector<uint16_t> tile(size_t(HeightTileSamples) * HeightTileSamples);
+    for (uint32_t tx = 0; tx < header.TilesX; ++tx) {
+        for (uint32_t tz = 0; tz < header.TilesZ; ++tz) {
+            for (uint32_t lj = 0; lj < HeightTileSamples; ++lj) {
+                const uint32_t j = std::min(tz * HeightTileQuads + lj, samplesZ - 1);
+                const unsigned char* row = src + size_t(j) * samplesX * 2;
+                for (uint32_t li = 0; li < HeightTileSamples; ++li) {
+                    const unsigned char* p = row + size_t(std::min(tx * HeightTileQuads + li, samplesX - 1)) * 2;
+                    tile[size_t(li) * HeightTileSamples + lj] = desc.BigEndian ?
+                        uint16_t((p[0] << 8) | p[1]) : uint16_t(p[0] | (p[1] << 8));
+                }
+            }
+            out.write(reinterpret_cast<const char*>(tile.data()), HeightTileBytes);
+        }
+    }
+    if (!out) {
+        throw std::runtime_error("Falha ao gravar o arquivo: " + outPath);
+    }
+}
+
+HeightTileCache::HeightTileCache(const std::string& path, size_t memoryBudget)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        throw std::runtime_error("Nao foi possivel abrir o arquivo: " + path);
+    }
+    const uint64_t fileSize = uint64_t(in.tellg());
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(&m_header), sizeof(m_header));
+    if (!in || std::memcmp(m_header.Magic, "XHT1", 4) != 0 || m_header.SamplesX < 2 || m_header.SamplesZ < 2 ||
+        m_header.TilesX == 0 || m_header.TilesZ == 0 ||
+        uint64_t(m_header.TilesX) * HeightTileQuads + 1 < m_header.SamplesX ||
+        uint64_t(m_header.TilesZ) * HeightTileQuads + 1 < m_header.SamplesZ ||
+        fileSize < TileOffset(m_header.TilesX * m_header.TilesZ)) {
+        throw std::runtime_error("Arquivo de blocos de altura invalido: " + path);
+    }
+    in.close();
+
+    // Pelo menos um bloco, senao nenhuma consulta teria onde ler.
+    m_maxTiles = std::max<size_t>(memoryBudget / HeightTileBytes, 1);
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Nao foi possivel abrir o arquivo: " + path);
+    }
+    m_file = file;
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        Close();
+        throw std::runtime_error("Nao foi possivel mapear o arquivo: " + path);
+    }
+#else
+    m_fd = open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        throw std::runtime_error("Nao foi possivel abrir o arquivo: " + path);
+    }
+#endif
+}
+
+HeightTileCache::~HeightTileCache()
+{
+    Close();
+}
+
+void HeightTileCache::Close()
+{
+    for (auto& [key, tile] : m_tiles) {
+        UnmapTile(tile.Samples);
+    }
+    m_tiles.clear();
+    m_lru.clear();
+#ifdef _WIN32
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file) CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = nullptr;
+#else
+    if (m_fd >= 0) close(m_fd);
+    m_fd = -1;
+#endif
+}
+
+const uint16_t* HeightTileCache::MapTile(uint64_t offset)
+{
+#ifdef _WIN32
+    void* view = MapViewOfFile(m_mapping, FILE_MAP_READ, DWORD(offset >> 32), DWORD(offset), SIZE_T(HeightTileBytes));
+    if (!view) {
+        throw std::runtime_error("Nao foi possivel mapear um bloco de alturas.");
+    }
+#else
+    void* view = mmap(nullptr, HeightTileBytes, PROT_READ, MAP_SHARED, m_fd, off_t(offset));
+    if (view == MAP_FAILED) {
+        throw std::runtime_error("Nao foi possivel mapear um bloco de alturas.");
+    }
+#endif
+    return static_cast<const uint16_t*>(view);
+}
+
+void HeightTileCache::UnmapTile(const uint16_t* samples)
+{
+#ifdef _WIN32
+    UnmapViewOfFile(samples);
+#else
+    munmap(const_cast<uint16_t*>(samples), HeightTileBytes);
+#endif
+}
+
+// Chamado com m_mutex travado.
+const uint16_t* HeightTileCache::AcquireTile(uint32_t tx, uint32_t tz)
+{
+    const uint32_t key = tx * m_header.TilesZ + tz;
+    auto found = m_tiles.find(key);
+    if (found != m_tiles.end()) {
+        m_lru.splice(m_lru.begin(), m_lru, found->second.LruPosition);
+        return found->second.Samples;
+    }
+
+    while (m_tiles.size() >= m_maxTiles) {
+        auto victim = m_tiles.find(m_lru.back());
+        UnmapTile(victim->second.Samples);
+        m_tiles.erase(victim);
+        m_lru.pop_back();
+        m_stats.Evictions++;
+    }
+
+    Tile tile;
+    tile.Samples = MapTile(TileOffset(key));
+    m_lru.push_front(key);
+    tile.LruPosition = m_lru.begin();
+    m_tiles.emplace(key, tile);
+    m_stats.Faults++;
+    return tile.Samples;
+}
+
+float HeightTileCache::Height(int i, int j)
+{
+    i = std::clamp(i, 0, int(m_header.SamplesX) - 1);
+    j = std::clamp(j, 0, int(m_header.SamplesZ) - 1);
+    // A ultima amostra de um mapa com (Samples - 1) multiplo de HeightTileQuads e a borda do ultimo bloco.
+    const uint32_t tx = std::min(uint32_t(i) / HeightTileQuads, m_header.TilesX - 1);
+    const uint32_t tz = std::min(uint32_t(j) / HeightTileQuads, m_header.TilesZ - 1);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint16_t* samples = AcquireTile(tx, tz);
+    const uint16_t sample = samples[size_t(i - tx * HeightTileQuads) * HeightTileSamples + (j - tz * HeightTileQuads)];
+    return m_header.HeightOffset + m_header.HeightScale * sample;
+}
+
+void HeightTileCache::Cell(int i, int j, float& h00, float& h10, float& h01, float& h11)
+{
+    i = std::clamp(i, 0, int(m_header.SamplesX) - 2);
+    j = std::clamp(j, 0, int(m_header.SamplesZ) - 2);
+    const uint32_t tx = uint32_t(i) / HeightTileQuads;
+    const uint32_t tz = uint32_t(j) / HeightTileQuads;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint16_t* cell = AcquireTile(tx, tz) +
+        size_t(i - tx * HeightTileQuads) * HeightTileSamples + (j - tz * HeightTileQuads);
+    h00 = m_header.HeightOffset + m_header.HeightScale * cell[0];
+    h01 = m_header.HeightOffset + m_header.HeightScale * cell[1];
+    h10 = m_header.HeightOffset + m_header.HeightScale * cell[HeightTileSamples];
+    h11 = m_header.HeightOffset + m_header.HeightScale * cell[HeightTileSamples + 1];
+}
+
+void HeightTileCache::Prefetch(float x, float z, float radius)
+{
+    // Mesma grade de Terrain: a amostra i fica em -(SamplesX / 2) * SpacingX + i * SpacingX.
+    const float tileSizeX = HeightTileQuads * m_header.SpacingX;
+    const float tileSizeZ = HeightTileQuads * m_header.SpacingZ;
+    const float localX = x + (m_header.SamplesX / 2.0f) * m_header.SpacingX;
+    const float localZ = z + (m_header.SamplesZ / 2.0f) * m_header.SpacingZ;
+    const int firstX = std::max(int(std::floor((localX - radius) / tileSizeX)), 0);
+    const int lastX = std::min(int(std::floor((localX + radius) / tileSizeX)), int(m_header.TilesX) - 1);
+    const int firstZ = std::max(int(std::floor((localZ - radius) / tileSizeZ)), 0);
+    const int lastZ = std::min(int(std::floor((localZ + radius) / tileSizeZ)), int(m_header.TilesZ) - 1);
+
+    struct Candidate
+    {
+        float Distance2;
+        uint32_t X, Z;
+    };
+    std::vector<Candidate> candidates;
+    for (int tx = firstX; tx <= lastX; ++tx) {
+        for (int tz = firstZ; tz <= lastZ; ++tz) {
+            const float dx = std::max({ tx * tileSizeX - localX, 0.0f, localX - (tx + 1) * tileSizeX });
+            const float dz = std::max({ tz * tileSizeZ - localZ, 0.0f, localZ - (tz + 1) * tileSizeZ });
+            if (dx * dx + dz * dz <= radius * radius) candidates.push_back({ dx * dx + dz * dz, uint32_t(tx), uint32_t(tz) });
+        }
+    }
+
+    // So os mais proximos que cabem no orcamento, do mais distante ao mais
+    // proximo, para o mais proximo terminar no topo da LRU.
+    std::sort(candidates.begin(), candidates.end(),
+        [](const Candidate& a, const Candidate& b) { return a.Distance2 < b.Distance2; });
+    candidates.resize(std::min(candidates.size(), m_maxTiles));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto it = candidates.rbegin(); it != candidates.rend(); ++it) {
+        const size_t faults = m_stats.Faults;
+        const uint16_t* samples = AcquireTile(it->X, it->Z);
+        if (m_stats.Faults != faults) WillNeed(samples);
+    }
+}
+
+HeightTileCache::Stats HeightTileCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.ResidentTiles = m_tiles.size();
+    stats.ResidentBytes = m_tiles.size() * size_t(HeightTileBytes);
+    return stats;
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Heightfield em blocos no disco (.xht). Depois do cabecalho vem cada bloco com
+// TileSamples x TileSamples amostras de 16 bits, na ordem (tx, tz) e alinhado a
+// HeightTileAlignment, para poder ser mapeado sozinho. Blocos vizinhos repetem a
+// linha da borda, entao a celula de qualquer amostra cabe num unico bloco.
+constexpr uint32_t HeightTileSamples = 256;
+constexpr uint32_t HeightTileQuads = HeightTileSamples - 1;
+constexpr uint64_t HeightTileAlignment = 64 * 1024;   // granularidade do MapViewOfFile
+constexpr uint64_t HeightTileBytes = uint64_t(HeightTileSamples) * HeightTileSamples * sizeof(uint16_t);
+
+struct HeightTileHeader
+{
+    char Magic[4] = { 'X', 'H', 'T', '1' };
+    uint32_t SamplesX = 0;
+    uint32_t SamplesZ = 0;
+    uint32_t TilesX = 0;
+    uint32_t TilesZ = 0;
+    float SpacingX = 1.0f;
+    float SpacingZ = 1.0f;
+    float HeightScale = 1.0f;    // altura = HeightOffset + HeightScale * amostra
+    float HeightOffset = 0.0f;
+};
+
+// Heightmap cru de 16 bits sem cabecalho (.r16/.raw de World Machine, Gaea,
+// Unity, L3DT...): SamplesZ linhas de SamplesX amostras, a amostra (i, j) em
+// [j * SamplesX + i]. Com SamplesX e SamplesZ em 0 o mapa e tomado como quadrado.
+struct RawHeightmapDesc
+{
+    std::string Path;
+    uint32_t SamplesX = 0;
+    uint32_t SamplesZ = 0;
+    bool BigEndian = false;      // ordem "Mac" do Photoshop
+    float SpacingX = 1.0f;
+    float SpacingZ = 1.0f;
+    float HeightScale = 1.0f / 65535.0f;
+    float HeightOffset = 0.0f;
+};
+
+// Converte o heightmap cru para o formato em blocos, um bloco por vez.
+void ImportRawHeightmap(const RawHeightmapDesc& desc, const std::string& outPath);
+
+// Abre um .xht e mapeia os blocos sob demanda. Os blocos residentes formam uma
+// LRU limitada a memoryBudget bytes; os metodos podem ser chamados de qualquer thread.
+class HeightTileCache
+{
+public:
+    HeightTileCache(const std::string& path, size_t memoryBudget);
+    HeightTileCache(const HeightTileCache& rhs) = delete;
+    HeightTileCache& operator=(const HeightTileCache& rhs) = delete;
+    ~HeightTileCache();
+
+    const HeightTileHeader& Header() const { return m_header; }
+
+    // Altura da amostra (i, j); indices fora do mapa sao presos a borda.
+    float Height(int i, int j);
+    // As quatro alturas da celula (i, j)-(i + 1, j + 1), com uma so busca de bloco.
+    void Cell(int i, int j, float& h00, float& h10, float& h01, float& h11);
+
+    // Mapeia (e pede ao SO para ler) os blocos a ate 'radius' unidades de (x, z),
+    // em coordenadas de mundo com o mapa centrado na origem, como Terrain.
+    void Prefetch(float x, float z, float radius);
+
+    struct Stats
+    {
+        size_t ResidentTiles = 0;
+        size_t ResidentBytes = 0;
+        size_t Faults = 0;
+        size_t Evictions = 0;
+    };
+    Stats GetStats();
+
+private:
+    struct Tile
+    {
+        const uint16_t* Samples = nullptr;
+        std::list<uint32_t>::iterator LruPosition;
+    };
+
+    const uint16_t* AcquireTile(uint32_t tx, uint32_t tz);
+    const uint16_t* MapTile(uint64_t offset);
+    void UnmapTile(const uint16_t* samples);
+    void Close();
+
+    HeightTileHeader m_header;
+    size_t m_maxTiles = 0;
+    std::mutex m_mutex;
+    std::unordered_map<uint32_t, Tile> m_tiles;   // chave tx * TilesZ + tz
+    std::list<uint32_t> m_lru;                     // mais recente na frente
+    Stats m_stats;
+#ifdef _WIN32
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
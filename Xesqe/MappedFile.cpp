@@ -0,0 +1,137 @@
+#include "pch.h"
+#include "MappedFile.h"
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Nao foi possivel abrir o arquivo: " + path);
+    }
+    m_file = file;
+
+    LARGE_INTEGER size = {};
+    if (!GetFileSizeEx(file, &size)) {
+        Close();
+        throw std::runtime_error("Nao foi possivel obter o tamanho do arquivo: " + path);
+    }
+    m_size = static_cast<size_t>(size.QuadPart);
+
+    // Arquivos vazios nao podem ser mapeados; ficam com Data() == nullptr e Size() == 0.
+    if (m_size == 0) return;
+
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        Close();
+        throw std::runtime_error("Nao foi possivel mapear o arquivo: " + path);
+    }
+
+    m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        Close();
+        throw std::runtime_error("Nao foi possivel mapear o arquivo: " + path);
+    }
+}
+
+void MappedFile::Close()
+{
+    if (m_data) UnmapViewOfFile(m_data);
+    if (m_mapping) CloseHandle(m_mapping);
+    if (m_file) CloseHandle(m_file);
+    m_data = nullptr;
+    m_mapping = nullptr;
+    m_file = nullptr;
+    m_size = 0;
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept :
+    m_data(std::exchange(rhs.m_data, nullptr)),
+    m_size(std::exchange(rhs.m_size, 0)),
+    m_file(std::exchange(rhs.m_file, nullptr)),
+    m_mapping(std::exchange(rhs.m_mapping, nullptr))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+    if (this != &rhs) {
+        Close();
+        m_data = std::exchange(rhs.m_data, nullptr);
+        m_size = std::exchange(rhs.m_size, 0);
+        m_file = std::exchange(rhs.m_file, nullptr);
+        m_mapping = std::exchange(rhs.m_mapping, nullptr);
+    }
+    return *this;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+    m_fd = open(path.c_str(), O_RDONLY);
+    if (m_fd < 0) {
+        throw std::runtime_error("Nao foi possivel abrir o arquivo: " + path);
+    }
+
+    struct stat st = {};
+    if (fstat(m_fd, &st) != 0) {
+        Close();
+        throw std::runtime_error("Nao foi possivel obter o tamanho do arquivo: " + path);
+    }
+    m_size = static_cast<size_t>(st.st_size);
+
+    if (m_size == 0) return;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (data == MAP_FAILED) {
+        Close();
+        throw std::runtime_error("Nao foi possivel mapear o arquivo: " + path);
+    }
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(data);
+}
+
+void MappedFile::Close()
+{
+    if (m_data) munmap(const_cast<char*>(m_data), m_size);
+    if (m_fd >= 0) close(m_fd);
+    m_data = nullptr;
+    m_fd = -1;
+    m_size = 0;
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept :
+    m_data(std::exchange(rhs.m_data, nullptr)),
+    m_size(std::exchange(rhs.m_size, 0)),
+    m_fd(std::exchange(rhs.m_fd, -1))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+    if (this != &rhs) {
+        Close();
+        m_data = std::exchange(rhs.m_data, nullptr);
+        m_size = std::exchange(rhs.m_size, 0);
+        m_fd = std::exchange(rhs.m_fd, -1);
+    }
+    return *this;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
@@ -0,0 +1,119 @@
+#include "pch.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <stdexcept>
+
+MeshBounds ComputeMeshBounds(const Vertex* vertices, size_t count)
+{
+    MeshBounds bounds;
+    if (count == 0) return bounds;
+
+    DirectX::XMVECTOR vMin = DirectX::XMLoadFloat3(&vertices[0].Pos);
+    DirectX::XMVECTOR vMax = vMin;
+    for (size_t i = 1; i < count; ++i) {
+        DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&vertices[i].Pos);
+        vMin = DirectX::XMVectorMin(vMin, p);
+        vMax = DirectX::XMVectorMax(vMax, p);
+    }
+    DirectX::XMStoreFloat3(&bounds.Min, vMin);
+    DirectX::XMStoreFloat3(&bounds.Max, vMax);
+    return bounds;
+}
+
+std::vector<Submesh> GetSubmeshes(const Model& model)
+{
+    if (!model.submeshes.empty()) return model.submeshes;
+
+    Submesh whole;
+    whole.IndexCount = static_cast<unsigned int>(model.indices.size());
+    whole.VertexCount = static_cast<unsigned int>(model.vertices.size());
+    whole.Bounds = ComputeMeshBounds(model.vertices.data(), model.vertices.size());
+    return { whole };
+}
+
+std::vector<Material> GetMaterials(const Model& model)
+{
+    if (!model.materials.empty()) return model.materials;
+    return { Material() };
+}
+
+void BuildSubmeshes(Model& model, const std::vector<SubmeshRun>& runs)
+{
+    if (runs.empty()) return;
+
+    const size_t materialCount = std::max(model.materials.size(), size_t(1));
+    const size_t indexCount = model.indices.size() / 3 * 3;
+    auto runBegin = [&](size_t r) { return std::min(runs[r].IndexStart, indexCount); };
+    auto runEnd = [&](size_t r) { return std::max(r + 1 < runs.size() ? runBegin(r + 1) : indexCount, runBegin(r)); };
+
+    // Cada par (parte, material) usado vira um balde; os baldes seguem a ordem do par.
+    std::vector<std::pair<unsigned int, unsigned int>> keys;
+    keys.reserve(runs.size());
+    for (const SubmeshRun& run : runs) {
+        if (run.Material >= materialCount) throw std::runtime_error("Material fora da tabela do modelo");
+        keys.emplace_back(run.Part, run.Material);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::vector<size_t> bucket(runs.size());
+    for (size_t r = 0; r < runs.size(); ++r) {
+        bucket[r] = std::lower_bound(keys.begin(), keys.end(), std::make_pair(runs[r].Part, runs[r].Material)) - keys.begin();
+    }
+
+    // Ordenacao por contagem: offsets[k] e onde comecam os indices do balde k.
+    std::vector<size_t> offsets(keys.size() + 1, 0);
+    for (size_t r = 0; r < runs.size(); ++r) offsets[bucket[r] + 1] += runEnd(r) - runBegin(r);
+    for (size_t k = 0; k < keys.size(); ++k) offsets[k + 1] += offsets[k];
+
+    std::vector<unsigned int> indices(offsets[keys.size()]);
+    std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t r = 0; r < runs.size(); ++r) {
+        const size_t begin = runBegin(r);
+        const size_t count = runEnd(r) - begin;
+        std::copy(model.indices.begin() + begin, model.indices.begin() + begin + count, indices.begin() + cursor[bucket[r]]);
+        cursor[bucket[r]] += count;
+    }
+
+    model.submeshes.clear();
+    for (size_t k = 0; k < keys.size(); ++k) {
+        if (offsets[k + 1] == offsets[k]) continue;
+        Submesh part;
+        part.IndexStart = static_cast<unsigned int>(offsets[k]);
+        part.IndexCount = static_cast<unsigned int>(offsets[k + 1] - offsets[k]);
+        part.VertexCount = static_cast<unsigned int>(model.vertices.size());
+        part.Material = keys[k].second;
+        model.submeshes.push_back(part);
+    }
+    model.indices.swap(indices);
+    ComputeSubmeshBounds(model);
+}
+
+void ComputeSubmeshBounds(Model& model)
+{
+    for (Submesh& part : model.submeshes) {
+        part.Bounds = MeshBounds();
+        if (part.IndexCount == 0) continue;
+
+        const Vertex* base = model.vertices.data() + part.BaseVertex;
+        const unsigned int* indices = model.indices.data() + part.IndexStart;
+        DirectX::XMVECTOR vMin = DirectX::XMLoadFloat3(&base[indices[0]].Pos);
+        DirectX::XMVECTOR vMax = vMin;
+        for (unsigned int i = 1; i < part.IndexCount; ++i) {
+            DirectX::XMVECTOR p = DirectX::XMLoadFloat3(&base[indices[i]].Pos);
+            vMin = DirectX::XMVectorMin(vMin, p);
+            vMax = DirectX::XMVectorMax(vMax, p);
+        }
+        DirectX::XMStoreFloat3(&part.Bounds.Min, vMin);
+        DirectX::XMStoreFloat3(&part.Bounds.Max, vMax);
+    }
+}
+
+bool PackIndices16(const unsigned int* indices, size_t count, std::vector<uint16_t>& out)
+{
+    for (size_t i = 0; i < count; ++i) {
+        if (indices[i] >= MaxIndex16Vertices) return false;
+    }
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) out[i] = static_cast<uint16_t>(indices[i]);
+    return true;
+}
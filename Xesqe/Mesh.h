@@ -0,0 +1,92 @@
+#pragma once
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex
+{
+    DirectX::XMFLOAT3 Pos;
+    DirectX::XMFLOAT3 Normal;
+};
+
+// Material constante de uma faixa de desenho. Mesmo layout do cbuffer
+// cbMaterial do pbr_shaders.hlsl (6 constantes de 32 bits).
+struct Material
+{
+    DirectX::XMFLOAT3 Albedo = { 1.0f, 1.0f, 1.0f };
+    float Metallic = 0.5f;
+    float Roughness = 0.5f;
+    float AO = 0.9f;
+};
+
+struct MeshBounds
+{
+    DirectX::XMFLOAT3 Min = { 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 Max = { 0.0f, 0.0f, 0.0f };
+};
+
+// Faixa desenhavel de um Model. Os indices da faixa sao relativos a BaseVertex,
+// entao uma faixa com ate 65536 vertices cabe em indices de 16 bits.
+struct Submesh
+{
+    unsigned int IndexStart = 0;
+    unsigned int IndexCount = 0;
+    unsigned int BaseVertex = 0;
+    unsigned int VertexCount = 0;
+    unsigned int Material = 0;      // indice em Model::materials
+    MeshBounds Bounds;              // AABB dos vertices usados pela faixa, para o culling por parte
+};
+
+// Nivel de detalhe: RangeCount faixas a partir de Model::lodRanges[FirstRange],
+// sobre os mesmos vertices da malha completa. Error e o desvio geometrico
+// estimado em relacao a malha completa, em unidades do modelo.
+struct MeshLod
+{
+    float Error = 0.0f;
+    unsigned int FirstRange = 0;
+    unsigned int RangeCount = 0;
+    unsigned int TriangleCount = 0;
+};
+
+struct Model {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Submesh> submeshes;   // vazio: uma unica faixa com a mesh inteira
+    std::vector<MeshLod> lods;        // vazio: so a malha completa
+    std::vector<Submesh> lodRanges;
+    std::vector<Material> materials;  // vazio: so o Material padrao
+};
+
+const size_t MaxIndex16Vertices = 65536;
+
+// Faixas de desenho do modelo (a mesh inteira quando submeshes esta vazio).
+std::vector<Submesh> GetSubmeshes(const Model& model);
+
+// Tabela de materiais do modelo (so o Material padrao quando materials esta vazio).
+std::vector<Material> GetMaterials(const Model& model);
+
+// Troca de parte (objeto/grupo do arquivo) ou de material a partir de
+// IndexStart em Model::indices.
+struct SubmeshRun
+{
+    size_t IndexStart = 0;
+    unsigned int Material = 0;
+    unsigned int Part = 0;
+};
+
+// Para os importadores: reordena os triangulos (de forma estavel) para que cada
+// par (parte, material) fique contiguo e cria uma Submesh por par usado, em
+// ordem de parte e depois de material, com o AABB preenchido. Cada trecho vai
+// do IndexStart de um SubmeshRun ate o proximo. Espera um modelo sem submeshes;
+// os indices continuam globais (BaseVertex 0).
+void BuildSubmeshes(Model& model, const std::vector<SubmeshRun>& runs);
+
+// Recalcula Submesh::Bounds de model.submeshes a partir dos vertices indexados.
+void ComputeSubmeshBounds(Model& model);
+
+// Copia os indices para 16 bits. Retorna false (e nao mexe em 'out') se algum
+// indice nao couber; nesse caso o buffer precisa ficar em 32 bits.
+bool PackIndices16(const unsigned int* indices, size_t count, std::vector<uint16_t>& out);
+
+MeshBounds ComputeMeshBounds(const Vertex* vertices, size_t count);
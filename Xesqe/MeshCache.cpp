@@ -0,0 +1,277 @@
+#include "pch.h"
+#include "MeshCache.h"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+    const char XMeshMagic[4] = { 'X', 'M', 'S', 'H' };
+    const uint32_t XMeshVersion = 8;
+    const uint64_t XMeshAlignment = 16;
+
+    uint64_t AlignUp(uint64_t value)
+    {
+        return (value + XMeshAlignment - 1) & ~(XMeshAlignment - 1);
+    }
+
+    bool GetWriteTime(const std::string& path, int64_t& writeTime)
+    {
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(path, ec);
+        if (ec) return false;
+        writeTime = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    // Grava so SourceWriteTime no cabecalho (e com isso a data do cache). Se falhar,
+    // a proxima abertura so volta a calcular o hash.
+    void StoreSourceWriteTime(const std::string& cachePath, int64_t sourceTime)
+    {
+        {
+            std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+            if (!file) return;
+            file.seekp(offsetof(XMeshHeader, SourceWriteTime));
+            file.write(reinterpret_cast<const char*>(&sourceTime), sizeof(sourceTime));
+            if (!file) return;
+        }
+        // A data gravada pelo sistema pode ficar atras da origem (relogio grosso).
+        int64_t cacheTime = 0;
+        if (GetWriteTime(cachePath, cacheTime) && cacheTime < sourceTime) {
+            std::error_code ec;
+            std::filesystem::last_write_time(cachePath,
+                std::filesystem::file_time_type(std::filesystem::file_time_type::duration(sourceTime)), ec);
+        }
+    }
+
+    bool RangesFit(const Submesh* ranges, uint64_t count, const XMeshHeader& header)
+    {
+        for (uint64_t i = 0; i < count; ++i) {
+            const Submesh& range = ranges[i];
+            if (uint64_t(range.IndexStart) + range.IndexCount > header.IndexCount ||
+                uint64_t(range.BaseVertex) + range.VertexCount > header.VertexCount ||
+                range.Material >= header.MaterialCount) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // FNV-1a 64 bits sobre palavras de 8 bytes (e os bytes restantes no final).
+    uint64_t HashBytes(const char* data, size_t size)
+    {
+        const uint64_t prime = 0x100000001B3ull;
+        uint64_t hash = 0xCBF29CE484222325ull;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * prime;
+        }
+        for (; i < size; ++i) {
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * prime;
+        }
+        return hash;
+    }
+}
+
+std::string MeshCachePathFor(const std::string& sourcePath)
+{
+    return std::filesystem::path(sourcePath).replace_extension(".xmesh").string();
+}
+
+bool LoadMeshCache(const std::string& cachePath, const std::string& sourcePath, MeshCacheView& mesh)
+{
+    int64_t cacheTime = 0;
+    if (!GetWriteTime(cachePath, cacheTime)) return false;
+
+    // Sem o arquivo de origem (ex.: build distribuida so com o cache) o cache vale sozinho.
+    int64_t sourceTime = 0;
+    std::error_code ec;
+    const bool hasSource = GetWriteTime(sourcePath, sourceTime);
+    const uint64_t sourceSize = hasSource ? std::filesystem::file_size(sourcePath, ec) : 0;
+    if (hasSource && ec) return false;
+
+    MappedFile file;
+    try {
+        file = MappedFile(cachePath);
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+
+    if (file.Size() < sizeof(XMeshHeader)) return false;
+    XMeshHeader header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    if (std::memcmp(header.Magic, XMeshMagic, sizeof(XMeshMagic)) != 0 ||
+        header.Version != XMeshVersion ||
+        header.VertexStride != sizeof(PackedVertex) ||
+        (header.IndexStride != sizeof(uint16_t) && header.IndexStride != sizeof(unsigned int))) {
+        return false;
+    }
+    if (hasSource && header.SourceSize != sourceSize) return false;
+    // Data diferente com o mesmo tamanho (checkout, copia, touch): so o hash decide
+    // se o conteudo mudou, e ele so e lido nesse caso.
+    if (hasSource && (cacheTime < sourceTime || header.SourceWriteTime != sourceTime)) {
+        try {
+            MappedFile source(sourcePath);
+            if (HashBytes(source.Data(), source.Size()) != header.SourceHash) return false;
+        }
+        catch (const std::runtime_error&) {
+            return false;
+        }
+        // Conteudo igual: a data nova vai para o cabecalho, e as proximas aberturas
+        // voltam a comparar so tamanho e data. O mapeamento nao deixa escrever no
+        // arquivo, entao ele e fechado e refeito.
+        file = MappedFile();
+        StoreSourceWriteTime(cachePath, sourceTime);
+        try {
+            file = MappedFile(cachePath);
+        }
+        catch (const std::runtime_error&) {
+            return false;
+        }
+        if (file.Size() < sizeof(XMeshHeader)) return false;
+        std::memcpy(&header, file.Data(), sizeof(header));
+    }
+
+    const uint64_t vertexBytes = header.VertexCount * sizeof(PackedVertex);
+    const uint64_t indexBytes = header.IndexCount * header.IndexStride;
+    const uint64_t submeshBytes = header.SubmeshCount * sizeof(Submesh);
+    const uint64_t meshletBytes = header.MeshletCount * sizeof(Meshlet);
+    const uint64_t lodBytes = header.LodCount * sizeof(MeshLod);
+    const uint64_t lodRangeBytes = header.LodRangeCount * sizeof(Submesh);
+    const uint64_t materialBytes = header.MaterialCount * sizeof(Material);
+    if (header.VertexOffset % XMeshAlignment != 0 || header.IndexOffset % XMeshAlignment != 0 ||
+        header.SubmeshOffset % XMeshAlignment != 0 || header.MeshletOffset % XMeshAlignment != 0 ||
+        header.LodOffset % XMeshAlignment != 0 || header.LodRangeOffset % XMeshAlignment != 0 ||
+        header.MaterialOffset % XMeshAlignment != 0 ||
+        header.VertexOffset > file.Size() || vertexBytes > file.Size() - header.VertexOffset ||
+        header.IndexOffset > file.Size() || indexBytes > file.Size() - header.IndexOffset ||
+        header.SubmeshOffset > file.Size() || submeshBytes > file.Size() - header.SubmeshOffset ||
+        header.MeshletOffset > file.Size() || meshletBytes > file.Size() - header.MeshletOffset ||
+        header.LodOffset > file.Size() || lodBytes > file.Size() - header.LodOffset ||
+        header.LodRangeOffset > file.Size() || lodRangeBytes > file.Size() - header.LodRangeOffset ||
+        header.MaterialOffset > file.Size() || materialBytes > file.Size() - header.MaterialOffset) {
+        return false;
+    }
+
+    // Cada faixa precisa caber nos arrays, senao o draw leria fora do buffer.
+    const Submesh* submeshes = reinterpret_cast<const Submesh*>(file.Data() + header.SubmeshOffset);
+    const Submesh* lodRanges = reinterpret_cast<const Submesh*>(file.Data() + header.LodRangeOffset);
+    if (!RangesFit(submeshes, header.SubmeshCount, header) || !RangesFit(lodRanges, header.LodRangeCount, header)) {
+        return false;
+    }
+    const MeshLod* lods = reinterpret_cast<const MeshLod*>(file.Data() + header.LodOffset);
+    for (uint64_t i = 0; i < header.LodCount; ++i) {
+        if (uint64_t(lods[i].FirstRange) + lods[i].RangeCount > header.LodRangeCount) return false;
+    }
+    const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(file.Data() + header.MeshletOffset);
+    for (uint64_t i = 0; i < header.MeshletCount; ++i) {
+        const Meshlet& meshlet = meshlets[i];
+        if (uint64_t(meshlet.IndexStart) + meshlet.TriangleCount * 3ull > header.IndexCount ||
+            meshlet.BaseVertex > header.VertexCount || meshlet.Material >= header.MaterialCount) {
+            return false;
+        }
+    }
+
+    mesh.Vertices = reinterpret_cast<const PackedVertex*>(file.Data() + header.VertexOffset);
+    mesh.VertexCount = static_cast<size_t>(header.VertexCount);
+    mesh.Quantization = MakeVertexQuantization(header.Bounds);
+    mesh.Indices = file.Data() + header.IndexOffset;
+    mesh.IndexCount = static_cast<size_t>(header.IndexCount);
+    mesh.IndexStride = header.IndexStride;
+    mesh.Submeshes = submeshes;
+    mesh.SubmeshCount = static_cast<size_t>(header.SubmeshCount);
+    mesh.Meshlets = meshlets;
+    mesh.MeshletCount = static_cast<size_t>(header.MeshletCount);
+    mesh.Lods = lods;
+    mesh.LodCount = static_cast<size_t>(header.LodCount);
+    mesh.LodRanges = lodRanges;
+    mesh.LodRangeCount = static_cast<size_t>(header.LodRangeCount);
+    mesh.Materials = reinterpret_cast<const Material*>(file.Data() + header.MaterialOffset);
+    mesh.MaterialCount = static_cast<size_t>(header.MaterialCount);
+    mesh.Bounds = header.Bounds;
+    mesh.File = std::move(file);
+    return true;
+}
+
+bool WriteMeshCache(const std::string& cachePath, const std::string& sourcePath, const Model& model,
+    const std::vector<Meshlet>& meshlets)
+{
+    std::vector<uint16_t> indices16;
+    const bool use16 = PackIndices16(model.indices.data(), model.indices.size(), indices16);
+    const char* indexData = use16 ? reinterpret_cast<const char*>(indices16.data())
+                                  : reinterpret_cast<const char*>(model.indices.data());
+    const std::vector<Submesh> submeshes = GetSubmeshes(model);
+    const std::vector<Material> materials = GetMaterials(model);
+    const MeshBounds bounds = ComputeMeshBounds(model.vertices.data(), model.vertices.size());
+    std::vector<PackedVertex> packed;
+    PackVertices(model.vertices.data(), model.vertices.size(), MakeVertexQuantization(bounds), packed);
+
+    XMeshHeader header = {};
+    std::memcpy(header.Magic, XMeshMagic, sizeof(XMeshMagic));
+    header.Version = XMeshVersion;
+    header.VertexStride = sizeof(PackedVertex);
+    header.IndexStride = use16 ? sizeof(uint16_t) : sizeof(unsigned int);
+    header.VertexCount = model.vertices.size();
+    header.IndexCount = model.indices.size();
+    header.SubmeshCount = submeshes.size();
+    header.MeshletCount = meshlets.size();
+    header.LodCount = model.lods.size();
+    header.LodRangeCount = model.lodRanges.size();
+    header.MaterialCount = materials.size();
+    header.VertexOffset = AlignUp(sizeof(XMeshHeader));
+    header.IndexOffset = AlignUp(header.VertexOffset + header.VertexCount * sizeof(PackedVertex));
+    header.SubmeshOffset = AlignUp(header.IndexOffset + header.IndexCount * header.IndexStride);
+    header.MeshletOffset = AlignUp(header.SubmeshOffset + header.SubmeshCount * sizeof(Submesh));
+    header.LodOffset = AlignUp(header.MeshletOffset + header.MeshletCount * sizeof(Meshlet));
+    header.LodRangeOffset = AlignUp(header.LodOffset + header.LodCount * sizeof(MeshLod));
+    header.MaterialOffset = AlignUp(header.LodRangeOffset + header.LodRangeCount * sizeof(Submesh));
+    header.Bounds = bounds;
+
+    try {
+        MappedFile source(sourcePath);
+        header.SourceSize = source.Size();
+        header.SourceHash = HashBytes(source.Data(), source.Size());
+    }
+    catch (const std::runtime_error&) {
+        return false;
+    }
+    if (!GetWriteTime(sourcePath, header.SourceWriteTime)) return false;
+
+    // Grava num temporario e renomeia, para nunca deixar um cache pela metade.
+    const std::string tempPath = cachePath + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+
+        const char padding[XMeshAlignment] = {};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(padding, header.VertexOffset - sizeof(header));
+        out.write(reinterpret_cast<const char*>(packed.data()), packed.size() * sizeof(PackedVertex));
+        out.write(padding, header.IndexOffset - (header.VertexOffset + packed.size() * sizeof(PackedVertex)));
+        out.write(indexData, header.IndexCount * header.IndexStride);
+        out.write(padding, header.SubmeshOffset - (header.IndexOffset + header.IndexCount * header.IndexStride));
+        out.write(reinterpret_cast<const char*>(submeshes.data()), submeshes.size() * sizeof(Submesh));
+        out.write(padding, header.MeshletOffset - (header.SubmeshOffset + submeshes.size() * sizeof(Submesh)));
+        out.write(reinterpret_cast<const char*>(meshlets.data()), meshlets.size() * sizeof(Meshlet));
+        out.write(padding, header.LodOffset - (header.MeshletOffset + meshlets.size() * sizeof(Meshlet)));
+        out.write(reinterpret_cast<const char*>(model.lods.data()), model.lods.size() * sizeof(MeshLod));
+        out.write(padding, header.LodRangeOffset - (header.LodOffset + model.lods.size() * sizeof(MeshLod)));
+        out.write(reinterpret_cast<const char*>(model.lodRanges.data()), model.lodRanges.size() * sizeof(Submesh));
+        out.write(padding, header.MaterialOffset - (header.LodRangeOffset + model.lodRanges.size() * sizeof(Submesh)));
+        out.write(reinterpret_cast<const char*>(materials.data()), materials.size() * sizeof(Material));
+        if (!out) return false;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec) {
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "Meshlet.h"
+#include "VertexPacking.h"
+#include <cstdint>
+#include <string>
+
+// Cache binario (.xmesh) com os arrays finais de PackedVertex, indices e as tabelas
+// de Submesh, Meshlet, MeshLod, faixas dos LODs e Material. A quantizacao das
+// posicoes vem de Bounds (MakeVertexQuantization).
+// Layout: XMeshHeader seguido das secoes de vertices, indices, submeshes, meshlets,
+// LODs, faixas dos LODs e materiais, alinhadas em 16 bytes. IndexStride e 2 quando todos os indices cabem em 16 bits, senao 4.
+struct XMeshHeader
+{
+    char Magic[4];
+    uint32_t Version;
+    uint32_t VertexStride;
+    uint32_t IndexStride;
+    uint64_t VertexCount;
+    uint64_t IndexCount;
+    uint64_t VertexOffset;
+    uint64_t IndexOffset;
+    uint64_t SubmeshCount;
+    uint64_t SubmeshOffset;
+    uint64_t MeshletCount;
+    uint64_t MeshletOffset;
+    uint64_t LodCount;
+    uint64_t LodOffset;
+    uint64_t LodRangeCount;
+    uint64_t LodRangeOffset;
+    uint64_t MaterialCount;
+    uint64_t MaterialOffset;
+    MeshBounds Bounds;
+    uint64_t SourceSize;
+    int64_t SourceWriteTime;
+    uint64_t SourceHash;
+};
+
+// Mesh lida de um .xmesh. Os ponteiros apontam direto para o arquivo mapeado
+// e so sao validos enquanto File estiver aberto.
+struct MeshCacheView
+{
+    MappedFile File;
+    const PackedVertex* Vertices = nullptr;
+    size_t VertexCount = 0;
+    VertexQuantization Quantization;
+    const void* Indices = nullptr;
+    size_t IndexCount = 0;
+    size_t IndexStride = 0;
+    const Submesh* Submeshes = nullptr;
+    size_t SubmeshCount = 0;
+    const Meshlet* Meshlets = nullptr;
+    size_t MeshletCount = 0;
+    const MeshLod* Lods = nullptr;
+    size_t LodCount = 0;
+    const Submesh* LodRanges = nullptr;
+    size_t LodRangeCount = 0;
+    const Material* Materials = nullptr;
+    size_t MaterialCount = 0;
+    MeshBounds Bounds;
+};
+
+// "Models/mustang.obj" -> "Models/mustang.xmesh"
+std::string MeshCachePathFor(const std::string& sourcePath);
+
+// Mapeia o cache se ele existir, for valido e estiver em dia com o arquivo de origem:
+// mesmo tamanho e mesma data, ou, se so a data mudou, mesmo SourceHash (a origem e
+// lida inteira so nesse caso, e a data nova e gravada no cache para a proxima vez).
+// Retorna false quando for preciso importar a origem de novo.
+bool LoadMeshCache(const std::string& cachePath, const std::string& sourcePath, MeshCacheView& mesh);
+
+// Grava o cache para 'model' (com LODs e meshlets) importado de sourcePath.
+// Retorna false se nao conseguir escrever.
+bool WriteMeshCache(const std::string& cachePath, const std::string& sourcePath, const Model& model,
+    const std::vector<Meshlet>& meshlets);
@@ -0,0 +1,392 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include "VertexIndexMap.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize)
+{
+    VertexCacheStats stats;
+    stats.Triangles = indexCount / 3;
+
+    // Um vertice esta no cache FIFO se entrou ha menos de cacheSize misses.
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<char> referenced(vertexCount, 0);
+    unsigned int timestamp = cacheSize + 1;
+    for (size_t i = 0; i < indexCount; ++i) {
+        const unsigned int v = indices[i];
+        if (!referenced[v]) {
+            referenced[v] = 1;
+            stats.Vertices++;
+        }
+        if (timestamp - cacheTime[v] > cacheSize) {
+            cacheTime[v] = timestamp++;
+            stats.Misses++;
+        }
+    }
+
+    stats.ACMR = stats.Triangles ? static_cast<float>(stats.Misses) / stats.Triangles : 0.0f;
+    stats.ATVR = stats.Vertices ? static_cast<float>(stats.Misses) / stats.Vertices : 0.0f;
+    return stats;
+}
+
+void RemoveDegenerateTriangles(std::vector<unsigned int>& indices, size_t& degenerateCount, size_t& duplicateCount)
+{
+    degenerateCount = 0;
+    duplicateCount = 0;
+
+    // A tabela de deduplicacao de vertices serve como conjunto de trios.
+    VertexIndexMap seen(indices.size() / 3);
+    size_t write = 0;
+    for (size_t read = 0; read + 2 < indices.size(); read += 3) {
+        unsigned int a = indices[read], b = indices[read + 1], c = indices[read + 2];
+        if (a == b || b == c || a == c) {
+            degenerateCount++;
+            continue;
+        }
+
+        // Rotaciona para o menor indice vir primeiro, preservando o sentido.
+        VertexIndexMap::Key key;
+        if (a < b && a < c) key = { (int)a, (int)b, (int)c };
+        else if (b < c) key = { (int)b, (int)c, (int)a };
+        else key = { (int)c, (int)a, (int)b };
+
+        bool inserted = false;
+        seen.FindOrInsert(key, 0, inserted);
+        if (!inserted) {
+            duplicateCount++;
+            continue;
+        }
+
+        indices[write++] = a;
+        indices[write++] = b;
+        indices[write++] = c;
+    }
+    indices.resize(write);
+}
+
+void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, unsigned cacheSize, std::vector<size_t>* clusterStarts)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (clusterStarts) clusterStarts->clear();
+    if (triangleCount == 0) return;
+
+    // Adjacencia vertice -> triangulos em formato compacto (offsets + lista).
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) liveTriangles[indices[i]]++;
+
+    std::vector<size_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] = offsets[v] + liveTriangles[v];
+
+    std::vector<unsigned int> adjacency(triangleCount * 3);
+    {
+        std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (size_t k = 0; k < 3; ++k) {
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+            }
+        }
+    }
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<unsigned int> deadEnd;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    deadEnd.reserve(triangleCount * 3);
+    output.reserve(triangleCount * 3);
+
+    unsigned int timestamp = cacheSize + 1;
+    size_t scanCursor = 0;
+    bool newCluster = true;
+    long long fanning = indices[0];
+
+    while (fanning >= 0)
+    {
+        // Emite todos os triangulos ainda vivos em volta do vertice atual.
+        candidates.clear();
+        for (size_t a = offsets[fanning]; a < offsets[fanning + 1]; ++a) {
+            const unsigned int t = adjacency[a];
+            if (emitted[t]) continue;
+            emitted[t] = 1;
+
+            if (newCluster && clusterStarts) clusterStarts->push_back(output.size() / 3);
+            newCluster = false;
+
+            for (size_t k = 0; k < 3; ++k) {
+                const unsigned int v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (timestamp - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = timestamp++;
+                }
+            }
+        }
+
+        // Proximo leque: o candidato que continua no cache depois de emitir
+        // seus triangulos restantes e que entrou no cache ha mais tempo.
+        long long next = -1;
+        long long bestPriority = -1;
+        for (unsigned int v : candidates) {
+            if (liveTriangles[v] == 0) continue;
+            long long priority = 0;
+            const long long age = timestamp - cacheTime[v];
+            if (age + 2LL * liveTriangles[v] <= cacheSize) priority = age;
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next < 0) {
+            // Beco sem saida: volta a um vertice recente com triangulos
+            // pendentes ou, em ultimo caso, ao proximo na ordem dos indices.
+            newCluster = true;
+            while (!deadEnd.empty()) {
+                const unsigned int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0) {
+                    next = v;
+                    break;
+                }
+            }
+            while (next < 0 && scanCursor < vertexCount) {
+                if (liveTriangles[scanCursor] > 0) next = static_cast<long long>(scanCursor);
+                else ++scanCursor;
+            }
+        }
+        fanning = next;
+    }
+
+    indices.swap(output);
+}
+
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, const std::vector<size_t>& clusterStarts)
+{
+    using namespace DirectX;
+
+    const size_t triangleCount = indices.size() / 3;
+    if (clusterStarts.size() <= 1) return;
+
+    struct Cluster
+    {
+        size_t first, last;
+        XMFLOAT3 centroid;
+        XMFLOAT3 normal;
+        float sortKey;
+    };
+
+    std::vector<Cluster> clusters(clusterStarts.size());
+    XMVECTOR meshCentroid = XMVectorZero();
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusters.size(); ++c) {
+        Cluster& cluster = clusters[c];
+        cluster.first = clusterStarts[c];
+        cluster.last = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+
+        // Centroide ponderado pela area e normal media (soma das normais de face).
+        XMVECTOR centroid = XMVectorZero();
+        XMVECTOR normal = XMVectorZero();
+        float area = 0.0f;
+        for (size_t t = cluster.first; t < cluster.last; ++t) {
+            XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Pos);
+            XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Pos);
+            XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Pos);
+            XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+            float a = XMVectorGetX(XMVector3Length(n)) * 0.5f;
+            XMVECTOR center = XMVectorScale(XMVectorAdd(XMVectorAdd(p0, p1), p2), 1.0f / 3.0f);
+            centroid = XMVectorAdd(centroid, XMVectorScale(center, a));
+            normal = XMVectorAdd(normal, n);
+            area += a;
+        }
+
+        meshCentroid = XMVectorAdd(meshCentroid, centroid);
+        meshArea += area;
+        XMStoreFloat3(&cluster.centroid, area > 0.0f ? XMVectorScale(centroid, 1.0f / area) : centroid);
+        XMStoreFloat3(&cluster.normal, normal);
+    }
+    if (meshArea > 0.0f) meshCentroid = XMVectorScale(meshCentroid, 1.0f / meshArea);
+
+    for (Cluster& cluster : clusters) {
+        XMVECTOR normal = XMLoadFloat3(&cluster.normal);
+        float length = XMVectorGetX(XMVector3Length(normal));
+        XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&cluster.centroid), meshCentroid);
+        cluster.sortKey = length > 0.0f ? XMVectorGetX(XMVector3Dot(offset, normal)) / length : 0.0f;
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(),
+        [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    for (const Cluster& cluster : clusters) {
+        output.insert(output.end(), indices.begin() + cluster.first * 3, indices.begin() + cluster.last * 3);
+    }
+    indices.swap(output);
+}
+
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unused);
+    std::vector<Vertex> output;
+    output.reserve(vertices.size());
+
+    for (unsigned int& index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<unsigned int>(output.size());
+            output.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(output);
+}
+
+void SplitMeshForIndex16(Model& model)
+{
+    const std::vector<Submesh> parts = GetSubmeshes(model);
+
+    bool fits = true;
+    for (const Submesh& part : parts) {
+        for (unsigned int i = 0; i < part.IndexCount && fits; ++i) {
+            fits = model.indices[part.IndexStart + i] < MaxIndex16Vertices;
+        }
+    }
+    if (fits) return;
+
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> localIndex(model.vertices.size(), unused);
+    std::vector<unsigned int> touched;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Submesh> submeshes;
+    vertices.reserve(model.vertices.size());
+    indices.reserve(model.indices.size());
+
+    for (const Submesh& part : parts) {
+        Submesh piece = part;
+        auto beginPiece = [&]() {
+            for (unsigned int v : touched) localIndex[v] = unused;
+            touched.clear();
+            piece.IndexStart = static_cast<unsigned int>(indices.size());
+            piece.IndexCount = 0;
+            piece.BaseVertex = static_cast<unsigned int>(vertices.size());
+            piece.VertexCount = 0;
+        };
+        beginPiece();
+
+        for (unsigned int t = 0; t + 2 < part.IndexCount; t += 3) {
+            unsigned int corners[3];
+            size_t newVertices = 0;
+            for (size_t k = 0; k < 3; ++k) {
+                corners[k] = part.BaseVertex + model.indices[part.IndexStart + t + k];
+                if (localIndex[corners[k]] == unused &&
+                    (k == 0 || corners[k] != corners[0]) && (k < 2 || corners[k] != corners[1])) {
+                    newVertices++;
+                }
+            }
+
+            if (piece.VertexCount + newVertices > MaxIndex16Vertices) {
+                piece.Bounds = ComputeMeshBounds(vertices.data() + piece.BaseVertex, piece.VertexCount);
+                submeshes.push_back(piece);
+                beginPiece();
+            }
+
+            for (unsigned int v : corners) {
+                if (localIndex[v] == unused) {
+                    localIndex[v] = piece.VertexCount++;
+                    vertices.push_back(model.vertices[v]);
+                    touched.push_back(v);
+                }
+                indices.push_back(localIndex[v]);
+            }
+            piece.IndexCount += 3;
+        }
+        if (piece.IndexCount > 0) {
+            piece.Bounds = ComputeMeshBounds(vertices.data() + piece.BaseVertex, piece.VertexCount);
+            submeshes.push_back(piece);
+        }
+        for (unsigned int v : touched) localIndex[v] = unused;
+        touched.clear();
+    }
+
+    model.vertices.swap(vertices);
+    model.indices.swap(indices);
+    model.submeshes.swap(submeshes);
+}
+
+std::string MeshOptimizeReport::ToString() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "ACMR " << Before.ACMR << " -> " << After.ACMR
+        << ", ATVR " << Before.ATVR << " -> " << After.ATVR
+        << ", " << Before.Triangles << " -> " << After.Triangles << " triangulos"
+        << " (" << DegenerateTriangles << " degenerados, " << DuplicateTriangles << " duplicados)";
+    return ss.str();
+}
+
+MeshOptimizeReport OptimizeMesh(Model& model, const MeshOptimizeOptions& options)
+{
+    MeshOptimizeReport report;
+    report.Before = AnalyzeVertexCache(model.indices.data(), model.indices.size(), model.vertices.size(), options.CacheSize);
+
+    // Cada faixa e otimizada sozinha, para que triangulos nao troquem de faixa
+    // (e de material). Os vertices da faixa sao renumerados de 0 a n antes,
+    // assim o custo depende so do tamanho da faixa.
+    std::vector<Submesh> parts = GetSubmeshes(model);
+    const unsigned int unused = ~0u;
+    std::vector<unsigned int> localIndex(model.vertices.size(), unused);
+    std::vector<unsigned int> globalIndex;
+    std::vector<Vertex> localVertices;
+    std::vector<unsigned int> local;
+    std::vector<unsigned int> indices;
+    indices.reserve(model.indices.size());
+
+    for (Submesh& part : parts) {
+        globalIndex.clear();
+        local.assign(model.indices.begin() + part.IndexStart, model.indices.begin() + part.IndexStart + part.IndexCount);
+        for (unsigned int& index : local) {
+            const unsigned int v = part.BaseVertex + index;
+            if (localIndex[v] == unused) {
+                localIndex[v] = static_cast<unsigned int>(globalIndex.size());
+                globalIndex.push_back(v);
+            }
+            index = localIndex[v];
+        }
+
+        size_t degenerate = 0, duplicate = 0;
+        RemoveDegenerateTriangles(local, degenerate, duplicate);
+        report.DegenerateTriangles += degenerate;
+        report.DuplicateTriangles += duplicate;
+
+        std::vector<size_t> clusterStarts;
+        OptimizeVertexCache(local, globalIndex.size(), options.CacheSize, options.OptimizeOverdraw ? &clusterStarts : nullptr);
+        if (options.OptimizeOverdraw) {
+            localVertices.resize(globalIndex.size());
+            for (size_t v = 0; v < globalIndex.size(); ++v) localVertices[v] = model.vertices[globalIndex[v]];
+            OptimizeOverdraw(local, localVertices, clusterStarts);
+        }
+
+        part.IndexStart = static_cast<unsigned int>(indices.size());
+        part.IndexCount = static_cast<unsigned int>(local.size());
+        part.BaseVertex = 0;
+        for (unsigned int index : local) indices.push_back(globalIndex[index]);
+        for (unsigned int v : globalIndex) localIndex[v] = unused;
+    }
+    model.indices.swap(indices);
+
+    OptimizeVertexFetch(model.vertices, model.indices);
+    for (Submesh& part : parts) part.VertexCount = static_cast<unsigned int>(model.vertices.size());
+    if (!model.submeshes.empty()) {
+        model.submeshes.swap(parts);
+        ComputeSubmeshBounds(model);
+    }
+
+    report.After = AnalyzeVertexCache(model.indices.data(), model.indices.size(), model.vertices.size(), options.CacheSize);
+    return report;
+}
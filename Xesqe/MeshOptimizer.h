@@ -0,0 +1,66 @@
+#pragma once
+#include "Mesh.h"
+#include <string>
+
+// Estagio de otimizacao que roda depois da importacao. So depende de Mesh.h
+// (nada de D3D), entao pode ser usado e medido sem janela nem GPU.
+
+struct VertexCacheStats
+{
+    size_t Triangles = 0;
+    size_t Vertices = 0;   // vertices referenciados pelos indices
+    size_t Misses = 0;
+    float ACMR = 0.0f;     // misses por triangulo
+    float ATVR = 0.0f;     // misses por vertice (1.0 e o ideal)
+};
+
+// Simula um cache FIFO pos-transformacao de cacheSize entradas.
+VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, size_t indexCount, size_t vertexCount, unsigned cacheSize = 16);
+
+// Remove triangulos com vertices repetidos e triangulos iguais (mesma
+// sequencia a menos de rotacao; a ordem dos vertices importa). Retorna quantos
+// de cada foram removidos.
+void RemoveDegenerateTriangles(std::vector<unsigned int>& indices, size_t& degenerateCount, size_t& duplicateCount);
+
+// Reordena triangulos para localidade no cache de vertices (Tipsify, Sander et al. 2007).
+// Se clusterStarts nao for nulo, recebe o primeiro triangulo de cada cluster,
+// ou seja, os pontos onde o algoritmo precisou recomecar de um beco sem saida.
+void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount, unsigned cacheSize = 16,
+    std::vector<size_t>* clusterStarts = nullptr);
+
+// Reordena os clusters de OptimizeVertexCache para reduzir overdraw: clusters
+// com mais potencial de ocultar o resto da malha (mais para fora, virados para fora)
+// vem primeiro. A ordem dentro de cada cluster nao muda.
+void OptimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices,
+    const std::vector<size_t>& clusterStarts);
+
+// Renumera os vertices na ordem do primeiro uso no indice e descarta os nao referenciados.
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+// Divide as faixas que enderecam mais de 65536 vertices em faixas menores, cada
+// uma com seus proprios vertices e indices relativos a BaseVertex, para que o
+// modelo inteiro possa usar indices de 16 bits. Triangulos mantem a ordem.
+// Vertices compartilhados na fronteira entre faixas sao duplicados.
+// Nao altera o modelo se todas as faixas ja couberem.
+void SplitMeshForIndex16(Model& model);
+
+struct MeshOptimizeOptions
+{
+    unsigned CacheSize = 16;
+    bool OptimizeOverdraw = false;
+};
+
+struct MeshOptimizeReport
+{
+    VertexCacheStats Before;
+    VertexCacheStats After;
+    size_t DegenerateTriangles = 0;
+    size_t DuplicateTriangles = 0;
+
+    std::string ToString() const;
+};
+
+// Pipeline completo: limpeza, cache de vertices, overdraw (opcional) e ordem de fetch.
+// Cada Submesh e otimizada separadamente e sai com indices globais (BaseVertex 0),
+// entao deve rodar antes de SplitMeshForIndex16.
+MeshOptimizeReport OptimizeMesh(Model& model, const MeshOptimizeOptions& options = MeshOptimizeOptions());
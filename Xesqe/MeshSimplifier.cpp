@@ -0,0 +1,362 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include "VertexIndexMap.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace DirectX;
+
+namespace
+{
+    struct Vec3d
+    {
+        double x, y, z;
+    };
+
+    Vec3d ToVec3d(const XMFLOAT3& p) { return { p.x, p.y, p.z }; }
+    Vec3d Sub(const Vec3d& a, const Vec3d& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+    double Dot(const Vec3d& a, const Vec3d& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    Vec3d Cross(const Vec3d& a, const Vec3d& b)
+    {
+        return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    }
+
+    // Matriz 4x4 simetrica: soma das distancias ao quadrado a um conjunto de planos.
+    struct Quadric
+    {
+        double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+        void AddPlane(const Vec3d& n, double d)
+        {
+            a2 += n.x * n.x; ab += n.x * n.y; ac += n.x * n.z; ad += n.x * d;
+            b2 += n.y * n.y; bc += n.y * n.z; bd += n.y * d;
+            c2 += n.z * n.z; cd += n.z * d;
+            d2 += d * d;
+        }
+
+        void Add(const Quadric& q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+            b2 += q.b2; bc += q.bc; bd += q.bd;
+            c2 += q.c2; cd += q.cd;
+            d2 += q.d2;
+        }
+
+        double Evaluate(const Vec3d& p) const
+        {
+            const double e = a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x +
+                b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y +
+                c2 * p.z * p.z + 2 * cd * p.z + d2;
+            return e > 0.0 ? e : 0.0;
+        }
+    };
+
+    struct Collapse
+    {
+        double Cost;
+        unsigned int From, To;
+        unsigned int FromVersion, ToVersion;
+
+        bool operator>(const Collapse& other) const { return Cost > other.Cost; }
+    };
+
+    // Bits da coordenada como chave de hash; -0 e +0 viram a mesma posicao.
+    int PositionKey(float f)
+    {
+        if (f == 0.0f) f = 0.0f;
+        int bits;
+        std::memcpy(&bits, &f, sizeof(bits));
+        return bits;
+    }
+}
+
+std::vector<unsigned int> SimplifyIndices(const Vertex* vertices, size_t vertexCount,
+    const unsigned int* indices, size_t indexCount, size_t targetIndexCount, float maxError, float* resultError)
+{
+    const unsigned int unused = ~0u;
+    if (resultError) *resultError = 0.0f;
+
+    // Solda vertices de mesma posicao: a topologia e a metrica usam so a posicao.
+    std::vector<unsigned int> weld(vertexCount);
+    std::vector<unsigned int> firstVertex;
+    std::vector<unsigned int> nextSamePosition(vertexCount, unused);
+    {
+        VertexIndexMap positions(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            const XMFLOAT3& p = vertices[v].Pos;
+            bool inserted = false;
+            const unsigned int id = positions.FindOrInsert({ PositionKey(p.x), PositionKey(p.y), PositionKey(p.z) },
+                static_cast<unsigned int>(firstVertex.size()), inserted);
+            if (inserted) {
+                firstVertex.push_back(static_cast<unsigned int>(v));
+            }
+            else {
+                nextSamePosition[v] = nextSamePosition[firstVertex[id]];
+                nextSamePosition[firstVertex[id]] = static_cast<unsigned int>(v);
+            }
+            weld[v] = id;
+        }
+    }
+    const size_t pointCount = firstVertex.size();
+    std::vector<Vec3d> points(pointCount);
+    for (size_t i = 0; i < pointCount; ++i) points[i] = ToVec3d(vertices[firstVertex[i]].Pos);
+
+    const size_t triangleCount = indexCount / 3;
+    std::vector<unsigned int> triangles(triangleCount * 3);
+    std::vector<char> live(triangleCount, 0);
+    size_t liveCount = 0;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        unsigned int* tri = &triangles[t * 3];
+        for (size_t k = 0; k < 3; ++k) tri[k] = weld[indices[t * 3 + k]];
+        if (tri[0] != tri[1] && tri[1] != tri[2] && tri[0] != tri[2]) {
+            live[t] = 1;
+            liveCount++;
+        }
+    }
+
+    std::vector<std::vector<unsigned int>> adjacency(pointCount);
+    std::vector<Quadric> quadrics(pointCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (!live[t]) continue;
+        const unsigned int* tri = &triangles[t * 3];
+        for (size_t k = 0; k < 3; ++k) adjacency[tri[k]].push_back(static_cast<unsigned int>(t));
+
+        Vec3d n = Cross(Sub(points[tri[1]], points[tri[0]]), Sub(points[tri[2]], points[tri[0]]));
+        const double length = std::sqrt(Dot(n, n));
+        if (length == 0.0) continue;
+        n = { n.x / length, n.y / length, n.z / length };
+        const double d = -Dot(n, points[tri[0]]);
+        for (size_t k = 0; k < 3; ++k) quadrics[tri[k]].AddPlane(n, d);
+    }
+
+    // Arestas usadas por um so triangulo (borda) ou por mais de dois travam os extremos.
+    std::vector<char> locked(pointCount, 0);
+    std::vector<unsigned int> edgeEnds;
+    {
+        VertexIndexMap edges(liveCount * 3 / 2 + 1);
+        std::vector<unsigned int> edgeUses;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (!live[t]) continue;
+            for (size_t k = 0; k < 3; ++k) {
+                const unsigned int a = triangles[t * 3 + k];
+                const unsigned int b = triangles[t * 3 + (k + 1) % 3];
+                const unsigned int lo = std::min(a, b), hi = std::max(a, b);
+                bool inserted = false;
+                const unsigned int id = edges.FindOrInsert({ (int)lo, (int)hi, 0 }, static_cast<unsigned int>(edgeUses.size()), inserted);
+                if (inserted) {
+                    edgeUses.push_back(0);
+                    edgeEnds.push_back(lo);
+                    edgeEnds.push_back(hi);
+                }
+                edgeUses[id]++;
+            }
+        }
+        for (size_t e = 0; e < edgeUses.size(); ++e) {
+            if (edgeUses[e] != 2) {
+                locked[edgeEnds[e * 2]] = 1;
+                locked[edgeEnds[e * 2 + 1]] = 1;
+            }
+        }
+    }
+
+    std::vector<unsigned int> version(pointCount, 0);
+    std::vector<char> alive(pointCount, 1);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+    // Cada aresta entra com o sentido mais barato entre a -> b e b -> a.
+    const double infinite = std::numeric_limits<double>::infinity();
+    auto pushEdge = [&](unsigned int a, unsigned int b) {
+        Quadric q = quadrics[a];
+        q.Add(quadrics[b]);
+        const double costAB = locked[a] ? infinite : q.Evaluate(points[b]);
+        const double costBA = locked[b] ? infinite : q.Evaluate(points[a]);
+        if (costAB == infinite && costBA == infinite) return;
+        if (costAB <= costBA) heap.push({ costAB, a, b, version[a], version[b] });
+        else heap.push({ costBA, b, a, version[b], version[a] });
+    };
+    for (size_t e = 0; e * 2 < edgeEnds.size(); ++e) pushEdge(edgeEnds[e * 2], edgeEnds[e * 2 + 1]);
+
+    // Rejeita colapsos que invertem ou degeneram algum triangulo em volta de 'from'.
+    auto flips = [&](unsigned int from, unsigned int to) {
+        for (unsigned int t : adjacency[from]) {
+            if (!live[t]) continue;
+            const unsigned int* tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+            Vec3d before[3], after[3];
+            for (size_t k = 0; k < 3; ++k) {
+                before[k] = points[tri[k]];
+                after[k] = points[tri[k] == from ? to : tri[k]];
+            }
+            const Vec3d n0 = Cross(Sub(before[1], before[0]), Sub(before[2], before[0]));
+            const Vec3d n1 = Cross(Sub(after[1], after[0]), Sub(after[2], after[0]));
+            if (Dot(n0, n1) <= 0.0 || Dot(n1, n1) == 0.0) return true;
+        }
+        return false;
+    };
+
+    const double maxCost = static_cast<double>(maxError) * maxError;
+    const size_t targetTriangles = targetIndexCount / 3;
+    double worstCost = 0.0;
+    std::vector<unsigned int> neighborStamp(pointCount, 0);
+    unsigned int stamp = 0;
+
+    while (liveCount > targetTriangles && !heap.empty()) {
+        const Collapse collapse = heap.top();
+        heap.pop();
+        const unsigned int from = collapse.From, to = collapse.To;
+        if (!alive[from] || !alive[to] || version[from] != collapse.FromVersion || version[to] != collapse.ToVersion) continue;
+        if (collapse.Cost > maxCost) break;
+        if (flips(from, to)) continue;
+
+        alive[from] = 0;
+        quadrics[to].Add(quadrics[from]);
+        for (unsigned int t : adjacency[from]) {
+            if (!live[t]) continue;
+            unsigned int* tri = &triangles[t * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to) {
+                live[t] = 0;
+                liveCount--;
+                continue;
+            }
+            for (size_t k = 0; k < 3; ++k) if (tri[k] == from) tri[k] = to;
+            adjacency[to].push_back(t);
+        }
+        std::vector<unsigned int>().swap(adjacency[from]);
+
+        std::vector<unsigned int>& around = adjacency[to];
+        around.erase(std::remove_if(around.begin(), around.end(), [&](unsigned int t) { return !live[t]; }), around.end());
+        version[to]++;
+        worstCost = std::max(worstCost, collapse.Cost);
+
+        // As arestas de 'to' mudaram de custo; entram de novo com a nova versao.
+        stamp++;
+        for (unsigned int t : around) {
+            for (size_t k = 0; k < 3; ++k) {
+                const unsigned int w = triangles[t * 3 + k];
+                if (w == to || neighborStamp[w] == stamp) continue;
+                neighborStamp[w] = stamp;
+                pushEdge(to, w);
+            }
+        }
+    }
+
+    // Cada canto volta a um vertice real: o original, se a posicao nao mudou, ou
+    // o vertice da posicao de destino com a normal mais parecida.
+    std::vector<unsigned int> result;
+    result.reserve(liveCount * 3);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        if (!live[t]) continue;
+        for (size_t k = 0; k < 3; ++k) {
+            const unsigned int original = indices[t * 3 + k];
+            const unsigned int target = triangles[t * 3 + k];
+            if (weld[original] == target) {
+                result.push_back(original);
+                continue;
+            }
+
+            const XMFLOAT3& n = vertices[original].Normal;
+            unsigned int best = firstVertex[target];
+            float bestDot = -std::numeric_limits<float>::infinity();
+            for (unsigned int v = firstVertex[target]; v != unused; v = nextSamePosition[v]) {
+                const XMFLOAT3& m = vertices[v].Normal;
+                const float dot = n.x * m.x + n.y * m.y + n.z * m.z;
+                if (dot > bestDot) {
+                    bestDot = dot;
+                    best = v;
+                }
+            }
+            result.push_back(best);
+        }
+    }
+
+    if (resultError) *resultError = static_cast<float>(std::sqrt(worstCost));
+    return result;
+}
+
+void GenerateLods(Model& model, const LodOptions& options)
+{
+    model.lods.clear();
+    model.lodRanges = GetSubmeshes(model);
+
+    MeshLod full;
+    full.RangeCount = static_cast<unsigned int>(model.lodRanges.size());
+    for (const Submesh& range : model.lodRanges) full.TriangleCount += range.IndexCount / 3;
+    model.lods.push_back(full);
+
+    while (model.lods.size() < options.MaxLods) {
+        const MeshLod previous = model.lods.back();
+        if (previous.TriangleCount <= options.MinTriangles) break;
+
+        const size_t indexMark = model.indices.size();
+        const size_t rangeMark = model.lodRanges.size();
+        MeshLod lod;
+        lod.FirstRange = static_cast<unsigned int>(rangeMark);
+        float stepError = 0.0f;
+
+        for (unsigned int r = 0; r < previous.RangeCount; ++r) {
+            const Submesh source = model.lodRanges[previous.FirstRange + r];
+            const size_t target = static_cast<size_t>(source.IndexCount / 3 * options.ReductionPerLod) * 3;
+
+            float error = 0.0f;
+            std::vector<unsigned int> simplified = SimplifyIndices(model.vertices.data() + source.BaseVertex, source.VertexCount,
+                model.indices.data() + source.IndexStart, source.IndexCount, target, options.MaxError - previous.Error, &error);
+            if (simplified.empty()) continue;
+            OptimizeVertexCache(simplified, source.VertexCount);
+
+            Submesh range = source;
+            range.IndexStart = static_cast<unsigned int>(model.indices.size());
+            range.IndexCount = static_cast<unsigned int>(simplified.size());
+            model.indices.insert(model.indices.end(), simplified.begin(), simplified.end());
+            model.lodRanges.push_back(range);
+
+            lod.RangeCount++;
+            lod.TriangleCount += range.IndexCount / 3;
+            stepError = std::max(stepError, error);
+        }
+
+        // Nivel que quase nao reduziu: bordas travadas ou o limite de erro seguraram o resto.
+        if (lod.TriangleCount == 0 || lod.TriangleCount > previous.TriangleCount * 0.9) {
+            model.indices.resize(indexMark);
+            model.lodRanges.resize(rangeMark);
+            break;
+        }
+
+        // Cada nivel parte do anterior, entao os erros se acumulam.
+        lod.Error = previous.Error + stepError;
+        model.lods.push_back(lod);
+    }
+}
+
+size_t SelectLod(const MeshLod* lods, size_t lodCount, const MeshBounds& bounds, FXMMATRIX world,
+    CXMMATRIX projection, const XMFLOAT3& cameraPos, float viewportHeight, float maxPixelError)
+{
+    if (lodCount == 0) return 0;
+
+    const XMVECTOR boundsMin = XMLoadFloat3(&bounds.Min);
+    const XMVECTOR boundsMax = XMLoadFloat3(&bounds.Max);
+    const XMVECTOR center = XMVector3TransformCoord(XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f), world);
+    const float scale = std::max({ XMVectorGetX(XMVector3Length(world.r[0])),
+        XMVectorGetX(XMVector3Length(world.r[1])), XMVectorGetX(XMVector3Length(world.r[2])) });
+    const float radius = 0.5f * XMVectorGetX(XMVector3Length(XMVectorSubtract(boundsMax, boundsMin))) * scale;
+
+    // Distancia ate a superficie da esfera; dentro dela vale sempre o nivel 0.
+    const float distance = XMVectorGetX(XMVector3Length(XMVectorSubtract(center, XMLoadFloat3(&cameraPos)))) - radius;
+    if (distance <= 0.0f) return 0;
+
+    XMFLOAT4X4 proj;
+    XMStoreFloat4x4(&proj, projection);
+    const float pixelsPerUnit = proj.m[1][1] * viewportHeight * 0.5f / distance;
+
+    size_t chosen = 0;
+    for (size_t i = 1; i < lodCount; ++i) {
+        if (lods[i].Error * scale * pixelsPerUnit > maxPixelError) break;
+        chosen = i;
+    }
+    return chosen;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Mesh.h"
+
+// Simplificacao por colapso de arestas com metrica de erro quadrica
+// (Garland & Heckbert 1997). Cada vertice colapsa sobre um vizinho existente,
+// entao o resultado indexa o mesmo array de vertices e nenhum vertice e criado.
+// Vertices com a mesma posicao (costuras de normal/uv) colapsam juntos; bordas
+// e arestas nao-manifold ficam travadas, o que tambem evita rachaduras entre
+// faixas vizinhas de SplitMeshForIndex16.
+// Para quando restarem targetIndexCount indices ou quando o proximo colapso
+// passar de maxError (distancia em unidades do modelo). Retorna em resultError
+// o maior erro aceito.
+std::vector<unsigned int> SimplifyIndices(const Vertex* vertices, size_t vertexCount,
+    const unsigned int* indices, size_t indexCount, size_t targetIndexCount, float maxError, float* resultError = nullptr);
+
+struct LodOptions
+{
+    size_t MaxLods = 8;              // incluindo a malha completa
+    float ReductionPerLod = 0.5f;    // fracao de triangulos mantida a cada nivel
+    size_t MinTriangles = 64;
+    float MaxError = 1e30f;
+};
+
+// Gera model.lods e model.lodRanges a partir das faixas de submeshes. O nivel 0
+// e a malha completa; os demais sao simplificados em cadeia (cada um a partir
+// do anterior) e os indices vao para o fim de model.indices. Chamar depois de
+// SplitMeshForIndex16, que descarta faixas extras.
+void GenerateLods(Model& model, const LodOptions& options = LodOptions());
+
+// Escolhe o LOD mais grosseiro cujo erro projetado na tela fica abaixo de
+// maxPixelError. Usa a esfera envolvente de 'bounds' (espaco do modelo) e a
+// escala focal vertical de 'projection' (camera de Camera::GetProjection).
+size_t SelectLod(const MeshLod* lods, size_t lodCount, const MeshBounds& bounds, DirectX::FXMMATRIX world,
+    DirectX::CXMMATRIX projection, const DirectX::XMFLOAT3& cameraPos, float viewportHeight, float maxPixelError);
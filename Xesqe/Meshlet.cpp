@@ -0,0 +1,308 @@
+#include "pch.h"
+#include "Meshlet.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+    // Esfera (centro do AABB) e cone de normais dos triangulos do meshlet.
+    void ComputeMeshletBounds(Meshlet& meshlet, const Model& model)
+    {
+        const Vertex* base = model.vertices.data() + meshlet.BaseVertex;
+        const unsigned int* indices = model.indices.data() + meshlet.IndexStart;
+        const size_t indexCount = meshlet.TriangleCount * 3;
+
+        XMVECTOR vMin = XMLoadFloat3(&base[indices[0]].Pos);
+        XMVECTOR vMax = vMin;
+        for (size_t i = 1; i < indexCount; ++i) {
+            XMVECTOR p = XMLoadFloat3(&base[indices[i]].Pos);
+            vMin = XMVectorMin(vMin, p);
+            vMax = XMVectorMax(vMax, p);
+        }
+        XMVECTOR center = XMVectorScale(XMVectorAdd(vMin, vMax), 0.5f);
+        float radius = 0.0f;
+        for (size_t i = 0; i < indexCount; ++i) {
+            XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&base[indices[i]].Pos), center);
+            radius = std::max(radius, XMVectorGetX(XMVector3Length(offset)));
+        }
+        XMStoreFloat3(&meshlet.Center, center);
+        meshlet.Radius = radius;
+
+        // Normais de face com o mesmo sentido de OptimizeOverdraw (cross(p1 - p0, p2 - p0) para fora).
+        XMVECTOR normals[MaxMeshletTriangles];
+        size_t normalCount = 0;
+        XMVECTOR axis = XMVectorZero();
+        for (size_t t = 0; t < meshlet.TriangleCount; ++t) {
+            XMVECTOR p0 = XMLoadFloat3(&base[indices[t * 3 + 0]].Pos);
+            XMVECTOR p1 = XMLoadFloat3(&base[indices[t * 3 + 1]].Pos);
+            XMVECTOR p2 = XMLoadFloat3(&base[indices[t * 3 + 2]].Pos);
+            XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+            const float length = XMVectorGetX(XMVector3Length(n));
+            if (length == 0.0f) continue;
+            n = XMVectorScale(n, 1.0f / length);
+            normals[normalCount++] = n;
+            axis = XMVectorAdd(axis, n);
+        }
+
+        meshlet.ConeAxis = { 0.0f, 0.0f, 0.0f };
+        meshlet.ConeCutoff = 1.0f;
+        const float axisLength = XMVectorGetX(XMVector3Length(axis));
+        if (normalCount == 0 || axisLength == 0.0f) return;
+
+        axis = XMVectorScale(axis, 1.0f / axisLength);
+        float minDot = 1.0f;
+        for (size_t i = 0; i < normalCount; ++i) {
+            minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(normals[i], axis)));
+        }
+
+        XMStoreFloat3(&meshlet.ConeAxis, axis);
+        // Cone quase aberto (meia abertura perto de 90 graus) nao descarta nada.
+        if (minDot > 0.1f) meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    void AppendDrawRange(std::vector<DrawRange>& ranges, unsigned int indexStart, unsigned int indexCount,
+        unsigned int baseVertex, unsigned int material)
+    {
+        if (!ranges.empty() && ranges.back().BaseVertex == baseVertex && ranges.back().Material == material &&
+            ranges.back().IndexStart + ranges.back().IndexCount == indexStart) {
+            ranges.back().IndexCount += indexCount;
+            return;
+        }
+        DrawRange range;
+        range.IndexStart = indexStart;
+        range.IndexCount = indexCount;
+        range.BaseVertex = baseVertex;
+        range.Material = material;
+        ranges.push_back(range);
+    }
+
+    // Meshlets [first, last) de 4 em 4: cada lane de um XMVECTOR e um meshlet.
+    void CullMeshletRange(const MeshletSet& set, size_t first, size_t last, const XMFLOAT4 plane[6],
+        const XMFLOAT3& cameraLocal, std::vector<DrawRange>& ranges, MeshletCullStats& stats)
+    {
+        const XMVECTOR camX = XMVectorReplicate(cameraLocal.x);
+        const XMVECTOR camY = XMVectorReplicate(cameraLocal.y);
+        const XMVECTOR camZ = XMVectorReplicate(cameraLocal.z);
+
+        for (size_t i = first; i < last; i += 4) {
+            const XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&set.CenterX[i]));
+            const XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&set.CenterY[i]));
+            const XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&set.CenterZ[i]));
+            const XMVECTOR radius = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&set.Radius[i]));
+            const XMVECTOR negRadius = XMVectorNegate(radius);
+
+            XMVECTOR culled = XMVectorFalseInt();
+            for (int p = 0; p < 6; ++p) {
+                XMVECTOR distance = XMVectorReplicate(plane[p].w);
+                distance = XMVectorMultiplyAdd(cx, XMVectorReplicate(plane[p].x), distance);
+                distance = XMVectorMultiplyAdd(cy, XMVectorReplicate(plane[p].y), distance);
+                distance = XMVectorMultiplyAdd(cz, XMVectorReplicate(plane[p].z), distance);
+                culled = XMVectorOrInt(culled, XMVectorLess(distance, negRadius));
+            }
+
+            const XMVECTOR vx = XMVectorSubtract(cx, camX);
+            const XMVECTOR vy = XMVectorSubtract(cy, camY);
+            const XMVECTOR vz = XMVectorSubtract(cz, camZ);
+            const XMVECTOR ax = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&set.AxisX[i]));
+            const XMVECTOR ay = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&set.AxisY[i]));
+            const XMVECTOR az = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&set.AxisZ[i]));
+            const XMVECTOR cutoff = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&set.Cutoff[i]));
+
+            XMVECTOR lengthSq = XMVectorMultiply(vx, vx);
+            lengthSq = XMVectorMultiplyAdd(vy, vy, lengthSq);
+            lengthSq = XMVectorMultiplyAdd(vz, vz, lengthSq);
+            XMVECTOR facing = XMVectorMultiply(vx, ax);
+            facing = XMVectorMultiplyAdd(vy, ay, facing);
+            facing = XMVectorMultiplyAdd(vz, az, facing);
+            const XMVECTOR limit = XMVectorMultiplyAdd(cutoff, XMVectorSqrt(lengthSq), radius);
+            culled = XMVectorOrInt(culled, XMVectorGreaterOrEqual(facing, limit));
+
+            uint32_t mask[4];
+            XMStoreInt4(mask, culled);
+
+            const size_t lanes = std::min<size_t>(4, last - i);
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                const Meshlet& m = set.Meshlets[i + lane];
+                stats.Triangles += m.TriangleCount;
+                if (mask[lane]) continue;
+
+                stats.VisibleMeshlets++;
+                stats.VisibleTriangles += m.TriangleCount;
+                AppendDrawRange(ranges, m.IndexStart, m.TriangleCount * 3, m.BaseVertex, m.Material);
+            }
+        }
+    }
+}
+
+void ExtractFrustumPlanes(FXMMATRIX worldViewProj, XMFLOAT4 plane[6])
+{
+    XMMATRIX columns = XMMatrixTranspose(worldViewProj);
+    XMVECTOR planes[6] = {
+        XMVectorAdd(columns.r[3], columns.r[0]),
+        XMVectorSubtract(columns.r[3], columns.r[0]),
+        XMVectorAdd(columns.r[3], columns.r[1]),
+        XMVectorSubtract(columns.r[3], columns.r[1]),
+        columns.r[2],
+        XMVectorSubtract(columns.r[3], columns.r[2])
+    };
+    for (int p = 0; p < 6; ++p) XMStoreFloat4(&plane[p], XMPlaneNormalize(planes[p]));
+}
+
+// Distancia do centro menor que -(projecao das meias-extensoes na normal).
+bool BoundsOutside(const XMFLOAT4 plane[6], const MeshBounds& bounds)
+{
+    const XMVECTOR boundsMin = XMLoadFloat3(&bounds.Min);
+    const XMVECTOR boundsMax = XMLoadFloat3(&bounds.Max);
+    const XMVECTOR center = XMVectorScale(XMVectorAdd(boundsMin, boundsMax), 0.5f);
+    const XMVECTOR extents = XMVectorScale(XMVectorSubtract(boundsMax, boundsMin), 0.5f);
+    for (int p = 0; p < 6; ++p) {
+        const XMVECTOR normal = XMLoadFloat4(&plane[p]);
+        const float distance = XMVectorGetX(XMVector3Dot(normal, center)) + plane[p].w;
+        const float radius = XMVectorGetX(XMVector3Dot(XMVectorAbs(normal), extents));
+        if (distance < -radius) return true;
+    }
+    return false;
+}
+
+std::vector<Meshlet> BuildMeshlets(const Model& model)
+{
+    std::vector<Meshlet> meshlets;
+    const std::vector<Submesh> parts = GetSubmeshes(model);
+
+    // Marca em que meshlet cada vertice ja entrou (indice + 1; 0 = nenhum).
+    std::vector<unsigned int> owner(model.vertices.size(), 0);
+
+    for (const Submesh& part : parts) {
+        Meshlet current;
+        current.IndexStart = part.IndexStart;
+        current.BaseVertex = part.BaseVertex;
+        current.Material = part.Material;
+
+        auto flush = [&]() {
+            if (current.TriangleCount == 0) return;
+            ComputeMeshletBounds(current, model);
+            meshlets.push_back(current);
+            Meshlet next;
+            next.IndexStart = current.IndexStart + current.TriangleCount * 3;
+            next.BaseVertex = part.BaseVertex;
+            next.Material = part.Material;
+            current = next;
+        };
+
+        for (unsigned int t = 0; t + 2 < part.IndexCount; t += 3) {
+            const unsigned int* tri = model.indices.data() + part.IndexStart + t;
+            const unsigned int id = static_cast<unsigned int>(meshlets.size()) + 1;
+
+            size_t newVertices = 0;
+            for (size_t k = 0; k < 3; ++k) {
+                const unsigned int v = part.BaseVertex + tri[k];
+                if (owner[v] != id && (k == 0 || tri[k] != tri[0]) && (k < 2 || tri[k] != tri[1])) newVertices++;
+            }
+
+            if (current.VertexCount + newVertices > MaxMeshletVertices || current.TriangleCount == MaxMeshletTriangles) {
+                flush();
+            }
+
+            const unsigned int currentId = static_cast<unsigned int>(meshlets.size()) + 1;
+            for (size_t k = 0; k < 3; ++k) {
+                const unsigned int v = part.BaseVertex + tri[k];
+                if (owner[v] != currentId) {
+                    owner[v] = currentId;
+                    current.VertexCount++;
+                }
+            }
+            current.TriangleCount++;
+        }
+        flush();
+    }
+    return meshlets;
+}
+
+void MeshletSet::Assign(const Meshlet* meshlets, size_t count, const Submesh* parts, size_t partCount)
+{
+    Meshlets.assign(meshlets, meshlets + count);
+
+    // BuildMeshlets emite os meshlets faixa a faixa, na ordem das faixas.
+    Parts.clear();
+    PartMeshlets.clear();
+    size_t next = 0;
+    for (size_t p = 0; p < partCount; ++p) {
+        PartMeshlets.push_back(static_cast<unsigned int>(next));
+        while (next < count && meshlets[next].BaseVertex == parts[p].BaseVertex &&
+            meshlets[next].IndexStart >= parts[p].IndexStart && meshlets[next].IndexStart < parts[p].IndexStart + parts[p].IndexCount) {
+            next++;
+        }
+    }
+    if (partCount > 0 && next == count) {
+        PartMeshlets.push_back(static_cast<unsigned int>(count));
+        Parts.assign(parts, parts + partCount);
+    }
+    else {
+        PartMeshlets.clear();
+    }
+
+    const size_t padded = count + 3;
+    std::vector<float>* columns[] = { &CenterX, &CenterY, &CenterZ, &Radius, &AxisX, &AxisY, &AxisZ, &Cutoff };
+    for (std::vector<float>* column : columns) column->assign(padded, 0.0f);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Meshlet& m = meshlets[i];
+        CenterX[i] = m.Center.x;
+        CenterY[i] = m.Center.y;
+        CenterZ[i] = m.Center.z;
+        Radius[i] = m.Radius;
+        AxisX[i] = m.ConeAxis.x;
+        AxisY[i] = m.ConeAxis.y;
+        AxisZ[i] = m.ConeAxis.z;
+        Cutoff[i] = m.ConeCutoff;
+    }
+}
+
+void CullMeshlets(DirectX::FXMMATRIX worldViewProj, const DirectX::XMFLOAT3& cameraLocal, const MeshletSet& set,
+    std::vector<DrawRange>& ranges, MeshletCullStats& stats)
+{
+    ranges.clear();
+    stats = MeshletCullStats();
+    stats.Meshlets = set.Meshlets.size();
+
+    XMFLOAT4 plane[6];
+    ExtractFrustumPlanes(worldViewProj, plane);
+
+    if (set.Parts.empty()) {
+        CullMeshletRange(set, 0, set.Meshlets.size(), plane, cameraLocal, ranges, stats);
+    }
+    for (size_t p = 0; p < set.Parts.size(); ++p) {
+        stats.Parts++;
+        if (BoundsOutside(plane, set.Parts[p].Bounds)) {
+            stats.Triangles += set.Parts[p].IndexCount / 3;
+            continue;
+        }
+        stats.VisibleParts++;
+        CullMeshletRange(set, set.PartMeshlets[p], set.PartMeshlets[p + 1], plane, cameraLocal, ranges, stats);
+    }
+    stats.DrawRanges = ranges.size();
+}
+
+void CullSubmeshes(DirectX::FXMMATRIX worldViewProj, const Submesh* parts, size_t count,
+    std::vector<DrawRange>& ranges, MeshletCullStats& stats)
+{
+    ranges.clear();
+    stats = MeshletCullStats();
+
+    XMFLOAT4 plane[6];
+    ExtractFrustumPlanes(worldViewProj, plane);
+
+    for (size_t p = 0; p < count; ++p) {
+        const Submesh& part = parts[p];
+        stats.Parts++;
+        stats.Triangles += part.IndexCount / 3;
+        if (part.IndexCount == 0 || BoundsOutside(plane, part.Bounds)) continue;
+
+        stats.VisibleParts++;
+        stats.VisibleTriangles += part.IndexCount / 3;
+        AppendDrawRange(ranges, part.IndexStart, part.IndexCount, part.BaseVertex, part.Material);
+    }
+    stats.DrawRanges = ranges.size();
+}
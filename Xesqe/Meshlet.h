@@ -0,0 +1,83 @@
+#pragma once
+#include "Mesh.h"
+
+// Clusters de ate 64 vertices e 124 triangulos. Cada meshlet e uma faixa
+// contigua do buffer de indices (na ordem ja otimizada), entao o culling so
+// precisa escolher faixas; nada e reordenado nem duplicado.
+const size_t MaxMeshletVertices = 64;
+const size_t MaxMeshletTriangles = 124;
+
+struct Meshlet
+{
+    unsigned int IndexStart = 0;
+    unsigned int TriangleCount = 0;
+    unsigned int BaseVertex = 0;      // BaseVertex da Submesh de origem
+    unsigned int VertexCount = 0;
+    unsigned int Material = 0;        // Material da Submesh de origem
+    DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+    float Radius = 0.0f;
+    // Cone de normais: o cluster inteiro esta de costas quando
+    // dot(Center - camera, ConeAxis) >= ConeCutoff * |Center - camera| + Radius.
+    // ConeCutoff == 1 desliga o teste (normais espalhadas demais).
+    DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 0.0f };
+    float ConeCutoff = 1.0f;
+};
+
+// Planos do frustum no espaco do modelo (Gribb/Hartmann; z do D3D vai de 0 a w),
+// normalizados e com a normal para dentro.
+void ExtractFrustumPlanes(DirectX::FXMMATRIX worldViewProj, DirectX::XMFLOAT4 plane[6]);
+
+// AABB inteiro atras de algum dos planos.
+bool BoundsOutside(const DirectX::XMFLOAT4 plane[6], const MeshBounds& bounds);
+
+// Particiona as faixas do modelo em meshlets, na ordem dos triangulos.
+std::vector<Meshlet> BuildMeshlets(const Model& model);
+
+// Esferas e cones em SoA para o culling SIMD, com 3 floats de padding para
+// ler 4 lanes a partir de qualquer meshlet. Com as faixas de origem (Parts),
+// o AABB de cada faixa e testado antes e os meshlets de faixas fora do
+// frustum nem sao visitados.
+struct MeshletSet
+{
+    std::vector<Meshlet> Meshlets;
+    std::vector<float> CenterX, CenterY, CenterZ, Radius;
+    std::vector<float> AxisX, AxisY, AxisZ, Cutoff;
+    std::vector<Submesh> Parts;
+    std::vector<unsigned int> PartMeshlets;   // meshlets de Parts[p]: [PartMeshlets[p], PartMeshlets[p + 1])
+
+    // 'parts' sao as faixas passadas a BuildMeshlets; se nao baterem com os
+    // meshlets, o culling por faixa fica desligado.
+    void Assign(const Meshlet* meshlets, size_t count, const Submesh* parts = nullptr, size_t partCount = 0);
+};
+
+struct DrawRange
+{
+    unsigned int IndexStart = 0;
+    unsigned int IndexCount = 0;
+    unsigned int BaseVertex = 0;
+    unsigned int Material = 0;
+};
+
+struct MeshletCullStats
+{
+    size_t Meshlets = 0;
+    size_t VisibleMeshlets = 0;
+    size_t Triangles = 0;
+    size_t VisibleTriangles = 0;
+    size_t DrawRanges = 0;
+    size_t Parts = 0;
+    size_t VisibleParts = 0;
+};
+
+// Descarta meshlets fora do frustum de worldViewProj ou totalmente de costas
+// para cameraLocal (posicao da camera no espaco do modelo) e junta os visiveis
+// vizinhos (mesmo BaseVertex e material) em faixas de desenho. Assume escala
+// uniforme na matriz world.
+void CullMeshlets(DirectX::FXMMATRIX worldViewProj, const DirectX::XMFLOAT3& cameraLocal, const MeshletSet& set,
+    std::vector<DrawRange>& ranges, MeshletCullStats& stats);
+
+// Culling so pelo AABB de cada faixa (Submesh::Bounds), para os LODs e modelos
+// sem meshlets. Faixas visiveis e contiguas com o mesmo BaseVertex e material
+// viram uma faixa de desenho.
+void CullSubmeshes(DirectX::FXMMATRIX worldViewProj, const Submesh* parts, size_t count,
+    std::vector<DrawRange>& ranges, MeshletCullStats& stats);
@@ -0,0 +1,296 @@
+#include "pch.h"
+#include "Noise.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#define NOISE_USE_AVX2 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define NOISE_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr float F2 = 0.366025403784438646763723f;   // (sqrt(3) - 1) / 2
+    constexpr float G2 = 0.211324865405187117745426f;   // (3 - sqrt(3)) / 6
+    constexpr float G2x2 = 2.0f * G2;
+    constexpr uint32_t WarpSeedX = 0x9E3779B9u;
+    constexpr uint32_t WarpSeedY = 0x7F4A7C15u;
+
+    // O algoritmo e escrito uma vez sobre estas operacoes: ScalarOps para um ponto,
+    // SimdOps para um registrador cheio. As duas fazem as mesmas contas na mesma
+    // ordem (sem contracao em FMA, o padrao do /fp:precise), dai o mesmo resultado.
+    struct ScalarOps
+    {
+        using F = float;
+        using I = uint32_t;
+        using M = bool;
+
+        static F Set(float v) { return v; }
+        static I SetI(uint32_t v) { return v; }
+        static F Add(F a, F b) { return a + b; }
+        static F Sub(F a, F b) { return a - b; }
+        static F Mul(F a, F b) { return a * b; }
+        static F Max(F a, F b) { return a > b ? a : b; }
+        static F Abs(F a) { return std::fabs(a); }
+        static F Floor(F a) { return std::floor(a); }
+        static I ToInt(F a) { return uint32_t(int32_t(a)); }
+        static M Greater(F a, F b) { return a > b; }
+        static M HasBit(I a, uint32_t bit) { return (a & bit) != 0; }
+        static F Select(M m, F a, F b) { return m ? a : b; }
+        static I SelectI(M m, I a, I b) { return m ? a : b; }
+        // Troca o sinal de a quando o bit 0 de bits esta ligado.
+        static F FlipSign(F a, I bits) { return (bits & 1) ? -a : a; }
+        static I AddI(I a, I b) { return a + b; }
+        static I XorI(I a, I b) { return a ^ b; }
+        static I MulI(I a, I b) { return a * b; }
+        static I ShiftRight(I a, int n) { return a >> n; }
+    };
+
+#if defined(NOISE_USE_AVX2)
+    struct SimdOps
+    {
+        using F = __m256;
+        using I = __m256i;
+        using M = __m256;
+        static constexpr int Lanes = 8;
+
+        static F Set(float v) { return _mm256_set1_ps(v); }
+        static I SetI(uint32_t v) { return _mm256_set1_epi32(int32_t(v)); }
+        static F Add(F a, F b) { return _mm256_add_ps(a, b); }
+        static F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+        static F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+        static F Max(F a, F b) { return _mm256_max_ps(a, b); }
+        static F Abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static F Floor(F a) { return _mm256_floor_ps(a); }
+        static I ToInt(F a) { return _mm256_cvttps_epi32(a); }
+        static F ToFloat(I a) { return _mm256_cvtepi32_ps(a); }
+        static M Greater(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static M HasBit(I a, uint32_t bit)
+        {
+            const I mask = SetI(bit);
+            return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a, mask), mask));
+        }
+        static F Select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+        static I SelectI(M m, I a, I b) { return _mm256_castps_si256(Select(m, _mm256_castsi256_ps(a), _mm256_castsi256_ps(b))); }
+        static F FlipSign(F a, I bits) { return _mm256_xor_ps(a, _mm256_castsi256_ps(_mm256_slli_epi32(bits, 31))); }
+        static I AddI(I a, I b) { return _mm256_add_epi32(a, b); }
+        static I XorI(I a, I b) { return _mm256_xor_si256(a, b); }
+        static I MulI(I a, I b) { return _mm256_mullo_epi32(a, b); }
+        static I ShiftRight(I a, int n) { return _mm256_srli_epi32(a, n); }
+        static I LaneIndex() { return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7); }
+        static void Store(float* out, F v) { _mm256_storeu_ps(out, v); }
+    };
+#elif defined(NOISE_USE_SSE2)
+    // SSE2 nao tem floor, blend nem multiplicacao de inteiros de 32 bits; as tres
+    // sao montadas com as instrucoes que existem.
+    struct SimdOps
+    {
+        using F = __m128;
+        using I = __m128i;
+        using M = __m128;
+        static constexpr int Lanes = 4;
+
+        static F Set(float v) { return _mm_set1_ps(v); }
+        static I SetI(uint32_t v) { return _mm_set1_epi32(int32_t(v)); }
+        static F Add(F a, F b) { return _mm_add_ps(a, b); }
+        static F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+        static F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+        static F Max(F a, F b) { return _mm_max_ps(a, b); }
+        static F Abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static F Floor(F a)
+        {
+            const F truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+            return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a), _mm_set1_ps(1.0f)));
+        }
+        static I ToInt(F a) { return _mm_cvttps_epi32(a); }
+        static F ToFloat(I a) { return _mm_cvtepi32_ps(a); }
+        static M Greater(F a, F b) { return _mm_cmpgt_ps(a, b); }
+        static M HasBit(I a, uint32_t bit)
+        {
+            const I mask = SetI(bit);
+            return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a, mask), mask));
+        }
+        static F Select(M m, F a, F b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        static I SelectI(M m, I a, I b) { return _mm_castps_si128(Select(m, _mm_castsi128_ps(a), _mm_castsi128_ps(b))); }
+        static F FlipSign(F a, I bits) { return _mm_xor_ps(a, _mm_castsi128_ps(_mm_slli_epi32(bits, 31))); }
+        static I AddI(I a, I b) { return _mm_add_epi32(a, b); }
+        static I XorI(I a, I b) { return _mm_xor_si128(a, b); }
+        static I MulI(I a, I b)
+        {
+            const I even = _mm_mul_epu32(a, b);
+            const I odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+        static I ShiftRight(I a, int n) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+        static I LaneIndex() { return _mm_setr_epi32(0, 1, 2, 3); }
+        static void Store(float* out, F v) { _mm_storeu_ps(out, v); }
+    };
+#endif
+
+    template <typename Ops>
+    typename Ops::I Hash(typename Ops::I i, typename Ops::I j, typename Ops::I seed)
+    {
+        typename Ops::I h = Ops::XorI(seed, Ops::XorI(Ops::MulI(i, Ops::SetI(0x27D4EB2Du)), Ops::MulI(j, Ops::SetI(0x165667B1u))));
+        h = Ops::XorI(h, Ops::ShiftRight(h, 15));
+        h = Ops::MulI(h, Ops::SetI(0x2C1B3C6Du));
+        return Ops::XorI(h, Ops::ShiftRight(h, 12));
+    }
+
+    // Um dos 8 gradientes (+-1, +-2) e (+-2, +-1), escolhido pelos 3 bits baixos do hash.
+    template <typename Ops>
+    typename Ops::F Grad(typename Ops::I h, typename Ops::F x, typename Ops::F y)
+    {
+        const typename Ops::M swap = Ops::HasBit(h, 4);
+        const typename Ops::F u = Ops::Select(swap, y, x);
+        const typename Ops::F v = Ops::Select(swap, x, y);
+        return Ops::Add(Ops::FlipSign(u, h), Ops::FlipSign(Ops::Mul(Ops::Set(2.0f), v), Ops::ShiftRight(h, 1)));
+    }
+
+    template <typename Ops>
+    typename Ops::F Corner(typename Ops::I h, typename Ops::F x, typename Ops::F y)
+    {
+        typename Ops::F t = Ops::Sub(Ops::Sub(Ops::Set(0.5f), Ops::Mul(x, x)), Ops::Mul(y, y));
+        t = Ops::Max(t, Ops::Set(0.0f));
+        t = Ops::Mul(t, t);
+        return Ops::Mul(Ops::Mul(t, t), Grad<Ops>(h, x, y));
+    }
+
+    template <typename Ops>
+    typename Ops::F Simplex(typename Ops::F x, typename Ops::F y, typename Ops::I seed)
+    {
+        using F = typename Ops::F;
+        using I = typename Ops::I;
+
+        // Celula do triangulo que contem o ponto, na grade inclinada.
+        const F s = Ops::Mul(Ops::Add(x, y), Ops::Set(F2));
+        const F fi = Ops::Floor(Ops::Add(x, s));
+        const F fj = Ops::Floor(Ops::Add(y, s));
+        const F t = Ops::Mul(Ops::Add(fi, fj), Ops::Set(G2));
+        const F x0 = Ops::Sub(x, Ops::Sub(fi, t));
+        const F y0 = Ops::Sub(y, Ops::Sub(fj, t));
+
+        // Triangulo de baixo (1, 0) ou de cima (0, 1).
+        const typename Ops::M lower = Ops::Greater(x0, y0);
+        const F one = Ops::Set(1.0f);
+        const F zero = Ops::Set(0.0f);
+        const F x1 = Ops::Add(Ops::Sub(x0, Ops::Select(lower, one, zero)), Ops::Set(G2));
+        const F y1 = Ops::Add(Ops::Sub(y0, Ops::Select(lower, zero, one)), Ops::Set(G2));
+        const F x2 = Ops::Add(Ops::Sub(x0, one), Ops::Set(G2x2));
+        const F y2 = Ops::Add(Ops::Sub(y0, one), Ops::Set(G2x2));
+
+        const I i = Ops::ToInt(fi);
+        const I j = Ops::ToInt(fj);
+        const I oneI = Ops::SetI(1);
+        const I zeroI = Ops::SetI(0);
+        const I h0 = Hash<Ops>(i, j, seed);
+        const I h1 = Hash<Ops>(Ops::AddI(i, Ops::SelectI(lower, oneI, zeroI)), Ops::AddI(j, Ops::SelectI(lower, zeroI, oneI)), seed);
+        const I h2 = Hash<Ops>(Ops::AddI(i, oneI), Ops::AddI(j, oneI), seed);
+
+        const F n = Ops::Add(Ops::Add(Corner<Ops>(h0, x0, y0), Corner<Ops>(h1, x1, y1)), Corner<Ops>(h2, x2, y2));
+        return Ops::Mul(n, Ops::Set(40.0f));
+    }
+
+    // Soma de Octaves oitavas dividida pela soma das amplitudes.
+    template <typename Ops>
+    typename Ops::F Octaves(typename Ops::F x, typename Ops::F y, const NoiseSettings& settings, uint32_t seed, bool ridged)
+    {
+        typename Ops::F sum = Ops::Set(0.0f);
+        float amplitude = 1.0f;
+        float frequency = settings.Frequency;
+        float total = 0.0f;
+        for (int octave = 0; octave < settings.Octaves; ++octave) {
+            typename Ops::F n = Simplex<Ops>(Ops::Mul(x, Ops::Set(frequency)), Ops::Mul(y, Ops::Set(frequency)),
+                Ops::SetI(seed + uint32_t(octave)));
+            if (ridged) {
+                n = Ops::Sub(Ops::Set(1.0f), Ops::Abs(n));
+                n = Ops::Mul(n, n);
+            }
+            sum = Ops::Add(sum, Ops::Mul(Ops::Set(amplitude), n));
+            total += amplitude;
+            amplitude *= settings.Gain;
+            frequency *= settings.Lacunarity;
+        }
+        return Ops::Mul(sum, Ops::Set(total > 0.0f ? 1.0f / total : 0.0f));
+    }
+
+    template <typename Ops>
+    typename Ops::F Evaluate(typename Ops::F x, typename Ops::F y, const NoiseSettings& settings)
+    {
+        typename Ops::F value;
+        switch (settings.Type) {
+        case NoiseType::Ridged:
+            value = Octaves<Ops>(x, y, settings, settings.Seed, true);
+            break;
+        case NoiseType::DomainWarped: {
+            const typename Ops::F strength = Ops::Set(settings.WarpStrength);
+            const typename Ops::F warpX = Octaves<Ops>(x, y, settings, settings.Seed ^ WarpSeedX, false);
+            const typename Ops::F warpY = Octaves<Ops>(x, y, settings, settings.Seed ^ WarpSeedY, false);
+            value = Octaves<Ops>(Ops::Add(x, Ops::Mul(strength, warpX)), Ops::Add(y, Ops::Mul(strength, warpY)),
+                settings, settings.Seed, false);
+            break;
+        }
+        default:
+            value = Octaves<Ops>(x, y, settings, settings.Seed, false);
+            break;
+        }
+        return Ops::Mul(value, Ops::Set(settings.Amplitude));
+    }
+}
+
+float SimplexNoise(float x, float y, uint32_t seed)
+{
+    return Simplex<ScalarOps>(x, y, seed);
+}
+
+float FractalNoise(float x, float y, const NoiseSettings& settings)
+{
+    return Evaluate<ScalarOps>(x, y, settings);
+}
+
+void FractalNoiseLine(float x, float y0, float dy, const NoiseSettings& settings, std::span<float> out)
+{
+    size_t k = 0;
+#if defined(NOISE_USE_AVX2) || defined(NOISE_USE_SSE2)
+    const SimdOps::F xs = SimdOps::Set(x);
+    for (; k + SimdOps::Lanes <= out.size(); k += SimdOps::Lanes) {
+        const SimdOps::F index = SimdOps::ToFloat(SimdOps::AddI(SimdOps::SetI(uint32_t(k)), SimdOps::LaneIndex()));
+        const SimdOps::F ys = SimdOps::Add(SimdOps::Set(y0), SimdOps::Mul(index, SimdOps::Set(dy)));
+        SimdOps::Store(out.data() + k, Evaluate<SimdOps>(xs, ys, settings));
+    }
+#endif
+    for (; k < out.size(); ++k) {
+        out[k] = FractalNoise(x, y0 + float(k) * dy, settings);
+    }
+}
+
+NoiseStats GenerateNoise(std::span<float> out, int rows, int cols, float originX, float originY,
+    float spacingX, float spacingY, const NoiseSettings& settings, unsigned threadCount)
+{
+    if (rows < 0 || cols < 0 || out.size() != size_t(rows) * cols)
+        throw std::runtime_error("GenerateNoise: out precisa ter rows * cols amostras.");
+
+    // Blocos pequenos de linhas distribuidos sob demanda equilibram as threads;
+    // cada amostra so depende da sua posicao, entao a divisao nao muda o resultado.
+    const int blockRows = 16;
+    const auto start = std::chrono::steady_clock::now();
+    const unsigned threads = ParallelForBlocks((rows + blockRows - 1) / blockRows, threadCount, [&](int block) {
+        const int lastRow = std::min(rows, (block + 1) * blockRows);
+        for (int i = block * blockRows; i < lastRow; ++i) {
+            FractalNoiseLine(originX + float(i) * spacingX, originY, spacingY, settings,
+                out.subspan(size_t(i) * cols, size_t(cols)));
+        }
+    });
+
+    NoiseStats stats;
+    stats.Samples = out.size();
+    stats.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.Threads = threads;
+    return stats;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// Ruido simplex 2D (Gustavson) com hash inteiro no lugar da tabela de permutacao,
+// para poder calcular 8 (AVX2) ou 4 (SSE2) pontos de uma vez. O resultado depende
+// so das coordenadas e da semente: o caminho SIMD da o mesmo valor bit a bit do
+// escalar, e gerar com qualquer numero de threads da o mesmo mapa.
+enum class NoiseType
+{
+    Fbm,            // soma de oitavas, em [-1, 1]
+    Ridged,         // oitavas de (1 - |n|)^2: cristas finas, em [0, 1]
+    DomainWarped,   // fBm com as coordenadas deslocadas por outros dois fBm
+};
+
+struct NoiseSettings
+{
+    NoiseType Type = NoiseType::Fbm;
+    uint32_t Seed = 1337;
+    int Octaves = 6;
+    float Frequency = 1.0f / 256.0f;   // da primeira oitava, em ciclos por unidade
+    float Lacunarity = 2.0f;           // multiplica a frequencia a cada oitava
+    float Gain = 0.5f;                 // multiplica a amplitude a cada oitava
+    float WarpStrength = 64.0f;        // deslocamento maximo do DomainWarped, em unidades
+    float Amplitude = 1.0f;            // escala do resultado
+};
+
+struct NoiseStats
+{
+    size_t Samples = 0;
+    double Seconds = 0.0;
+    unsigned Threads = 0;
+
+    double SamplesPerSecond() const { return Seconds > 0.0 ? Samples / Seconds : 0.0; }
+};
+
+// Uma oitava de simplex em (x, y), aproximadamente em [-1, 1].
+float SimplexNoise(float x, float y, uint32_t seed);
+
+// Ruido de 'settings' em (x, y), ja multiplicado por Amplitude.
+float FractalNoise(float x, float y, const NoiseSettings& settings);
+
+// out[k] = FractalNoise(x, y0 + k * dy, settings), varios pontos por vez.
+void FractalNoiseLine(float x, float y0, float dy, const NoiseSettings& settings, std::span<float> out);
+
+// Preenche out[i * cols + j] com o ruido em (originX + i * spacingX, originY + j * spacingY),
+// o layout de Terrain, dividindo as linhas em blocos entre threadCount threads
+// (0 = todos os nucleos).
+NoiseStats GenerateNoise(std::span<float> out, int rows, int cols, float originX, float originY,
+    float spacingX, float spacingY, const NoiseSettings& settings, unsigned threadCount = 0);
@@ -0,0 +1,1113 @@
+#include "pch.h"
+#include "ObjLoader.h"
+#include "MappedFile.h"
+#include "VertexIndexMap.h"
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define OBJ_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+    inline unsigned CountTrailingZeros(unsigned mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    // Procura o proximo '\n' comparando 16 bytes por vez.
+    const char* FindLineEnd(const char* p, const char* end)
+    {
+#if defined(OBJ_USE_SSE2)
+        const __m128i newline = _mm_set1_epi8('\n');
+        while (end - p >= 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+            if (mask != 0) {
+                return p + CountTrailingZeros(static_cast<unsigned>(mask));
+            }
+            p += 16;
+        }
+#endif
+        while (p < end && *p != '\n') ++p;
+        return p;
+    }
+
+    inline bool IsBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    inline const char* SkipBlanks(const char* p, const char* end)
+    {
+        while (p < end && IsBlank(*p)) ++p;
+        return p;
+    }
+
+    inline const char* SkipToken(const char* p, const char* end)
+    {
+        while (p < end && !IsBlank(*p)) ++p;
+        return p;
+    }
+
+    bool ParseFloat(const char*& p, const char* end, float& value)
+    {
+        p = SkipBlanks(p, end);
+        // from_chars nao aceita o sinal '+', que o operator>> aceitava.
+        if (p < end && *p == '+') ++p;
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc()) return false;
+        p = result.ptr;
+        return true;
+    }
+
+    // "v x y z" e "vn x y z" guardados como (x, z, -y), igual ao parser original.
+    DirectX::XMFLOAT3 ParseObjVector(const char* p, const char* end)
+    {
+        float values[3] = {};
+        for (float& value : values) {
+            if (!ParseFloat(p, end, value)) break;
+        }
+        return { values[0], values[2], -values[1] };
+    }
+
+    struct ObjCorner
+    {
+        int v = 0, vt = 0, vn = 0;
+    };
+
+    // Aceita "v", "v/vt", "v//vn" e "v/vt/vn". Indices ausentes ficam em 0.
+    bool ParseCorner(const char*& p, const char* end, ObjCorner& corner)
+    {
+        auto result = std::from_chars(p, end, corner.v);
+        if (result.ec != std::errc()) {
+            p = SkipToken(p, end);
+            return false;
+        }
+        p = result.ptr;
+        if (p < end && *p == '/') {
+            ++p;
+            if (p < end && *p != '/') {
+                result = std::from_chars(p, end, corner.vt);
+                if (result.ec == std::errc()) p = result.ptr;
+            }
+            if (p < end && *p == '/') {
+                ++p;
+                result = std::from_chars(p, end, corner.vn);
+                if (result.ec == std::errc()) p = result.ptr;
+            }
+        }
+        p = SkipToken(p, end);
+        return true;
+    }
+
+    // Indices do OBJ comecam em 1; negativos sao relativos ao fim da lista atual.
+    // Retorna -1 para indices ausentes ou fora do intervalo.
+    inline int ResolveIndex(int index, size_t count)
+    {
+        long long resolved = index > 0 ? index - 1LL : static_cast<long long>(count) + index;
+        if (index == 0 || resolved < 0 || resolved >= static_cast<long long>(count)) return -1;
+        return static_cast<int>(resolved);
+    }
+
+    enum class ObjLine { Other, Position, Normal, Texcoord, Face, Object, Group, UseMaterial, MaterialLibrary };
+
+    // Unica regra de classificacao de linhas; a contagem e o parse precisam
+    // concordar exatamente, ja que o parse grava em arrays pre-dimensionados.
+    inline ObjLine ClassifyObjLine(const char* keyword, const char* args)
+    {
+        const size_t length = args - keyword;
+        if (length == 1) {
+            if (keyword[0] == 'v') return ObjLine::Position;
+            if (keyword[0] == 'f') return ObjLine::Face;
+            if (keyword[0] == 'o') return ObjLine::Object;
+            if (keyword[0] == 'g') return ObjLine::Group;
+        }
+        else if (length == 2 && keyword[0] == 'v') {
+            if (keyword[1] == 'n') return ObjLine::Normal;
+            if (keyword[1] == 't') return ObjLine::Texcoord;
+        }
+        else if (length == 6) {
+            if (std::memcmp(keyword, "usemtl", 6) == 0) return ObjLine::UseMaterial;
+            if (std::memcmp(keyword, "mtllib", 6) == 0) return ObjLine::MaterialLibrary;
+        }
+        return ObjLine::Other;
+    }
+
+    struct ObjElementCounts
+    {
+        size_t positions = 0;
+        size_t normals = 0;
+        size_t texcoords = 0;
+        size_t faces = 0;
+    };
+
+    // Passada rapida que so classifica as linhas, usada para dimensionar
+    // os vetores e a tabela de vertices antes do parse.
+    ObjElementCounts CountObjElements(const char* p, const char* end)
+    {
+        ObjElementCounts counts;
+        while (p < end) {
+            const char* lineEnd = FindLineEnd(p, end);
+            const char* keyword = SkipBlanks(p, lineEnd);
+            switch (ClassifyObjLine(keyword, SkipToken(keyword, lineEnd))) {
+            case ObjLine::Position: counts.positions++; break;
+            case ObjLine::Normal: counts.normals++; break;
+            case ObjLine::Texcoord: counts.texcoords++; break;
+            case ObjLine::Face: counts.faces++; break;
+            default: break;
+            }
+            p = lineEnd + 1;
+        }
+        return counts;
+    }
+
+    // Posicoes ou normais do import em streaming, em paginas de PageElements. Ate
+    // maxResidentBytes ficam na memoria; as outras vao para um arquivo temporario,
+    // criado so na primeira troca, e voltam quando uma face as cita. A troca usa o
+    // algoritmo do relogio (segunda chance), aproximando a LRU de HeightTileCache
+    // sem lista nem mapa por acesso.
+    class ObjAttributePager
+    {
+    public:
+        static constexpr size_t PageElements = size_t(1) << 14;
+        static constexpr size_t PageBytes = PageElements * sizeof(DirectX::XMFLOAT3);
+
+        ObjAttributePager(size_t count, size_t maxResidentBytes)
+            : m_pageSlot((count + PageElements - 1) / PageElements, -1), m_onDisk(m_pageSlot.size(), false)
+        {
+            // Arredonda para cima: com maxResidentBytes do tamanho dos dados, todas as
+            // paginas cabem e o arquivo temporario nunca e criado.
+            m_maxFrames = std::min(std::max<size_t>((maxResidentBytes + PageBytes - 1) / PageBytes, 2), m_pageSlot.size());
+        }
+        ObjAttributePager(const ObjAttributePager& rhs) = delete;
+        ObjAttributePager& operator=(const ObjAttributePager& rhs) = delete;
+
+        ~ObjAttributePager()
+        {
+            if (m_file.is_open()) {
+                m_file.close();
+                std::error_code ec;
+                std::filesystem::remove(m_path, ec);
+            }
+        }
+
+        void Store(size_t index, const DirectX::XMFLOAT3& value)
+        {
+            Frame& frame = Acquire(index / PageElements);
+            frame.Data[index % PageElements] = value;
+            frame.Dirty = true;
+        }
+
+        // A referencia vale ate o proximo acesso a este paginador.
+        const DirectX::XMFLOAT3& Load(size_t index)
+        {
+            return Acquire(index / PageElements).Data[index % PageElements];
+        }
+
+        size_t MaxResidentBytes() const { return m_maxFrames * PageBytes; }
+        size_t SpilledBytes() const { return m_spilledPages * PageBytes; }
+
+    private:
+        struct Frame
+        {
+            std::vector<DirectX::XMFLOAT3> Data;
+            size_t Page = 0;
+            bool Dirty = false;
+            bool Referenced = false;
+        };
+
+        Frame& Acquire(size_t page)
+        {
+            const int32_t slot = m_pageSlot[page];
+            if (slot >= 0) {
+                m_frames[slot].Referenced = true;
+                return m_frames[slot];
+            }
+            return Fault(page);
+        }
+
+        Frame& Fault(size_t page)
+        {
+            size_t slot = m_frames.size();
+            if (slot < m_maxFrames) {
+                m_frames.emplace_back().Data.resize(PageElements);
+            }
+            else {
+                while (m_frames[m_hand].Referenced) {
+                    m_frames[m_hand].Referenced = false;
+                    m_hand = (m_hand + 1) % m_frames.size();
+                }
+                slot = m_hand;
+                m_hand = (m_hand + 1) % m_frames.size();
+                Frame& victim = m_frames[slot];
+                if (victim.Dirty) WritePage(victim);
+                m_pageSlot[victim.Page] = -1;
+            }
+
+            Frame& frame = m_frames[slot];
+            frame.Page = page;
+            frame.Dirty = false;
+            frame.Referenced = true;
+            if (m_onDisk[page]) {
+                m_file.seekg(std::streamoff(page) * std::streamoff(PageBytes));
+                m_file.read(reinterpret_cast<char*>(frame.Data.data()), std::streamsize(PageBytes));
+                if (!m_file) throw std::runtime_error("Falha ao ler o arquivo temporario do import: " + m_path.string());
+            }
+            m_pageSlot[page] = static_cast<int32_t>(slot);
+            return frame;
+        }
+
+        void WritePage(const Frame& frame)
+        {
+            if (!m_file.is_open()) {
+                static std::atomic<unsigned> sequence{ 0 };
+                m_path = std::filesystem::temp_directory_path() / ("xesqe-obj-" +
+                    std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "-" +
+                    std::to_string(sequence++) + ".tmp");
+                m_file.open(m_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+                if (!m_file.is_open()) throw std::runtime_error("Nao foi possivel criar o arquivo temporario do import: " + m_path.string());
+            }
+            m_file.seekp(std::streamoff(frame.Page) * std::streamoff(PageBytes));
+            m_file.write(reinterpret_cast<const char*>(frame.Data.data()), std::streamsize(PageBytes));
+            if (!m_file) throw std::runtime_error("Falha ao gravar o arquivo temporario do import: " + m_path.string());
+            if (!m_onDisk[frame.Page]) {
+                m_onDisk[frame.Page] = true;
+                m_spilledPages++;
+            }
+        }
+
+        std::vector<int32_t> m_pageSlot;   // pagina -> quadro residente, -1 fora da memoria
+        std::vector<bool> m_onDisk;
+        std::vector<Frame> m_frames;
+        size_t m_maxFrames = 0;
+        size_t m_hand = 0;
+        size_t m_spilledPages = 0;
+        std::filesystem::path m_path;
+        std::fstream m_file;
+    };
+
+    inline void StoreObjAttribute(DirectX::XMFLOAT3* out, size_t index, const DirectX::XMFLOAT3& value)
+    {
+        out[index] = value;
+    }
+
+    inline void StoreObjAttribute(ObjAttributePager* out, size_t index, const DirectX::XMFLOAT3& value)
+    {
+        out->Store(index, value);
+    }
+
+    // Resto da linha sem os brancos das pontas (nomes podem ter espacos).
+    std::string ObjLineArgument(const char* args, const char* lineEnd)
+    {
+        const char* begin = SkipBlanks(args, lineEnd);
+        while (lineEnd > begin && IsBlank(lineEnd[-1])) --lineEnd;
+        return std::string(begin, lineEnd);
+    }
+
+    // o, g, usemtl e mtllib de um trecho, na ordem do arquivo.
+    struct ObjPartRefs
+    {
+        struct Ref
+        {
+            size_t IndexStart;      // tamanho de indices na linha
+            ObjLine Kind;           // Object, Group ou UseMaterial
+            std::string Name;
+        };
+        std::vector<Ref> refs;
+        std::vector<std::string> libraries;
+    };
+
+    // Faz o parse de [p, end). 'base' conta o que vem antes desse trecho no
+    // arquivo: posicoes e normais sao gravadas a partir dali e indices relativos
+    // e validacao usam o total visto ate cada face, como numa leitura sequencial.
+    // Cada canto valido passa por resolveCorner, que devolve o indice do vertice;
+    // o, g, usemtl e mtllib vao para 'parts'. Retorna as contagens acumuladas (base + o que havia no trecho).
+    // positions e normals sao arrays ou ObjAttributePager (via StoreObjAttribute).
+    template <typename AttributeOut, typename ResolveCorner>
+    ObjElementCounts ParseObjRange(const char* p, const char* end, const ObjElementCounts& base,
+        AttributeOut* positions, AttributeOut* normals,
+        std::vector<unsigned int>& indices, ObjPartRefs& parts, ResolveCorner&& resolveCorner)
+    {
+        size_t positionCount = base.positions;
+        size_t normalCount = base.normals;
+        size_t texcoordCount = base.texcoords;
+        size_t faceCount = base.faces;
+        std::vector<unsigned int> face;
+
+        while (p < end)
+        {
+            const char* lineEnd = FindLineEnd(p, end);
+            const char* keyword = SkipBlanks(p, lineEnd);
+            const char* args = SkipToken(keyword, lineEnd);
+            const ObjLine kind = ClassifyObjLine(keyword, args);
+
+            switch (kind) {
+            case ObjLine::Position:
+                StoreObjAttribute(positions, positionCount++, ParseObjVector(args, lineEnd));
+                break;
+            case ObjLine::Normal:
+                StoreObjAttribute(normals, normalCount++, ParseObjVector(args, lineEnd));
+                break;
+            case ObjLine::Texcoord:
+                // Coordenadas de textura so participam da chave do vertice.
+                texcoordCount++;
+                break;
+            case ObjLine::Face: {
+                faceCount++;
+                face.clear();
+                const char* c = SkipBlanks(args, lineEnd);
+                while (c < lineEnd) {
+                    ObjCorner corner;
+                    if (ParseCorner(c, lineEnd, corner)) {
+                        int v_idx = ResolveIndex(corner.v, positionCount);
+                        if (v_idx >= 0) {
+                            VertexIndexMap::Key key = { v_idx, ResolveIndex(corner.vt, texcoordCount), ResolveIndex(corner.vn, normalCount) };
+                            face.push_back(resolveCorner(key));
+                        }
+                    }
+                    c = SkipBlanks(c, lineEnd);
+                }
+                for (size_t i = 2; i < face.size(); ++i) {
+                    indices.push_back(face[0]);
+                    indices.push_back(face[i - 1]);
+                    indices.push_back(face[i]);
+                }
+                break;
+            }
+            case ObjLine::Object:
+            case ObjLine::Group:
+            case ObjLine::UseMaterial:
+                parts.refs.push_back({ indices.size(), kind, ObjLineArgument(args, lineEnd) });
+                break;
+            case ObjLine::MaterialLibrary:
+                for (const char* c = SkipBlanks(args, lineEnd); c < lineEnd; c = SkipBlanks(c, lineEnd)) {
+                    const char* nameEnd = SkipToken(c, lineEnd);
+                    parts.libraries.emplace_back(c, nameEnd);
+                    c = nameEnd;
+                }
+                break;
+            default:
+                break;
+            }
+
+            p = lineEnd + 1;
+        }
+
+        ObjElementCounts counts;
+        counts.positions = positionCount;
+        counts.normals = normalCount;
+        counts.texcoords = texcoordCount;
+        counts.faces = faceCount;
+        return counts;
+    }
+
+    // Executa task(0) .. task(taskCount - 1) em threads separadas e repassa a
+    // primeira excecao encontrada.
+    template <typename Task>
+    void RunParallel(size_t taskCount, Task&& task)
+    {
+        std::vector<std::exception_ptr> errors(taskCount);
+        auto run = [&](size_t i) {
+            try { task(i); }
+            catch (...) { errors[i] = std::current_exception(); }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < taskCount; ++i) threads.emplace_back(run, i);
+        if (taskCount > 0) run(0);
+        for (std::thread& thread : threads) thread.join();
+
+        for (const std::exception_ptr& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+    }
+
+    struct ObjChunk
+    {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        ObjElementCounts counts;                // elementos dentro do trecho
+        ObjElementCounts base;                  // elementos antes do trecho
+        std::vector<VertexIndexMap::Key> keys;  // vertices distintos, em ordem de aparicao
+        std::vector<unsigned int> indices;      // triangulos em indices locais (posicao em keys)
+        std::vector<unsigned int> remap;        // indice local -> indice final
+        ObjPartRefs parts;                      // posicoes relativas a indices do trecho
+        size_t indexBase = 0;
+    };
+
+    // Divide [begin, end) em ate chunkCount trechos que sempre terminam logo apos um '\n'.
+    std::vector<ObjChunk> SplitObjChunks(const char* begin, const char* end, size_t chunkCount)
+    {
+        std::vector<ObjChunk> chunks;
+        const size_t size = end - begin;
+        const char* p = begin;
+        for (size_t i = 1; i <= chunkCount && p < end; ++i) {
+            const char* chunkEnd = end;
+            if (i < chunkCount) {
+                chunkEnd = FindLineEnd(std::max(p, begin + size * i / chunkCount), end);
+                if (chunkEnd < end) ++chunkEnd;
+            }
+            ObjChunk chunk;
+            chunk.begin = p;
+            chunk.end = chunkEnd;
+            chunks.push_back(std::move(chunk));
+            p = chunkEnd;
+        }
+        return chunks;
+    }
+
+    Vertex MakeObjVertex(const DirectX::XMFLOAT3& position, const DirectX::XMFLOAT3* normal)
+    {
+        Vertex vertex;
+        vertex.Pos = position;
+        vertex.Normal = normal ? *normal : DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+        return vertex;
+    }
+
+    // Le newmtl, Kd, Pm, Pr e Ns (convertido em rugosidade quando nao ha Pr).
+    // Arquivo ausente nao e erro: os materiais citados ficam com o padrao.
+    void LoadObjMaterialLibrary(const std::string& path, std::map<std::string, Material>& library)
+    {
+        std::ifstream file(path);
+        if (!file.is_open()) return;
+
+        Material* current = nullptr;
+        bool explicitRoughness = false;
+        std::string line;
+        while (std::getline(file, line)) {
+            const char* end = line.data() + line.size();
+            const char* keyword = SkipBlanks(line.data(), end);
+            const char* args = SkipToken(keyword, end);
+            const std::string name(keyword, args);
+
+            if (name == "newmtl") {
+                current = &library[ObjLineArgument(args, end)];
+                *current = Material();
+                current->Metallic = 0.0f;
+                current->AO = 1.0f;
+                explicitRoughness = false;
+                continue;
+            }
+            if (!current) continue;
+
+            float value = 0.0f;
+            const char* c = args;
+            if (name == "Kd") {
+                float rgb[3] = { 1.0f, 1.0f, 1.0f };
+                for (float& channel : rgb) {
+                    if (!ParseFloat(c, end, channel)) break;
+                }
+                current->Albedo = { rgb[0], rgb[1], rgb[2] };
+            }
+            else if (name == "Pm" && ParseFloat(c, end, value)) {
+                current->Metallic = std::min(std::max(value, 0.0f), 1.0f);
+            }
+            else if (name == "Pr" && ParseFloat(c, end, value)) {
+                current->Roughness = std::min(std::max(value, 0.0f), 1.0f);
+                explicitRoughness = true;
+            }
+            else if (name == "Ns" && !explicitRoughness && ParseFloat(c, end, value)) {
+                current->Roughness = std::sqrt(2.0f / (std::max(value, 0.0f) + 2.0f));
+            }
+        }
+    }
+
+    // Transforma o, g e usemtl em SubmeshRun. Cada par (objeto, grupo) e uma
+    // parte, numerada na ordem em que aparece; os materiais vao para 'materials'
+    // na ordem do primeiro uso, e nomes sem definicao nos .mtl (ou o material
+    // antes do primeiro usemtl, nome vazio) ficam com o Material padrao.
+    class ObjRunBuilder
+    {
+    public:
+        ObjRunBuilder(const std::string& objPath, std::vector<Material>& materials)
+            : m_directory(std::filesystem::path(objPath).parent_path()), m_materials(materials)
+        {
+        }
+
+        // Consome parts.refs e parts.libraries. Linhas na mesma posicao de
+        // indices geram um unico trecho, com o estado final delas.
+        void Apply(ObjPartRefs& parts, std::vector<SubmeshRun>& runs)
+        {
+            for (const std::string& name : parts.libraries) LoadObjMaterialLibrary((m_directory / name).string(), m_library);
+            for (size_t i = 0; i < parts.refs.size(); ++i) {
+                const ObjPartRefs::Ref& ref = parts.refs[i];
+                if (ref.Kind == ObjLine::Object) {
+                    m_object = ref.Name;
+                    m_group.clear();
+                }
+                else if (ref.Kind == ObjLine::Group) {
+                    m_group = ref.Name;
+                }
+                else {
+                    m_material = ref.Name;
+                }
+                if (i + 1 == parts.refs.size() || parts.refs[i + 1].IndexStart != ref.IndexStart) {
+                    Emit(ref.IndexStart, runs);
+                }
+            }
+            parts.refs.clear();
+            parts.libraries.clear();
+        }
+
+        // Trecho com o estado atual a partir de indexStart (substitui um trecho vazio no mesmo ponto).
+        void Emit(size_t indexStart, std::vector<SubmeshRun>& runs)
+        {
+            auto material = m_materialIndex.find(m_material);
+            if (material == m_materialIndex.end()) {
+                material = m_materialIndex.emplace(m_material, static_cast<unsigned int>(m_materials.size())).first;
+                auto found = m_library.find(m_material);
+                m_materials.push_back(found != m_library.end() ? found->second : Material());
+            }
+            auto part = m_partIndex.emplace(std::make_pair(m_object, m_group), static_cast<unsigned int>(m_partIndex.size())).first;
+
+            SubmeshRun run;
+            run.IndexStart = indexStart;
+            run.Material = material->second;
+            run.Part = part->second;
+            if (!runs.empty() && runs.back().IndexStart == indexStart) runs.back() = run;
+            else runs.push_back(run);
+        }
+
+    private:
+        std::filesystem::path m_directory;
+        std::vector<Material>& m_materials;
+        std::map<std::string, Material> m_library;
+        std::map<std::string, unsigned int> m_materialIndex;
+        std::map<std::pair<std::string, std::string>, unsigned int> m_partIndex;
+        std::string m_object;
+        std::string m_group;
+        std::string m_material;
+    };
+
+    // Monta model.materials e uma Submesh por (parte, material). Sem o, g nem
+    // usemtl o modelo fica com uma faixa so.
+    void ApplyObjParts(Model& model, const std::string& objPath, ObjPartRefs& parts)
+    {
+        if (parts.refs.empty()) return;
+
+        ObjRunBuilder builder(objPath, model.materials);
+        std::vector<SubmeshRun> runs;
+        if (parts.refs.front().IndexStart > 0) builder.Emit(0, runs);
+        builder.Apply(parts, runs);
+        BuildSubmeshes(model, runs);
+    }
+
+    bool SameModel(const Model& a, const Model& b)
+    {
+        return a.vertices.size() == b.vertices.size() &&
+            a.indices == b.indices &&
+            (a.vertices.empty() || std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(Vertex)) == 0);
+    }
+
+    double ToMBps(size_t bytes, double seconds)
+    {
+        return seconds > 0.0 ? (bytes / (1024.0 * 1024.0)) / seconds : 0.0;
+    }
+
+    // Le o arquivo com ifstream em janelas de buffer.size() bytes e chama
+    // visit(begin, end) com trechos que terminam em fim de linha; o resto da
+    // ultima linha passa para a janela seguinte. Uma linha maior que a janela
+    // dobra o buffer. Retorna o total de bytes lidos.
+    template <typename Visit>
+    size_t ForEachObjWindow(const std::string& path, std::vector<char>& buffer, Visit&& visit)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Nao foi possivel abrir o arquivo do modelo: " + path);
+        }
+
+        size_t total = 0;
+        size_t carry = 0;
+        for (;;) {
+            file.read(buffer.data() + carry, static_cast<std::streamsize>(buffer.size() - carry));
+            const size_t got = static_cast<size_t>(file.gcount());
+            const bool atEnd = !file;
+            total += got;
+
+            const char* begin = buffer.data();
+            const char* end = begin + carry + got;
+            const char* cut = end;
+            if (!atEnd) {
+                while (cut > begin && cut[-1] != '\n') --cut;
+                if (cut == begin) {
+                    carry = end - begin;
+                    buffer.resize(buffer.size() * 2);
+                    continue;
+                }
+            }
+
+            if (cut > begin) visit(begin, cut);
+            if (atEnd) break;
+            carry = end - cut;
+            std::memmove(buffer.data(), cut, carry);
+        }
+        return total;
+    }
+}
+
+Model load_model_from_obj(const std::string& path)
+{
+    MappedFile file(path);
+
+    // Cada (v, vt, vn) distinto vira um vertice; na pratica o total fica
+    // perto da maior das tres listas, entao essa e a estimativa inicial.
+    const ObjElementCounts counts = CountObjElements(file.Data(), file.End());
+    const size_t expectedVertices = std::max({ counts.positions, counts.normals, counts.texcoords });
+
+    Model model;
+    model.vertices.reserve(expectedVertices);
+    model.indices.reserve(counts.faces * 3);
+    std::vector<DirectX::XMFLOAT3> positions(counts.positions);
+    std::vector<DirectX::XMFLOAT3> normals(counts.normals);
+    VertexIndexMap index_map(expectedVertices);
+    ObjPartRefs parts;
+
+    ParseObjRange(file.Data(), file.End(), ObjElementCounts(), positions.data(), normals.data(), model.indices, parts,
+        [&](const VertexIndexMap::Key& key) {
+            bool inserted = false;
+            unsigned int index = index_map.FindOrInsert(key, static_cast<unsigned int>(model.vertices.size()), inserted);
+            if (inserted) {
+                model.vertices.push_back(MakeObjVertex(positions[key.v], key.vn >= 0 ? &normals[key.vn] : nullptr));
+            }
+            return index;
+        });
+
+    ApplyObjParts(model, path, parts);
+    return model;
+}
+
+Model load_model_from_obj_parallel(const std::string& path, unsigned threadCount)
+{
+    // Trechos menores que isso nao pagam o custo de criar as threads.
+    const size_t minChunkBytes = 1 << 20;
+
+    MappedFile file(path);
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const size_t chunkCount = std::min<size_t>(threadCount, file.Size() / minChunkBytes);
+    if (chunkCount <= 1) {
+        return load_model_from_obj(path);
+    }
+
+    std::vector<ObjChunk> chunks = SplitObjChunks(file.Data(), file.End(), chunkCount);
+
+    // 1. Contagem por trecho: define onde cada um grava posicoes e normais.
+    RunParallel(chunks.size(), [&](size_t i) {
+        chunks[i].counts = CountObjElements(chunks[i].begin, chunks[i].end);
+    });
+
+    ObjElementCounts totals;
+    for (ObjChunk& chunk : chunks) {
+        chunk.base = totals;
+        totals.positions += chunk.counts.positions;
+        totals.normals += chunk.counts.normals;
+        totals.texcoords += chunk.counts.texcoords;
+        totals.faces += chunk.counts.faces;
+    }
+
+    std::vector<DirectX::XMFLOAT3> positions(totals.positions);
+    std::vector<DirectX::XMFLOAT3> normals(totals.normals);
+
+    // 2. Parse de cada trecho com deduplicacao local.
+    RunParallel(chunks.size(), [&](size_t i) {
+        ObjChunk& chunk = chunks[i];
+        VertexIndexMap localMap(std::max({ chunk.counts.positions, chunk.counts.normals, chunk.counts.texcoords }));
+        chunk.indices.reserve(chunk.counts.faces * 3);
+        ParseObjRange(chunk.begin, chunk.end, chunk.base, positions.data(), normals.data(), chunk.indices, chunk.parts,
+            [&](const VertexIndexMap::Key& key) {
+                bool inserted = false;
+                unsigned int index = localMap.FindOrInsert(key, static_cast<unsigned int>(chunk.keys.size()), inserted);
+                if (inserted) chunk.keys.push_back(key);
+                return index;
+            });
+    });
+
+    // 3. Merge sequencial. Percorrer os trechos em ordem, e dentro de cada um
+    // as chaves em ordem de aparicao, numera os vertices exatamente como o
+    // parser sequencial.
+    const size_t expectedVertices = std::max({ totals.positions, totals.normals, totals.texcoords });
+    std::vector<VertexIndexMap::Key> vertexKeys;
+    vertexKeys.reserve(expectedVertices);
+    VertexIndexMap index_map(expectedVertices);
+    size_t indexCount = 0;
+    ObjPartRefs parts;
+    for (ObjChunk& chunk : chunks) {
+        chunk.remap.resize(chunk.keys.size());
+        for (size_t k = 0; k < chunk.keys.size(); ++k) {
+            bool inserted = false;
+            chunk.remap[k] = index_map.FindOrInsert(chunk.keys[k], static_cast<unsigned int>(vertexKeys.size()), inserted);
+            if (inserted) vertexKeys.push_back(chunk.keys[k]);
+        }
+        chunk.indexBase = indexCount;
+        indexCount += chunk.indices.size();
+        for (ObjPartRefs::Ref& ref : chunk.parts.refs) {
+            ref.IndexStart += chunk.indexBase;
+            parts.refs.push_back(std::move(ref));
+        }
+        parts.libraries.insert(parts.libraries.end(), chunk.parts.libraries.begin(), chunk.parts.libraries.end());
+    }
+
+    // 4. Vertices e indices finais montados em paralelo.
+    Model model;
+    model.vertices.resize(vertexKeys.size());
+    model.indices.resize(indexCount);
+    RunParallel(chunks.size(), [&](size_t i) {
+        const size_t first = vertexKeys.size() * i / chunks.size();
+        const size_t last = vertexKeys.size() * (i + 1) / chunks.size();
+        for (size_t v = first; v < last; ++v) {
+            const VertexIndexMap::Key& key = vertexKeys[v];
+            model.vertices[v] = MakeObjVertex(positions[key.v], key.vn >= 0 ? &normals[key.vn] : nullptr);
+        }
+
+        const ObjChunk& chunk = chunks[i];
+        unsigned int* out = model.indices.data() + chunk.indexBase;
+        for (unsigned int local : chunk.indices) {
+            *out++ = chunk.remap[local];
+        }
+    });
+
+    ApplyObjParts(model, path, parts);
+    return model;
+}
+
+Model load_model_from_obj_stream(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        throw std::runtime_error("Nao foi possivel abrir o arquivo do modelo: " + path);
+    }
+
+    Model model;
+    std::vector<DirectX::XMFLOAT3> temp_positions;
+    std::vector<DirectX::XMFLOAT3> temp_normals;
+    std::vector<DirectX::XMFLOAT2> temp_texcoords;
+    std::map<std::tuple<int, int, int>, unsigned int> index_map;
+    ObjPartRefs parts;
+
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::stringstream ss(line);
+        std::string prefix;
+        ss >> prefix;
+
+        if (prefix == "v") {
+            DirectX::XMFLOAT3 position;
+            ss >> position.x >> position.z >> position.y;
+            position.z = -position.z;
+            temp_positions.push_back(position);
+        }
+        else if (prefix == "vn") {
+            DirectX::XMFLOAT3 normal;
+            ss >> normal.x >> normal.z >> normal.y;
+            normal.z = -normal.z;
+            temp_normals.push_back(normal);
+        }
+        else if (prefix == "vt") {
+            DirectX::XMFLOAT2 uv;
+            ss >> uv.x >> uv.y;
+            temp_texcoords.push_back(uv);
+        }
+        else if (prefix == "f") {
+            std::string vertex_data;
+            std::vector<unsigned int> temp_face_indices;
+            while (ss >> vertex_data) {
+                std::stringstream vertex_ss(vertex_data);
+                int v_idx = 0, vt_idx = 0, vn_idx = 0;
+                char slash;
+                vertex_ss >> v_idx >> slash >> vt_idx >> slash >> vn_idx;
+                if (v_idx == 0) {
+                    vertex_ss.clear();
+                    vertex_ss.seekg(0);
+                    vertex_ss >> v_idx;
+                }
+                v_idx--; vt_idx--; vn_idx--;
+                std::tuple<int, int, int> key = { v_idx, vt_idx, vn_idx };
+                if (index_map.count(key)) {
+                    temp_face_indices.push_back(index_map[key]);
+                }
+                else {
+                    if (v_idx < 0 || v_idx >= temp_positions.size()) continue;
+                    Vertex new_vertex;
+                    new_vertex.Pos = temp_positions[v_idx];
+                    if (vn_idx >= 0 && vn_idx < temp_normals.size()) {
+                        new_vertex.Normal = temp_normals[vn_idx];
+                    }
+                    else {
+                        new_vertex.Normal = { 0.0f, 1.0f, 0.0f };
+                    }
+                    unsigned int new_index = static_cast<unsigned int>(model.vertices.size());
+                    model.vertices.push_back(new_vertex);
+                    index_map[key] = new_index;
+                    temp_face_indices.push_back(new_index);
+                }
+            }
+            for (size_t i = 0; i + 2 < temp_face_indices.size(); ++i) {
+                model.indices.push_back(temp_face_indices[0]);
+                model.indices.push_back(temp_face_indices[i + 1]);
+                model.indices.push_back(temp_face_indices[i + 2]);
+            }
+        }
+        else if (prefix == "usemtl" || prefix == "o" || prefix == "g") {
+            std::string name;
+            std::getline(ss >> std::ws, name);
+            while (!name.empty() && std::isspace(static_cast<unsigned char>(name.back()))) name.pop_back();
+            const ObjLine kind = prefix == "o" ? ObjLine::Object : prefix == "g" ? ObjLine::Group : ObjLine::UseMaterial;
+            parts.refs.push_back({ model.indices.size(), kind, name });
+        }
+        else if (prefix == "mtllib") {
+            std::string name;
+            while (ss >> name) parts.libraries.push_back(name);
+        }
+    }
+    file.close();
+    ApplyObjParts(model, path, parts);
+    return model;
+}
+
+ObjStreamStats load_model_from_obj_streaming(const std::string& path, const ObjBlockSink& sink, const ObjStreamOptions& options)
+{
+    // Custo por vertice do bloco: o Vertex, o slot da tabela (carga maxima de
+    // 0.7 com capacidade potencia de 2) e uns 6 indices, o tipico de malha fechada.
+    const size_t bytesPerBlockVertex = sizeof(Vertex) + 48 + 6 * sizeof(unsigned int);
+    const size_t minBlockVertices = 4096;
+    // Abaixo disso de espaco livre no bloco, emite o bloco em vez de fatiar mais a janela.
+    const size_t minSliceBytes = 4096;
+
+    const size_t budget = options.MemoryBudget;
+    std::vector<char> buffer(std::min<size_t>(std::max<size_t>(budget / 16, 64 << 10), 64 << 20));
+
+    ObjStreamStats stats;
+
+    // 1. Contagem: so para dimensionar posicoes e normais.
+    ObjElementCounts totals;
+    stats.FileBytes = ForEachObjWindow(path, buffer, [&](const char* begin, const char* end) {
+        const ObjElementCounts counts = CountObjElements(begin, end);
+        totals.positions += counts.positions;
+        totals.normals += counts.normals;
+        totals.texcoords += counts.texcoords;
+        totals.faces += counts.faces;
+    });
+
+    // Posicoes e normais ficam todas na memoria se couberem na metade do orcamento;
+    // senao vao para arquivos temporarios e um quarto do orcamento fica para as paginas.
+    const size_t attributeBytes = (totals.positions + totals.normals) * sizeof(DirectX::XMFLOAT3);
+    const size_t attributeBudget = attributeBytes <= budget / 2 ? attributeBytes : budget / 4;
+    const size_t positionBudget = attributeBytes > 0 ? size_t(double(attributeBudget) * totals.positions / (totals.positions + totals.normals)) : 0;
+    ObjAttributePager positions(totals.positions, attributeBytes <= budget / 2 ? totals.positions * sizeof(DirectX::XMFLOAT3) : positionBudget);
+    ObjAttributePager normals(totals.normals, attributeBytes <= budget / 2 ? totals.normals * sizeof(DirectX::XMFLOAT3) : attributeBudget - positionBudget);
+    stats.AttributeBytes = positions.MaxResidentBytes() + normals.MaxResidentBytes();
+
+    const size_t fixedBytes = stats.AttributeBytes + buffer.size();
+    size_t blockVertices = budget > fixedBytes ? (budget - fixedBytes) / bytesPerBlockVertex : 0;
+    if (blockVertices < minBlockVertices) {
+        throw std::runtime_error("Orcamento de memoria pequeno demais para o import de " + path);
+    }
+    // Cada vertice novo vem de um canto de face, com ao menos 2 bytes ("1 "): um
+    // arquivo pequeno nao precisa de um bloco do tamanho do orcamento.
+    blockVertices = std::min(blockVertices, std::max(stats.FileBytes / 2, minBlockVertices));
+    const size_t blockIndices = blockVertices * 6;
+
+    // A reserva so ocupa memoria quando e escrita; a tabela cresce conforme o uso.
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    vertices.reserve(blockVertices);
+    indices.reserve(blockIndices);
+    VertexIndexMap index_map;
+
+    // Tabela de materiais crescendo conforme os usemtl aparecem; 0 e o padrao.
+    std::vector<Material> materials;
+    ObjRunBuilder builder(path, materials);
+    std::vector<SubmeshRun> runs;
+    builder.Emit(0, runs);
+    ObjPartRefs refs;
+
+    auto trackPeak = [&]() {
+        const size_t bytes = stats.AttributeBytes + buffer.capacity() + vertices.capacity() * sizeof(Vertex) +
+            indices.capacity() * sizeof(unsigned int) + index_map.MemoryBytes();
+        stats.PeakBytes = std::max(stats.PeakBytes, bytes);
+    };
+
+    auto flush = [&]() {
+        trackPeak();
+        if (indices.empty()) return;
+        ObjStreamBlock block;
+        block.Vertices = vertices.data();
+        block.VertexCount = vertices.size();
+        block.Indices = indices.data();
+        block.IndexCount = indices.size();
+        block.BaseVertex = stats.VertexCount;
+        block.IndexStart = stats.IndexCount;
+        block.Runs = runs.data();
+        block.RunCount = runs.size();
+        block.Materials = materials.data();
+        block.MaterialCount = materials.size();
+        sink(block);
+
+        stats.Blocks++;
+        stats.VertexCount += vertices.size();
+        stats.IndexCount += indices.size();
+        vertices.clear();
+        indices.clear();
+        index_map.Clear();
+        runs.back().IndexStart = 0;
+        runs.erase(runs.begin(), runs.end() - 1);
+    };
+
+    auto resolveCorner = [&](const VertexIndexMap::Key& key) {
+        bool inserted = false;
+        unsigned int index = index_map.FindOrInsert(key, static_cast<unsigned int>(vertices.size()), inserted);
+        if (inserted) {
+            vertices.push_back(MakeObjVertex(positions.Load(key.v), key.vn >= 0 ? &normals.Load(key.vn) : nullptr));
+        }
+        return index;
+    };
+
+    // 2. Parse. Cada canto ocupa ao menos 2 bytes ("1 ") e cada face gera no
+    // maximo 1.5 indice por byte, entao fatias desse tamanho nunca estouram o
+    // espaco livre do bloco (a fatia so passa do limite ate o fim da linha).
+    ObjElementCounts seen;
+    ForEachObjWindow(path, buffer, [&](const char* p, const char* end) {
+        while (p < end) {
+            const size_t freeVertices = blockVertices - std::min(blockVertices, vertices.size());
+            const size_t freeIndices = blockIndices - std::min(blockIndices, indices.size());
+            const size_t sliceBytes = std::min(freeVertices * 2, freeIndices * 2 / 3);
+            if (sliceBytes < minSliceBytes) {
+                flush();
+                continue;
+            }
+
+            const char* sliceEnd = end;
+            if (static_cast<size_t>(end - p) > sliceBytes) {
+                sliceEnd = FindLineEnd(p + sliceBytes, end);
+                if (sliceEnd < end) ++sliceEnd;
+            }
+            seen = ParseObjRange(p, sliceEnd, seen, &positions, &normals, indices, refs, resolveCorner);
+            builder.Apply(refs, runs);
+            p = sliceEnd;
+        }
+    });
+    flush();
+
+    stats.SpilledBytes = positions.SpilledBytes() + normals.SpilledBytes();
+    return stats;
+}
+
+Model load_model_from_obj_blocks(const std::string& path, const ObjStreamOptions& options, ObjStreamStats* stats)
+{
+    Model model;
+    ObjStreamStats result = load_model_from_obj_streaming(path, [&](const ObjStreamBlock& block) {
+        for (size_t r = 0; r < block.RunCount; ++r) {
+            const size_t begin = block.Runs[r].IndexStart;
+            const size_t end = r + 1 < block.RunCount ? block.Runs[r + 1].IndexStart : block.IndexCount;
+            if (end == begin) continue;
+            Submesh part;
+            part.IndexStart = static_cast<unsigned int>(block.IndexStart + begin);
+            part.IndexCount = static_cast<unsigned int>(end - begin);
+            part.BaseVertex = static_cast<unsigned int>(block.BaseVertex);
+            part.VertexCount = static_cast<unsigned int>(block.VertexCount);
+            part.Material = block.Runs[r].Material;
+            model.submeshes.push_back(part);
+        }
+        model.materials.assign(block.Materials, block.Materials + block.MaterialCount);
+        model.vertices.insert(model.vertices.end(), block.Vertices, block.Vertices + block.VertexCount);
+        model.indices.insert(model.indices.end(), block.Indices, block.Indices + block.IndexCount);
+    }, options);
+    ComputeSubmeshBounds(model);
+
+    if (stats) *stats = result;
+    return model;
+}
+
+double ObjBenchmarkResult::StreamMBps() const
+{
+    return ToMBps(FileBytes, StreamSeconds);
+}
+
+double ObjBenchmarkResult::MappedMBps() const
+{
+    return ToMBps(FileBytes, MappedSeconds);
+}
+
+double ObjBenchmarkResult::ParallelMBps() const
+{
+    return ToMBps(FileBytes, ParallelSeconds);
+}
+
+std::string ObjBenchmarkResult::ToString() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << Path << " (" << FileBytes / (1024.0 * 1024.0) << " MB, melhor de " << Iterations << ")\n";
+    ss << "stream: " << StreamSeconds * 1000.0 << " ms, " << StreamMBps() << " MB/s\n";
+    ss << "mapped: " << MappedSeconds * 1000.0 << " ms, " << MappedMBps() << " MB/s\n";
+    ss << "parallel: " << ParallelSeconds * 1000.0 << " ms, " << ParallelMBps() << " MB/s ("
+        << (ParallelMatches ? "igual ao mapped" : "DIFERENTE do mapped") << ")\n";
+    ss << "speedup: " << (MappedSeconds > 0.0 ? StreamSeconds / MappedSeconds : 0.0) << "x, "
+        << (ParallelSeconds > 0.0 ? StreamSeconds / ParallelSeconds : 0.0) << "x\n";
+    ss << VertexCount << " vertices, " << IndexCount << " indices, saidas "
+        << (OutputsMatch ? "identicas" : "diferentes") << "\n";
+    return ss.str();
+}
+
+ObjBenchmarkResult BenchmarkObjParsers(const std::string& path, int iterations)
+{
+    using Clock = std::chrono::steady_clock;
+
+    ObjBenchmarkResult result;
+    result.Path = path;
+    result.Iterations = std::max(iterations, 1);
+    result.FileBytes = MappedFile(path).Size();
+    result.StreamSeconds = std::numeric_limits<double>::max();
+    result.MappedSeconds = std::numeric_limits<double>::max();
+    result.ParallelSeconds = std::numeric_limits<double>::max();
+
+    Model streamModel;
+    Model mappedModel;
+    Model parallelModel;
+    for (int i = 0; i < result.Iterations; ++i)
+    {
+        auto t0 = Clock::now();
+        streamModel = load_model_from_obj_stream(path);
+        auto t1 = Clock::now();
+        mappedModel = load_model_from_obj(path);
+        auto t2 = Clock::now();
+        parallelModel = load_model_from_obj_parallel(path);
+        auto t3 = Clock::now();
+
+        result.StreamSeconds = std::min(result.StreamSeconds, std::chrono::duration<double>(t1 - t0).count());
+        result.MappedSeconds = std::min(result.MappedSeconds, std::chrono::duration<double>(t2 - t1).count());
+        result.ParallelSeconds = std::min(result.ParallelSeconds, std::chrono::duration<double>(t3 - t2).count());
+    }
+
+    result.VertexCount = mappedModel.vertices.size();
+    result.IndexCount = mappedModel.indices.size();
+    result.OutputsMatch = SameModel(streamModel, mappedModel);
+    result.ParallelMatches = SameModel(mappedModel, parallelModel);
+    return result;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include "Mesh.h"
+#include <functional>
+#include <string>
+
+// Carrega um .obj mapeando o arquivo na memoria e fazendo o parse direto nos bytes.
+// Aplica a mesma troca de eixos (Y/Z) e inversao de Z do parser original.
+// Com o, g ou usemtl no arquivo, gera uma Submesh por (objeto/grupo, material),
+// com o AABB de cada uma, para desenhar e descartar as partes separadamente.
+Model load_model_from_obj(const std::string& path);
+
+// Variante multi-thread: divide o arquivo em trechos alinhados em linhas, faz o
+// parse de cada trecho em paralelo e junta os resultados de forma deterministica.
+// A saida e identica a de load_model_from_obj. threadCount == 0 usa todos os nucleos.
+Model load_model_from_obj_parallel(const std::string& path, unsigned threadCount = 0);
+
+// Parser original baseado em std::stringstream; mantido como referencia
+// para comparar saida e desempenho com load_model_from_obj.
+Model load_model_from_obj_stream(const std::string& path);
+
+// Bloco de saida do import em streaming. Os indices sao relativos ao inicio do
+// bloco (como uma Submesh com BaseVertex); os ponteiros so valem durante a chamada.
+struct ObjStreamBlock
+{
+    const Vertex* Vertices = nullptr;
+    size_t VertexCount = 0;
+    const unsigned int* Indices = nullptr;
+    size_t IndexCount = 0;
+    size_t BaseVertex = 0;    // vertices emitidos antes deste bloco
+    size_t IndexStart = 0;    // indices emitidos antes deste bloco
+    // Trechos de parte (o/g) e material do bloco (IndexStart relativo ao bloco;
+    // o primeiro em 0) e a tabela de materiais vista ate aqui. O indice 0 e o
+    // Material padrao, usado pelas faces antes do primeiro usemtl.
+    const SubmeshRun* Runs = nullptr;
+    size_t RunCount = 0;
+    const Material* Materials = nullptr;
+    size_t MaterialCount = 0;
+};
+
+using ObjBlockSink = std::function<void(const ObjStreamBlock&)>;
+
+struct ObjStreamOptions
+{
+    // Teto para o que o import mantem na memoria: janela de leitura, bloco de
+    // saida, tabela de deduplicacao e as paginas residentes de posicoes e normais.
+    size_t MemoryBudget = size_t(256) << 20;
+};
+
+struct ObjStreamStats
+{
+    size_t FileBytes = 0;
+    size_t Blocks = 0;
+    size_t VertexCount = 0;
+    size_t IndexCount = 0;
+    size_t AttributeBytes = 0;    // posicoes e normais residentes (no maximo)
+    size_t SpilledBytes = 0;      // posicoes e normais gravadas no arquivo temporario
+    size_t PeakBytes = 0;         // maior soma de buffers do import vista
+};
+
+// Import em streaming: le o arquivo em janelas de tamanho fixo (duas passadas,
+// uma de contagem e outra de parse) e entrega vertices e indices prontos em
+// blocos para 'sink'. A deduplicacao vale dentro de cada bloco, entao vertices
+// usados por blocos diferentes saem repetidos; os triangulos sao os mesmos de
+// load_model_from_obj. As faces podem citar qualquer posicao ou normal anterior:
+// se elas passarem da metade do orcamento, vao para arquivos temporarios e voltam
+// em paginas sob demanda, com um quarto do orcamento residente. A memoria fica
+// limitada pelo orcamento qualquer que seja o tamanho do arquivo; so a janela de
+// leitura cresce se uma linha nao couber nela.
+ObjStreamStats load_model_from_obj_streaming(const std::string& path, const ObjBlockSink& sink,
+    const ObjStreamOptions& options = ObjStreamOptions());
+
+// Junta os blocos do import em streaming num Model, uma Submesh (com AABB) por
+// trecho de cada bloco.
+Model load_model_from_obj_blocks(const std::string& path, const ObjStreamOptions& options = ObjStreamOptions(),
+    ObjStreamStats* stats = nullptr);
+
+struct ObjBenchmarkResult
+{
+    std::string Path;
+    size_t FileBytes = 0;
+    int Iterations = 0;
+    double StreamSeconds = 0.0;
+    double MappedSeconds = 0.0;
+    double ParallelSeconds = 0.0;
+    size_t VertexCount = 0;
+    size_t IndexCount = 0;
+    bool OutputsMatch = false;
+    bool ParallelMatches = false;
+
+    double StreamMBps() const;
+    double MappedMBps() const;
+    double ParallelMBps() const;
+    std::string ToString() const;
+};
+
+// Executa os tres parsers sobre o mesmo arquivo e guarda o melhor tempo de cada um.
+ObjBenchmarkResult BenchmarkObjParsers(const std::string& path, int iterations = 3);
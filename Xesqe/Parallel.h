@@ -0,0 +1,34 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+// Executa body(bloco) para cada bloco em [0, blockCount), entregando os blocos sob
+// demanda a threadCount threads (0 = todos os nucleos; a thread que chama e uma
+// delas). Repassa a primeira excecao e devolve quantas threads usou.
+template <typename Body>
+unsigned ParallelForBlocks(int blockCount, unsigned threadCount, Body&& body)
+{
+    if (threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = unsigned(std::clamp(blockCount, 1, int(threadCount)));
+
+    std::atomic<int> nextBlock = 0;
+    std::vector<std::exception_ptr> errors(threadCount);
+    auto run = [&](unsigned worker) {
+        try {
+            for (int block = nextBlock++; block < blockCount; block = nextBlock++) body(block);
+        }
+        catch (...) { errors[worker] = std::current_exception(); }
+    };
+
+    std::vector<std::thread> threads;
+    for (unsigned worker = 1; worker < threadCount; ++worker) threads.emplace_back(run, worker);
+    run(0);
+    for (std::thread& thread : threads) thread.join();
+    for (const std::exception_ptr& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+    return threadCount;
+}
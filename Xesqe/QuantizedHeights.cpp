@@ -0,0 +1,261 @@
+#include "pch.h"
+#include "QuantizedHeights.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#define HEIGHTS_USE_AVX2 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define HEIGHTS_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    struct QuantizedHeightsHeader
+    {
+        char Magic[4] = { 'X', 'H', 'Q', '1' };
+        uint32_t Rows = 0;
+        uint32_t Cols = 0;
+        uint32_t TileSize = 0;
+    };
+}
+
+QuantizedHeights::QuantizedHeights(std::span<const float> heights, int rows, int cols, int tileSize)
+{
+    if (heights.size() != size_t(rows) * cols)
+        throw std::runtime_error("QuantizedHeights: heights precisa ter rows * cols alturas.");
+    Allocate(rows, cols, tileSize);
+    for (int ti = 0; ti < m_tilesX; ++ti) {
+        for (int tj = 0; tj < m_tilesZ; ++tj) {
+            EncodeTile(ti, tj, heights.data() + (size_t(ti) * m_cols + tj) * TileSize(), size_t(m_cols));
+        }
+    }
+}
+
+QuantizedHeights::QuantizedHeights(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Nao foi possivel abrir o arquivo: " + path);
+    }
+    QuantizedHeightsHeader header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.Magic, "XHQ1", 4) != 0 || header.Rows == 0 || header.Cols == 0 ||
+        header.Rows > INT32_MAX || header.Cols > INT32_MAX || header.TileSize == 0 || header.TileSize > 65536) {
+        throw std::runtime_error("Arquivo de alturas quantizadas invalido: " + path);
+    }
+
+    Allocate(int(header.Rows), int(header.Cols), int(header.TileSize));
+    in.read(reinterpret_cast<char*>(m_tileMin.data()), m_tileMin.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(m_tileScale.data()), m_tileScale.size() * sizeof(float));
+    in.read(reinterpret_cast<char*>(m_codes.data()), size_t(m_rows) * m_cols * sizeof(uint16_t));
+    if (!in) {
+        throw std::runtime_error("Arquivo de alturas quantizadas truncado: " + path);
+    }
+    // O erro passa a contar a partir das alturas do arquivo.
+    for (size_t tile = 0; tile < m_tileError.size(); ++tile) m_tileError[tile] = 0.5f * m_tileScale[tile];
+}
+
+void QuantizedHeights::Save(const std::string& path) const
+{
+    QuantizedHeightsHeader header;
+    header.Rows = uint32_t(m_rows);
+    header.Cols = uint32_t(m_cols);
+    header.TileSize = uint32_t(TileSize());
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw std::runtime_error("Nao foi possivel criar o arquivo: " + path);
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(m_tileMin.data()), m_tileMin.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(m_tileScale.data()), m_tileScale.size() * sizeof(float));
+    out.write(reinterpret_cast<const char*>(m_codes.data()), size_t(m_rows) * m_cols * sizeof(uint16_t));
+    if (!out) {
+        throw std::runtime_error("Falha ao gravar o arquivo: " + path);
+    }
+}
+
+void QuantizedHeights::Allocate(int rows, int cols, int tileSize)
+{
+    if (rows < 1 || cols < 1)
+        throw std::runtime_error("QuantizedHeights: o mapa precisa de pelo menos uma amostra.");
+    if (tileSize < 1 || (tileSize & (tileSize - 1)) != 0)
+        throw std::runtime_error("QuantizedHeights: tileSize precisa ser potencia de 2.");
+
+    m_rows = rows;
+    m_cols = cols;
+    m_tileShift = 0;
+    while ((1 << m_tileShift) < tileSize) ++m_tileShift;
+    m_tilesX = (rows + tileSize - 1) / tileSize;
+    m_tilesZ = (cols + tileSize - 1) / tileSize;
+    m_codes.assign(size_t(rows) * cols + 1, 0);
+    m_tileMin.assign(size_t(m_tilesX) * m_tilesZ, 0.0f);
+    m_tileScale.assign(m_tileMin.size(), 0.0f);
+    m_tileError.assign(m_tileMin.size(), 0.0f);
+}
+
+void QuantizedHeights::EncodeTile(int ti, int tj, const float* block, size_t stride)
+{
+    const int i0 = ti << m_tileShift;
+    const int j0 = tj << m_tileShift;
+    const int rows = std::min(TileSize(), m_rows - i0);
+    const int cols = std::min(TileSize(), m_cols - j0);
+
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    for (int li = 0; li < rows; ++li) {
+        for (int lj = 0; lj < cols; ++lj) {
+            minY = std::min(minY, block[li * stride + lj]);
+            maxY = std::max(maxY, block[li * stride + lj]);
+        }
+    }
+
+    // Bloco plano: escala 0, todos os codigos 0 e a altura sai exata.
+    const float scale = (maxY - minY) / 65535.0f;
+    const size_t tile = size_t(ti) * m_tilesZ + tj;
+    m_tileMin[tile] = minY;
+    m_tileScale[tile] = scale;
+    m_tileError[tile] = 0.5f * scale;
+    EncodeRange(i0, j0, i0 + rows, j0 + cols, block, stride, minY, scale);
+}
+
+void QuantizedHeights::EncodeRange(int i0, int j0, int i1, int j1, const float* values, size_t stride, float minY, float scale)
+{
+    for (int i = i0; i < i1; ++i) {
+        const float* row = values + (i - i0) * stride;
+        uint16_t* codes = m_codes.data() + size_t(i) * m_cols;
+        for (int j = j0; j < j1; ++j) {
+            const float code = scale > 0.0f ? std::nearbyint((row[j - j0] - minY) / scale) : 0.0f;
+            codes[j] = uint16_t(std::clamp(code, 0.0f, 65535.0f));
+        }
+    }
+}
+
+void QuantizedHeights::DecodeRow(int i, int beginJ, int endJ, float* out) const
+{
+    const uint16_t* codes = m_codes.data() + size_t(i) * m_cols;
+    const size_t tileRow = size_t(i >> m_tileShift) * m_tilesZ;
+    out -= beginJ;
+
+    // Um trecho por bloco, com minimo e escala constantes.
+    int j = beginJ;
+    while (j < endJ) {
+        const int tileEnd = std::min(((j >> m_tileShift) + 1) << m_tileShift, endJ);
+        const float minY = m_tileMin[tileRow + (j >> m_tileShift)];
+        const float scale = m_tileScale[tileRow + (j >> m_tileShift)];
+#if defined(HEIGHTS_USE_AVX2)
+        const __m256 min8 = _mm256_set1_ps(minY);
+        const __m256 scale8 = _mm256_set1_ps(scale);
+        for (; j + 8 <= tileEnd; j += 8) {
+            const __m256 code = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j))));
+            _mm256_storeu_ps(out + j, _mm256_add_ps(min8, _mm256_mul_ps(scale8, code)));
+        }
+#elif defined(HEIGHTS_USE_SSE2)
+        const __m128 min4 = _mm_set1_ps(minY);
+        const __m128 scale4 = _mm_set1_ps(scale);
+        const __m128i zero = _mm_setzero_si128();
+        for (; j + 8 <= tileEnd; j += 8) {
+            const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j));
+            const __m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, zero));
+            const __m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(packed, zero));
+            _mm_storeu_ps(out + j, _mm_add_ps(min4, _mm_mul_ps(scale4, low)));
+            _mm_storeu_ps(out + j + 4, _mm_add_ps(min4, _mm_mul_ps(scale4, high)));
+        }
+#endif
+        for (; j < tileEnd; ++j) out[j] = minY + scale * float(codes[j]);
+    }
+}
+
+std::vector<std::pair<int, int>> QuantizedHeights::Store(int beginI, int beginJ, int endI, int endJ, const float* values)
+{
+    beginI = std::max(beginI, 0);
+    beginJ = std::max(beginJ, 0);
+    endI = std::min(endI, m_rows);
+    endJ = std::min(endJ, m_cols);
+    std::vector<std::pair<int, int>> encoded;
+    if (endI <= beginI || endJ <= beginJ) return encoded;
+
+    const int size = TileSize();
+    const size_t valueCols = size_t(endJ - beginJ);
+    std::vector<float> block(size_t(size) * size);
+    for (int ti = beginI >> m_tileShift; ti <= (endI - 1) >> m_tileShift; ++ti) {
+        for (int tj = beginJ >> m_tileShift; tj <= (endJ - 1) >> m_tileShift; ++tj) {
+            const int i0 = ti << m_tileShift;
+            const int j0 = tj << m_tileShift;
+            const int iEnd = std::min(i0 + size, m_rows);
+            const int jEnd = std::min(j0 + size, m_cols);
+            const int fromI = std::max(i0, beginI);
+            const int toI = std::min(iEnd, endI);
+            const int fromJ = std::max(j0, beginJ);
+            const int toJ = std::min(jEnd, endJ);
+            const float* first = values + (fromI - beginI) * valueCols + (fromJ - beginJ);
+
+            float lowY = FLT_MAX;
+            float highY = -FLT_MAX;
+            for (int i = fromI; i < toI; ++i) {
+                for (int j = fromJ; j < toJ; ++j) {
+                    lowY = std::min(lowY, first[(i - fromI) * valueCols + (j - fromJ)]);
+                    highY = std::max(highY, first[(i - fromI) * valueCols + (j - fromJ)]);
+                }
+            }
+
+            const size_t tile = size_t(ti) * m_tilesZ + tj;
+            const float minY = m_tileMin[tile];
+            const float scale = m_tileScale[tile];
+            const float maxY = minY + scale * 65535.0f;
+            if (lowY >= minY && highY <= maxY) {
+                EncodeRange(fromI, fromJ, toI, toJ, first, valueCols, minY, scale);
+                continue;
+            }
+
+            // Faixa nova: cobre as alturas antigas e as novas, com folga do lado que
+            // estourou para que edicoes seguidas no mesmo sentido caibam nela.
+            const float newLow = std::min(lowY, minY);
+            const float newHigh = std::max(highY, maxY);
+            const float span = std::max(newHigh - newLow, 2.0f * (maxY - minY));
+            float newMin = newLow;
+            if (lowY < minY && highY <= maxY) newMin = newHigh - span;
+            else if (lowY < minY) newMin = newLow - 0.5f * (span - (newHigh - newLow));
+            const float newScale = span / 65535.0f;
+
+            for (int i = i0; i < iEnd; ++i) {
+                float* row = block.data() + size_t(i - i0) * size;
+                DecodeRow(i, j0, jEnd, row);
+                if (i < fromI || i >= toI) continue;
+                std::copy(first + (i - fromI) * valueCols, first + (i - fromI) * valueCols + (toJ - fromJ), row + (fromJ - j0));
+            }
+            m_tileMin[tile] = newMin;
+            m_tileScale[tile] = newScale;
+            const float magnitude = std::max(std::fabs(newMin), std::fabs(newMin + span));
+            m_tileError[tile] += 0.5f * newScale + 4.0f * FLT_EPSILON * magnitude;
+            EncodeRange(i0, j0, iEnd, jEnd, block.data(), size_t(size), newMin, newScale);
+            encoded.emplace_back(ti, tj);
+        }
+    }
+    return encoded;
+}
+
+float QuantizedHeights::MaxError() const
+{
+    // O erro acumulado de cada bloco (meia escala e o arredondamento de float de cada
+    // codificacao), mais o arredondamento de float da codificacao e decodificacao atuais.
+    float error = 0.0f;
+    for (size_t tile = 0; tile < m_tileMin.size(); ++tile) {
+        const float maxY = m_tileMin[tile] + m_tileScale[tile] * 65535.0f;
+        const float magnitude = std::max(std::fabs(m_tileMin[tile]), std::fabs(maxY));
+        error = std::max(error, m_tileError[tile] + 4.0f * FLT_EPSILON * magnitude);
+    }
+    return error;
+}
+
+size_t QuantizedHeights::MemoryBytes() const
+{
+    return m_codes.size() * sizeof(uint16_t) + (m_tileMin.size() + m_tileScale.size() + m_tileError.size()) * sizeof(float);
+}
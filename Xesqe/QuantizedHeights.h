@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Alturas em 16 bits com minimo e escala proprios de cada bloco de TileSize x
+// TileSize amostras: altura = minimo + escala * codigo. A escala so cobre a
+// variacao do bloco, entao o erro de cada amostra fica em meia escala (MaxError),
+// bem menor do que com uma escala unica para o mapa. Os codigos seguem o layout
+// de Terrain, [i * Cols + j], e uma linha inteira decodifica em SIMD.
+class QuantizedHeights
+{
+public:
+    static constexpr int DefaultTileSize = 64;
+
+    QuantizedHeights() = default;
+    // heights[i * cols + j]; tileSize precisa ser potencia de 2.
+    QuantizedHeights(std::span<const float> heights, int rows, int cols, int tileSize = DefaultTileSize);
+    // Le um arquivo gravado por Save.
+    explicit QuantizedHeights(const std::string& path);
+    void Save(const std::string& path) const;
+
+    bool Empty() const { return m_codes.empty(); }
+    int Rows() const { return m_rows; }
+    int Cols() const { return m_cols; }
+    int TileSize() const { return 1 << m_tileShift; }
+    int TileShift() const { return m_tileShift; }
+    int TilesZ() const { return m_tilesZ; }
+
+    float Height(int i, int j) const
+    {
+        const size_t tile = size_t(i >> m_tileShift) * m_tilesZ + (j >> m_tileShift);
+        return m_tileMin[tile] + m_tileScale[tile] * float(m_codes[size_t(i) * m_cols + j]);
+    }
+    // out[k] = Height(i, beginJ + k) para k em [0, endJ - beginJ), 8 amostras por vez.
+    void DecodeRow(int i, int beginJ, int endJ, float* out) const;
+    // Regrava [beginI, endI) x [beginJ, endJ) com values (o retangulo linha a linha).
+    // Se os valores cabem na faixa do bloco, so as amostras novas sao codificadas e
+    // as outras ficam intactas. Senao a faixa cresce ao menos 2x, para o lado que
+    // estourou, e o bloco e recodificado: com a faixa dobrando, o erro das amostras
+    // antigas soma uma serie geometrica e fica abaixo de uma escala. Retorna os
+    // blocos (ti, tj) recodificados, os unicos em que amostras fora do retangulo mudam.
+    std::vector<std::pair<int, int>> Store(int beginI, int beginJ, int endI, int endJ, const float* values);
+
+    // Maior diferenca possivel entre uma altura gravada (pelo construtor ou por
+    // Store) e a decodificada, incluindo a requantizacao das faixas ampliadas.
+    float MaxError() const;
+    size_t MemoryBytes() const;
+
+    // Para os caminhos SIMD de Terrain. Depois do ultimo codigo ha mais um, para
+    // que um gather de 32 bits a partir de qualquer codigo fique dentro do buffer.
+    const uint16_t* Codes() const { return m_codes.data(); }
+    const float* TileMin() const { return m_tileMin.data(); }
+    const float* TileScale() const { return m_tileScale.data(); }
+
+private:
+    void Allocate(int rows, int cols, int tileSize);
+    // Codifica o bloco (ti, tj) a partir de block[li * stride + lj], sua primeira amostra,
+    // com a faixa justa dos valores.
+    void EncodeTile(int ti, int tj, const float* block, size_t stride);
+    // Codifica o retangulo [i0, i1) x [j0, j1), todo num bloco de minimo minY e escala scale.
+    void EncodeRange(int i0, int j0, int i1, int j1, const float* values, size_t stride, float minY, float scale);
+
+    int m_rows = 0;
+    int m_cols = 0;
+    int m_tileShift = 0;
+    int m_tilesX = 0;
+    int m_tilesZ = 0;
+    std::vector<uint16_t> m_codes;
+    std::vector<float> m_tileMin;     // [ti * TilesZ + tj]
+    std::vector<float> m_tileScale;
+    std::vector<float> m_tileError;   // erro acumulado de cada bloco, sem o arredondamento de float
+};
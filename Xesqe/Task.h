@@ -0,0 +1,182 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+template <typename T = void>
+class Task;
+
+namespace TaskDetail
+{
+    // Ao terminar, a corrotina continua direto em quem fez co_await nela.
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            std::coroutine_handle<> continuation = handle.promise().Continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    struct PromiseBase
+    {
+        std::coroutine_handle<> Continuation;
+        std::exception_ptr Error;
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        FinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() { Error = std::current_exception(); }
+    };
+
+    template <typename T>
+    struct Promise : PromiseBase
+    {
+        std::optional<T> Value;
+
+        Task<T> get_return_object();
+        template <typename U>
+        void return_value(U&& value) { Value.emplace(std::forward<U>(value)); }
+        T Result()
+        {
+            if (Error) std::rethrow_exception(Error);
+            return std::move(*Value);
+        }
+    };
+
+    template <>
+    struct Promise<void> : PromiseBase
+    {
+        Task<void> get_return_object();
+        void return_void() {}
+        void Result()
+        {
+            if (Error) std::rethrow_exception(Error);
+        }
+    };
+}
+
+// Corrotina preguicosa: so comeca no co_await e, ao terminar, retoma quem
+// esperou (na thread em que terminou). Excecoes sao relancadas no co_await.
+template <typename T>
+class Task
+{
+public:
+    using promise_type = TaskDetail::Promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : m_handle(handle) {}
+    Task(Task&& rhs) noexcept : m_handle(std::exchange(rhs.m_handle, {})) {}
+    Task& operator=(Task&& rhs) noexcept
+    {
+        if (this != &rhs) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(rhs.m_handle, {});
+        }
+        return *this;
+    }
+    Task(const Task& rhs) = delete;
+    Task& operator=(const Task& rhs) = delete;
+    ~Task()
+    {
+        if (m_handle) m_handle.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        m_handle.promise().Continuation = awaiting;
+        return m_handle;
+    }
+    T await_resume() { return m_handle.promise().Result(); }
+
+private:
+    std::coroutine_handle<promise_type> m_handle;
+};
+
+template <typename T>
+Task<T> TaskDetail::Promise<T>::get_return_object()
+{
+    return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskDetail::Promise<void>::get_return_object()
+{
+    return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+// Resultado de uma Task disparada com Spawn, consultado a cada frame pela
+// thread da janela sem bloquear.
+template <typename T>
+class AsyncResult
+{
+    static_assert(!std::is_void_v<T>, "AsyncResult precisa de um valor");
+
+public:
+    bool Pending() const { return m_state && !m_state->Done.load(std::memory_order_acquire); }
+    bool Ready() const { return m_state && m_state->Done.load(std::memory_order_acquire); }
+
+    // So depois de Ready(). Entrega o valor (ou relanca a excecao da tarefa) e esvazia o AsyncResult.
+    T Take()
+    {
+        std::shared_ptr<State> state = std::move(m_state);
+        if (state->Error) std::rethrow_exception(state->Error);
+        return std::move(*state->Value);
+    }
+
+private:
+    struct State
+    {
+        std::atomic<bool> Done{ false };
+        std::optional<T> Value;
+        std::exception_ptr Error;
+    };
+    std::shared_ptr<State> m_state;
+
+    template <typename U>
+    friend AsyncResult<U> Spawn(Task<U> task);
+};
+
+namespace TaskDetail
+{
+    // Corrotina ansiosa e sem dono que so leva uma Task ate o fim.
+    struct Detached
+    {
+        struct promise_type
+        {
+            Detached get_return_object() noexcept { return {}; }
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept { std::terminate(); }
+        };
+    };
+
+    template <typename T, typename State>
+    Detached RunDetached(Task<T> task, std::shared_ptr<State> state)
+    {
+        try {
+            state->Value.emplace(co_await task);
+        }
+        catch (...) {
+            state->Error = std::current_exception();
+        }
+        state->Done.store(true, std::memory_order_release);
+    }
+}
+
+// Comeca a tarefa na thread atual ate o primeiro ponto de suspensao; por isso
+// as tarefas de carregamento comecam com co_await pool.Schedule().
+template <typename T>
+AsyncResult<T> Spawn(Task<T> task)
+{
+    AsyncResult<T> result;
+    result.m_state = std::make_shared<typename AsyncResult<T>::State>();
+    TaskDetail::RunDetached(std::move(task), result.m_state);
+    return result;
+}
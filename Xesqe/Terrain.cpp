@@ -0,0 +1,917 @@
+#include "pch.h"
+#include "Terrain.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__AVX2__)
+#define TERRAIN_USE_AVX2 1
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define TERRAIN_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // De onde saem as quatro alturas de uma celula: o mapa em float ou, com Codes,
+    // os codigos de QuantizedHeights, decodificados como em QuantizedHeights::Height.
+    struct CornerSource
+    {
+        const float* Heights = nullptr;
+        const uint16_t* Codes = nullptr;
+        const float* TileMin = nullptr;
+        const float* TileScale = nullptr;
+        int Cols = 0;
+        int TileShift = 0;
+        int TilesZ = 0;
+    };
+
+    CornerSource MakeCornerSource(const std::vector<float>& heights, const QuantizedHeights& quantized, int cols)
+    {
+        CornerSource source;
+        source.Cols = cols;
+        if (quantized.Empty()) {
+            source.Heights = heights.data();
+            return source;
+        }
+        source.Codes = quantized.Codes();
+        source.TileMin = quantized.TileMin();
+        source.TileScale = quantized.TileScale();
+        source.TileShift = quantized.TileShift();
+        source.TilesZ = quantized.TilesZ();
+        return source;
+    }
+
+#if defined(TERRAIN_USE_AVX2)
+    // Alturas de (ix, iz), (ix + 1, iz), (ix, iz + 1) e (ix + 1, iz + 1) nos 8 pontos.
+    void LoadCorners8(const CornerSource& s, __m256i ix, __m256i iz, __m256& h00, __m256& h10, __m256& h01, __m256& h11)
+    {
+        const __m256i cols = _mm256_set1_epi32(s.Cols);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i i00 = _mm256_add_epi32(_mm256_mullo_epi32(ix, cols), iz);
+        const __m256i i10 = _mm256_add_epi32(i00, cols);
+        const __m256i i01 = _mm256_add_epi32(i00, one);
+        const __m256i i11 = _mm256_add_epi32(i10, one);
+        if (!s.Codes) {
+            h00 = _mm256_i32gather_ps(s.Heights, i00, 4);
+            h10 = _mm256_i32gather_ps(s.Heights, i10, 4);
+            h01 = _mm256_i32gather_ps(s.Heights, i01, 4);
+            h11 = _mm256_i32gather_ps(s.Heights, i11, 4);
+            return;
+        }
+
+        // Os cantos podem cair em blocos diferentes, cada um com minimo e escala.
+        const __m128i shift = _mm_cvtsi32_si128(s.TileShift);
+        const __m256i tilesZ = _mm256_set1_epi32(s.TilesZ);
+        const __m256i row0 = _mm256_mullo_epi32(_mm256_srl_epi32(ix, shift), tilesZ);
+        const __m256i row1 = _mm256_mullo_epi32(_mm256_srl_epi32(_mm256_add_epi32(ix, one), shift), tilesZ);
+        const __m256i col0 = _mm256_srl_epi32(iz, shift);
+        const __m256i col1 = _mm256_srl_epi32(_mm256_add_epi32(iz, one), shift);
+        // 32 bits a partir de cada codigo: os 16 de baixo sao ele (little-endian).
+        const __m256i low = _mm256_set1_epi32(0xFFFF);
+        const int* codes = reinterpret_cast<const int*>(s.Codes);
+        auto decode = [&](__m256i index, __m256i tile) {
+            const __m256 code = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_i32gather_epi32(codes, index, 2), low));
+            return _mm256_add_ps(_mm256_i32gather_ps(s.TileMin, tile, 4), _mm256_mul_ps(_mm256_i32gather_ps(s.TileScale, tile, 4), code));
+        };
+        h00 = decode(i00, _mm256_add_epi32(row0, col0));
+        h10 = decode(i10, _mm256_add_epi32(row1, col0));
+        h01 = decode(i01, _mm256_add_epi32(row0, col1));
+        h11 = decode(i11, _mm256_add_epi32(row1, col1));
+    }
+#elif defined(TERRAIN_USE_SSE2)
+    // Sem gather: cada ponto le seus cantos, e a decodificacao dos codigos sai em SIMD.
+    void LoadCorners4(const CornerSource& s, const int32_t* ix, const int32_t* iz, __m128& h00, __m128& h10, __m128& h01, __m128& h11)
+    {
+        if (!s.Codes) {
+            alignas(16) float c00[4], c10[4], c01[4], c11[4];
+            for (int k = 0; k < 4; ++k) {
+                const float* cell = s.Heights + size_t(ix[k]) * s.Cols + iz[k];
+                c00[k] = cell[0];
+                c01[k] = cell[1];
+                c10[k] = cell[s.Cols];
+                c11[k] = cell[s.Cols + 1];
+            }
+            h00 = _mm_load_ps(c00);
+            h10 = _mm_load_ps(c10);
+            h01 = _mm_load_ps(c01);
+            h11 = _mm_load_ps(c11);
+            return;
+        }
+
+        // Quase sempre os quatro cantos estao no mesmo bloco; so na borda dele o vizinho muda.
+        alignas(16) float code[4][4], minY[4][4], scale[4][4];
+        for (int k = 0; k < 4; ++k) {
+            const uint16_t* cell = s.Codes + size_t(ix[k]) * s.Cols + iz[k];
+            code[0][k] = float(cell[0]);
+            code[1][k] = float(cell[s.Cols]);
+            code[2][k] = float(cell[1]);
+            code[3][k] = float(cell[s.Cols + 1]);
+            const size_t tile = size_t(ix[k] >> s.TileShift) * s.TilesZ + (iz[k] >> s.TileShift);
+            const size_t nextI = ((ix[k] + 1) >> s.TileShift) != (ix[k] >> s.TileShift) ? size_t(s.TilesZ) : 0;
+            const size_t nextJ = ((iz[k] + 1) >> s.TileShift) != (iz[k] >> s.TileShift) ? 1 : 0;
+            const size_t tiles[4] = { tile, tile + nextI, tile + nextJ, tile + nextI + nextJ };
+            for (int c = 0; c < 4; ++c) {
+                minY[c][k] = s.TileMin[tiles[c]];
+                scale[c][k] = s.TileScale[tiles[c]];
+            }
+        }
+        __m128 h[4];
+        for (int c = 0; c < 4; ++c) {
+            h[c] = _mm_add_ps(_mm_load_ps(minY[c]), _mm_mul_ps(_mm_load_ps(scale[c]), _mm_load_ps(code[c])));
+        }
+        h00 = h[0];
+        h10 = h[1];
+        h01 = h[2];
+        h11 = h[3];
+    }
+#endif
+
+    // Constantes de GetHeightAt. O caminho SIMD repete a mesma ordem de operacoes
+    // e da o mesmo resultado bit a bit (sem contracao em FMA, o padrao do /fp:precise).
+    struct HeightSampler
+    {
+        CornerSource Corners;
+        int Rows;
+        int Cols;
+        float HalfWidth, Width, ScaleX;
+        float HalfDepth, Depth, ScaleZ;
+    };
+
+#if defined(TERRAIN_USE_AVX2)
+    void SampleHeights8(const HeightSampler& s, const float* x, const float* z, float* out)
+    {
+        const __m256 fx = _mm256_mul_ps(_mm256_div_ps(_mm256_add_ps(_mm256_loadu_ps(x), _mm256_set1_ps(s.HalfWidth)),
+            _mm256_set1_ps(s.Width)), _mm256_set1_ps(s.ScaleX));
+        const __m256 fz = _mm256_mul_ps(_mm256_div_ps(_mm256_add_ps(_mm256_loadu_ps(z), _mm256_set1_ps(s.HalfDepth)),
+            _mm256_set1_ps(s.Depth)), _mm256_set1_ps(s.ScaleZ));
+
+        // Truncamento, como o (int) do escalar; NaN e estouro viram INT_MIN e caem fora.
+        __m256i ix = _mm256_cvttps_epi32(fx);
+        __m256i iz = _mm256_cvttps_epi32(fz);
+        const __m256i minusOne = _mm256_set1_epi32(-1);
+        const __m256i valid = _mm256_and_si256(
+            _mm256_and_si256(_mm256_cmpgt_epi32(ix, minusOne), _mm256_cmpgt_epi32(_mm256_set1_epi32(s.Rows - 1), ix)),
+            _mm256_and_si256(_mm256_cmpgt_epi32(iz, minusOne), _mm256_cmpgt_epi32(_mm256_set1_epi32(s.Cols - 1), iz)));
+        const __m256 fracX = _mm256_sub_ps(fx, _mm256_cvtepi32_ps(ix));
+        const __m256 fracZ = _mm256_sub_ps(fz, _mm256_cvtepi32_ps(iz));
+
+        // Pontos fora do terreno leem a celula 0 e sao zerados no final.
+        ix = _mm256_and_si256(ix, valid);
+        iz = _mm256_and_si256(iz, valid);
+        __m256 h00, h10, h01, h11;
+        LoadCorners8(s.Corners, ix, iz, h00, h10, h01, h11);
+
+        const __m256 unit = _mm256_set1_ps(1.0f);
+        const __m256 invX = _mm256_sub_ps(unit, fracX);
+        const __m256 h0 = _mm256_add_ps(_mm256_mul_ps(h00, invX), _mm256_mul_ps(h10, fracX));
+        const __m256 h1 = _mm256_add_ps(_mm256_mul_ps(h01, invX), _mm256_mul_ps(h11, fracX));
+        const __m256 h = _mm256_add_ps(_mm256_mul_ps(h0, _mm256_sub_ps(unit, fracZ)), _mm256_mul_ps(h1, fracZ));
+        _mm256_storeu_ps(out, _mm256_and_ps(h, _mm256_castsi256_ps(valid)));
+    }
+#elif defined(TERRAIN_USE_SSE2)
+    // SSE2 nao tem gather nem multiplicacao de inteiros de 32 bits: os indices
+    // saem do registrador e as quatro alturas de cada ponto sao lidas uma a uma.
+    void SampleHeights4(const HeightSampler& s, const float* x, const float* z, float* out)
+    {
+        const __m128 fx = _mm_mul_ps(_mm_div_ps(_mm_add_ps(_mm_loadu_ps(x), _mm_set1_ps(s.HalfWidth)),
+            _mm_set1_ps(s.Width)), _mm_set1_ps(s.ScaleX));
+        const __m128 fz = _mm_mul_ps(_mm_div_ps(_mm_add_ps(_mm_loadu_ps(z), _mm_set1_ps(s.HalfDepth)),
+            _mm_set1_ps(s.Depth)), _mm_set1_ps(s.ScaleZ));
+
+        __m128i ix = _mm_cvttps_epi32(fx);
+        __m128i iz = _mm_cvttps_epi32(fz);
+        const __m128i minusOne = _mm_set1_epi32(-1);
+        const __m128i valid = _mm_and_si128(
+            _mm_and_si128(_mm_cmpgt_epi32(ix, minusOne), _mm_cmplt_epi32(ix, _mm_set1_epi32(s.Rows - 1))),
+            _mm_and_si128(_mm_cmpgt_epi32(iz, minusOne), _mm_cmplt_epi32(iz, _mm_set1_epi32(s.Cols - 1))));
+        const __m128 fracX = _mm_sub_ps(fx, _mm_cvtepi32_ps(ix));
+        const __m128 fracZ = _mm_sub_ps(fz, _mm_cvtepi32_ps(iz));
+
+        alignas(16) int32_t ixs[4];
+        alignas(16) int32_t izs[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(ixs), _mm_and_si128(ix, valid));
+        _mm_store_si128(reinterpret_cast<__m128i*>(izs), _mm_and_si128(iz, valid));
+        __m128 h00, h10, h01, h11;
+        LoadCorners4(s.Corners, ixs, izs, h00, h10, h01, h11);
+
+        const __m128 unit = _mm_set1_ps(1.0f);
+        const __m128 invX = _mm_sub_ps(unit, fracX);
+        const __m128 h0 = _mm_add_ps(_mm_mul_ps(h00, invX), _mm_mul_ps(h10, fracX));
+        const __m128 h1 = _mm_add_ps(_mm_mul_ps(h01, invX), _mm_mul_ps(h11, fracX));
+        const __m128 h = _mm_add_ps(_mm_mul_ps(h0, _mm_sub_ps(unit, fracZ)), _mm_mul_ps(h1, fracZ));
+        _mm_storeu_ps(out, _mm_and_ps(h, _mm_castsi128_ps(valid)));
+    }
+
+    void SampleHeights8(const HeightSampler& s, const float* x, const float* z, float* out)
+    {
+        SampleHeights4(s, x, z, out);
+        SampleHeights4(s, x + 4, z + 4, out + 4);
+    }
+#endif
+
+    // Constantes de GetSurfaceAt, na grade de GenerateTerrainMesh. Como em
+    // HeightSampler, o caminho SIMD da o mesmo resultado bit a bit do escalar.
+    struct SurfaceSampler
+    {
+        CornerSource Corners;
+        int Rows;
+        int Cols;
+        float OriginX, SpacingX, InvSpacingX;
+        float OriginZ, SpacingZ, InvSpacingZ;
+    };
+
+#if defined(TERRAIN_USE_AVX2)
+    void SampleSurface8(const SurfaceSampler& s, const float* x, const float* z,
+        float* height, float* normalX, float* normalY, float* normalZ)
+    {
+        const __m256 fx = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(x), _mm256_set1_ps(s.OriginX)), _mm256_set1_ps(s.SpacingX));
+        const __m256 fz = _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(z), _mm256_set1_ps(s.OriginZ)), _mm256_set1_ps(s.SpacingZ));
+
+        // A comparacao em float tambem descarta NaN; dentro do mapa o truncamento e o floor.
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 valid = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(fx, zero, _CMP_GE_OQ), _mm256_cmp_ps(fx, _mm256_set1_ps(float(s.Rows - 1)), _CMP_LT_OQ)),
+            _mm256_and_ps(_mm256_cmp_ps(fz, zero, _CMP_GE_OQ), _mm256_cmp_ps(fz, _mm256_set1_ps(float(s.Cols - 1)), _CMP_LT_OQ)));
+        const __m256i validMask = _mm256_castps_si256(valid);
+        const __m256i ix = _mm256_and_si256(_mm256_cvttps_epi32(fx), validMask);
+        const __m256i iz = _mm256_and_si256(_mm256_cvttps_epi32(fz), validMask);
+        const __m256 u = _mm256_sub_ps(fx, _mm256_cvtepi32_ps(ix));
+        const __m256 v = _mm256_sub_ps(fz, _mm256_cvtepi32_ps(iz));
+
+        __m256 h00, h10, h01, h11;
+        LoadCorners8(s.Corners, ix, iz, h00, h10, h01, h11);
+
+        const __m256 upper = _mm256_cmp_ps(_mm256_add_ps(u, v), _mm256_set1_ps(1.0f), _CMP_GT_OQ);
+        const __m256 du = _mm256_blendv_ps(_mm256_sub_ps(h10, h00), _mm256_sub_ps(h11, h01), upper);
+        const __m256 dv = _mm256_blendv_ps(_mm256_sub_ps(h01, h00), _mm256_sub_ps(h11, h10), upper);
+        const __m256 base = _mm256_blendv_ps(h00, _mm256_sub_ps(_mm256_add_ps(h01, h10), h11), upper);
+        const __m256 h = _mm256_add_ps(_mm256_add_ps(base, _mm256_mul_ps(u, du)), _mm256_mul_ps(v, dv));
+
+        const __m256 gx = _mm256_mul_ps(du, _mm256_set1_ps(s.InvSpacingX));
+        const __m256 gz = _mm256_mul_ps(dv, _mm256_set1_ps(s.InvSpacingZ));
+        const __m256 unit = _mm256_set1_ps(1.0f);
+        const __m256 inv = _mm256_div_ps(unit,
+            _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gz, gz)), unit)));
+
+        // Fora do mapa: altura 0 e normal para cima.
+        _mm256_storeu_ps(height, _mm256_and_ps(h, valid));
+        _mm256_storeu_ps(normalX, _mm256_and_ps(_mm256_mul_ps(_mm256_sub_ps(zero, gx), inv), valid));
+        _mm256_storeu_ps(normalY, _mm256_blendv_ps(unit, inv, valid));
+        _mm256_storeu_ps(normalZ, _mm256_and_ps(_mm256_mul_ps(_mm256_sub_ps(zero, gz), inv), valid));
+    }
+#elif defined(TERRAIN_USE_SSE2)
+    __m128 Select4(__m128 a, __m128 b, __m128 mask)
+    {
+        return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+    }
+
+    void SampleSurface4(const SurfaceSampler& s, const float* x, const float* z,
+        float* height, float* normalX, float* normalY, float* normalZ)
+    {
+        const __m128 fx = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(x), _mm_set1_ps(s.OriginX)), _mm_set1_ps(s.SpacingX));
+        const __m128 fz = _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(z), _mm_set1_ps(s.OriginZ)), _mm_set1_ps(s.SpacingZ));
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 valid = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(fx, zero), _mm_cmplt_ps(fx, _mm_set1_ps(float(s.Rows - 1)))),
+            _mm_and_ps(_mm_cmpge_ps(fz, zero), _mm_cmplt_ps(fz, _mm_set1_ps(float(s.Cols - 1)))));
+        const __m128i validMask = _mm_castps_si128(valid);
+        const __m128i ix = _mm_and_si128(_mm_cvttps_epi32(fx), validMask);
+        const __m128i iz = _mm_and_si128(_mm_cvttps_epi32(fz), validMask);
+        const __m128 u = _mm_sub_ps(fx, _mm_cvtepi32_ps(ix));
+        const __m128 v = _mm_sub_ps(fz, _mm_cvtepi32_ps(iz));
+
+        alignas(16) int32_t ixs[4];
+        alignas(16) int32_t izs[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(ixs), ix);
+        _mm_store_si128(reinterpret_cast<__m128i*>(izs), iz);
+        __m128 h00, h10, h01, h11;
+        LoadCorners4(s.Corners, ixs, izs, h00, h10, h01, h11);
+
+        const __m128 unit = _mm_set1_ps(1.0f);
+        const __m128 upper = _mm_cmpgt_ps(_mm_add_ps(u, v), unit);
+        const __m128 du = Select4(_mm_sub_ps(h10, h00), _mm_sub_ps(h11, h01), upper);
+        const __m128 dv = Select4(_mm_sub_ps(h01, h00), _mm_sub_ps(h11, h10), upper);
+        const __m128 base = Select4(h00, _mm_sub_ps(_mm_add_ps(h01, h10), h11), upper);
+        const __m128 h = _mm_add_ps(_mm_add_ps(base, _mm_mul_ps(u, du)), _mm_mul_ps(v, dv));
+
+        const __m128 gx = _mm_mul_ps(du, _mm_set1_ps(s.InvSpacingX));
+        const __m128 gz = _mm_mul_ps(dv, _mm_set1_ps(s.InvSpacingZ));
+        const __m128 inv = _mm_div_ps(unit, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gz, gz)), unit)));
+
+        _mm_storeu_ps(height, _mm_and_ps(h, valid));
+        _mm_storeu_ps(normalX, _mm_and_ps(_mm_mul_ps(_mm_sub_ps(zero, gx), inv), valid));
+        _mm_storeu_ps(normalY, Select4(unit, inv, valid));
+        _mm_storeu_ps(normalZ, _mm_and_ps(_mm_mul_ps(_mm_sub_ps(zero, gz), inv), valid));
+    }
+
+    void SampleSurface8(const SurfaceSampler& s, const float* x, const float* z,
+        float* height, float* normalX, float* normalY, float* normalZ)
+    {
+        SampleSurface4(s, x, z, height, normalX, normalY, normalZ);
+        SampleSurface4(s, x + 4, z + 4, height + 4, normalX + 4, normalY + 4, normalZ + 4);
+    }
+#endif
+
+    // Diferencas centrais; invDx e invDz ja incluem o numero de passos (2 no meio, 1 na borda).
+    // Os caminhos SIMD de NormalRow repetem a mesma ordem de operacoes.
+    void NormalFromDifferences(float hL, float hR, float hD, float hU, float invDx, float invDz,
+        float& nx, float& ny, float& nz)
+    {
+        const float gx = (hL - hR) * invDx;
+        const float gz = (hD - hU) * invDz;
+        const float inv = 1.0f / std::sqrt(gx * gx + gz * gz + 1.0f);
+        nx = gx * inv;
+        ny = inv;
+        nz = gz * inv;
+    }
+
+    // Arredondamento para o par mais proximo, como o cvtps do SSE.
+    uint32_t PackNormal(float nx, float nz)
+    {
+        const uint32_t x = uint32_t(int32_t(std::nearbyint(nx * 32767.0f)));
+        const uint32_t z = uint32_t(int32_t(std::nearbyint(nz * 32767.0f)));
+        return (x & 0xFFFFu) | (z << 16);
+    }
+
+    float SmoothStep(float edge0, float edge1, float x)
+    {
+        if (edge1 <= edge0) return x < edge0 ? 0.0f : 1.0f;
+        const float t = std::clamp((x - edge0) / (edge1 - edge0), 0.0f, 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    float InvStep(int steps, float spacing)
+    {
+        return steps > 0 ? 1.0f / (float(steps) * spacing) : 0.0f;
+    }
+
+    // Normais empacotadas de uma linha, colunas [beginJ, endJ), a partir dela (center) e
+    // das vizinhas em x (left e right), todas indexadas pela coluna. As colunas do meio
+    // leem as linhas vizinhas e a propria linha deslocada de 1, sem gather.
+    void NormalRow(const float* left, const float* center, const float* right, int cols, float invDx, float spacingZ,
+        int beginJ, int endJ, uint32_t* out)
+    {
+        auto scalar = [&](int j) {
+            const int jD = std::max(j - 1, 0);
+            const int jU = std::min(j + 1, cols - 1);
+            float nx, ny, nz;
+            NormalFromDifferences(left[j], right[j], center[jD], center[jU], invDx, InvStep(jU - jD, spacingZ), nx, ny, nz);
+            out[j] = PackNormal(nx, nz);
+        };
+
+        int j = beginJ;
+        for (; j < endJ && j < 1; ++j) scalar(j);
+#if defined(TERRAIN_USE_AVX2) || defined(TERRAIN_USE_SSE2)
+        const int innerEnd = std::min(endJ, cols - 1);
+#endif
+#if defined(TERRAIN_USE_AVX2)
+        const __m256 invDx8 = _mm256_set1_ps(invDx);
+        const __m256 invDz8 = _mm256_set1_ps(InvStep(2, spacingZ));
+        const __m256 unit8 = _mm256_set1_ps(1.0f);
+        const __m256 snorm8 = _mm256_set1_ps(32767.0f);
+        const __m256i low8 = _mm256_set1_epi32(0xFFFF);
+        for (; j + 8 <= innerEnd; j += 8) {
+            const __m256 gx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(left + j), _mm256_loadu_ps(right + j)), invDx8);
+            const __m256 gz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(center + j - 1), _mm256_loadu_ps(center + j + 1)), invDz8);
+            const __m256 inv = _mm256_div_ps(unit8, _mm256_sqrt_ps(
+                _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(gx, gx), _mm256_mul_ps(gz, gz)), unit8)));
+            const __m256i x = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_mul_ps(gx, inv), snorm8));
+            const __m256i z = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_mul_ps(gz, inv), snorm8));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + j),
+                _mm256_or_si256(_mm256_and_si256(x, low8), _mm256_slli_epi32(z, 16)));
+        }
+#elif defined(TERRAIN_USE_SSE2)
+        const __m128 invDx4 = _mm_set1_ps(invDx);
+        const __m128 invDz4 = _mm_set1_ps(InvStep(2, spacingZ));
+        const __m128 unit4 = _mm_set1_ps(1.0f);
+        const __m128 snorm4 = _mm_set1_ps(32767.0f);
+        const __m128i low4 = _mm_set1_epi32(0xFFFF);
+        for (; j + 4 <= innerEnd; j += 4) {
+            const __m128 gx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(left + j), _mm_loadu_ps(right + j)), invDx4);
+            const __m128 gz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(center + j - 1), _mm_loadu_ps(center + j + 1)), invDz4);
+            const __m128 inv = _mm_div_ps(unit4, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(gx, gx), _mm_mul_ps(gz, gz)), unit4)));
+            const __m128i x = _mm_cvtps_epi32(_mm_mul_ps(_mm_mul_ps(gx, inv), snorm4));
+            const __m128i z = _mm_cvtps_epi32(_mm_mul_ps(_mm_mul_ps(gz, inv), snorm4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), _mm_or_si128(_mm_and_si128(x, low4), _mm_slli_epi32(z, 16)));
+        }
+#endif
+        for (; j < endJ; ++j) scalar(j);
+    }
+}
+
+Terrain::Terrain(float w, float d, int rows, int cols)
+    : width(w), depth(d), verticesPerRow(rows), verticesPerCol(cols) {
+    GenerateHeightMap();
+}
+
+Terrain::Terrain(float w, float d, int rows, int cols, const NoiseSettings& noise)
+    : width(w), depth(d), verticesPerRow(rows), verticesPerCol(cols) {
+    GenerateHeightMap(noise);
+}
+
+Terrain::Terrain(const std::string& tilePath, size_t memoryBudget)
+    : m_tiles(std::make_unique<HeightTileCache>(tilePath, memoryBudget)) {
+    const HeightTileHeader& header = m_tiles->Header();
+    verticesPerRow = int(header.SamplesX);
+    verticesPerCol = int(header.SamplesZ);
+    width = header.SamplesX * header.SpacingX;
+    depth = header.SamplesZ * header.SpacingZ;
+}
+
+Terrain::Terrain(float w, float d, int rows, int cols, std::vector<float> heights)
+    : width(w), depth(d), verticesPerRow(rows), verticesPerCol(cols), heightMap(std::move(heights)) {
+}
+
+Terrain::Terrain(float w, float d, QuantizedHeights heights)
+    : width(w), depth(d), verticesPerRow(heights.Rows()), verticesPerCol(heights.Cols()), m_quantized(std::move(heights)) {
+}
+
+void Terrain::GenerateHeightMap() {
+    m_tiles.reset();
+    m_quantized = QuantizedHeights();
+    normalMap.clear();
+    heightMap.resize(size_t(verticesPerRow) * verticesPerCol);
+    for (int i = 0; i < verticesPerRow; i++) {
+        for (int j = 0; j < verticesPerCol; j++) {
+            float x = (i - verticesPerRow / 2.0f) * (width / verticesPerRow);
+            float z = (j - verticesPerCol / 2.0f) * (depth / verticesPerCol);
+            heightMap[size_t(i) * verticesPerCol + j] = 5.0f * sinf(x * 0.1f) * cosf(z * 0.1f);
+        }
+    }
+}
+
+void Terrain::GenerateHeightMap(const NoiseSettings& noise, unsigned threadCount) {
+    m_tiles.reset();
+    m_quantized = QuantizedHeights();
+    normalMap.clear();
+    heightMap.resize(size_t(verticesPerRow) * verticesPerCol);
+    m_generationStats = GenerateNoise(heightMap, verticesPerRow, verticesPerCol, OriginX(), OriginZ(),
+        SpacingX(), SpacingZ(), noise, threadCount);
+}
+
+float Terrain::GetHeightAt(float x, float z) const {
+    float fx = (x + width / 2) / width * (verticesPerRow - 1);
+    float fz = (z + depth / 2) / depth * (verticesPerCol - 1);
+
+    int ix = (int)fx;
+    int iz = (int)fz;
+
+    if (ix < 0 || ix >= verticesPerRow - 1 || iz < 0 || iz >= verticesPerCol - 1)
+        return 0.0f;
+
+    float fracX = fx - ix;
+    float fracZ = fz - iz;
+
+    float h00, h10, h01, h11;
+    CellHeights(ix, iz, h00, h10, h01, h11);
+
+    float h0 = h00 * (1 - fracX) + h10 * fracX;
+    float h1 = h01 * (1 - fracX) + h11 * fracX;
+
+    return h0 * (1 - fracZ) + h1 * fracZ;
+}
+
+void Terrain::GetHeightsAt(std::span<const float> x, std::span<const float> z, std::span<float> out) const {
+    if (z.size() != x.size() || out.size() != x.size())
+        throw std::runtime_error("GetHeightsAt: x, z e out precisam ter o mesmo tamanho.");
+
+    size_t k = 0;
+#if defined(TERRAIN_USE_AVX2) || defined(TERRAIN_USE_SSE2)
+    if (!m_tiles && verticesPerRow >= 2 && verticesPerCol >= 2) {
+        HeightSampler sampler;
+        sampler.Corners = MakeCornerSource(heightMap, m_quantized, verticesPerCol);
+        sampler.Rows = verticesPerRow;
+        sampler.Cols = verticesPerCol;
+        sampler.HalfWidth = width / 2;
+        sampler.Width = width;
+        sampler.ScaleX = float(verticesPerRow - 1);
+        sampler.HalfDepth = depth / 2;
+        sampler.Depth = depth;
+        sampler.ScaleZ = float(verticesPerCol - 1);
+        for (; k + 8 <= x.size(); k += 8) {
+            SampleHeights8(sampler, x.data() + k, z.data() + k, out.data() + k);
+        }
+    }
+#endif
+    for (; k < x.size(); ++k) {
+        out[k] = GetHeightAt(x[k], z[k]);
+    }
+}
+
+float Terrain::GetSurfaceAt(float x, float z, DirectX::XMFLOAT3& normal) const {
+    normal = { 0.0f, 1.0f, 0.0f };
+    const float fx = (x - OriginX()) / SpacingX();
+    const float fz = (z - OriginZ()) / SpacingZ();
+    if (!(fx >= 0.0f && fx < float(verticesPerRow - 1) && fz >= 0.0f && fz < float(verticesPerCol - 1)))
+        return 0.0f;
+
+    const int ix = (int)fx;
+    const int iz = (int)fz;
+    const float u = fx - ix;
+    const float v = fz - iz;
+    float h00, h10, h01, h11;
+    CellHeights(ix, iz, h00, h10, h01, h11);
+
+    // Mesma diagonal de GenerateTerrainMesh, de (i + 1, j) a (i, j + 1): acima dela
+    // fica o triangulo (i, j + 1), (i + 1, j), (i + 1, j + 1).
+    const bool upper = u + v > 1.0f;
+    const float du = upper ? h11 - h01 : h10 - h00;
+    const float dv = upper ? h11 - h10 : h01 - h00;
+    const float base = upper ? (h01 + h10) - h11 : h00;
+
+    const float gx = du * (1.0f / SpacingX());
+    const float gz = dv * (1.0f / SpacingZ());
+    const float inv = 1.0f / std::sqrt((gx * gx + gz * gz) + 1.0f);
+    normal = { (0.0f - gx) * inv, inv, (0.0f - gz) * inv };
+    return (base + u * du) + v * dv;
+}
+
+void Terrain::GetSurfacesAt(std::span<const float> x, std::span<const float> z, const TerrainSurfaceOutput& out) const {
+    if (z.size() != x.size() || out.Height.size() != x.size() || out.NormalX.size() != x.size() ||
+        out.NormalY.size() != x.size() || out.NormalZ.size() != x.size())
+        throw std::runtime_error("GetSurfacesAt: as entradas e as saidas precisam ter o mesmo tamanho.");
+
+    size_t k = 0;
+#if defined(TERRAIN_USE_AVX2) || defined(TERRAIN_USE_SSE2)
+    if (!m_tiles && verticesPerRow >= 2 && verticesPerCol >= 2) {
+        SurfaceSampler sampler;
+        sampler.Corners = MakeCornerSource(heightMap, m_quantized, verticesPerCol);
+        sampler.Rows = verticesPerRow;
+        sampler.Cols = verticesPerCol;
+        sampler.OriginX = OriginX();
+        sampler.SpacingX = SpacingX();
+        sampler.InvSpacingX = 1.0f / SpacingX();
+        sampler.OriginZ = OriginZ();
+        sampler.SpacingZ = SpacingZ();
+        sampler.InvSpacingZ = 1.0f / SpacingZ();
+        for (; k + 8 <= x.size(); k += 8) {
+            SampleSurface8(sampler, x.data() + k, z.data() + k, out.Height.data() + k,
+                out.NormalX.data() + k, out.NormalY.data() + k, out.NormalZ.data() + k);
+        }
+    }
+#endif
+    for (; k < x.size(); ++k) {
+        DirectX::XMFLOAT3 normal;
+        out.Height[k] = GetSurfaceAt(x[k], z[k], normal);
+        out.NormalX[k] = normal.x;
+        out.NormalY[k] = normal.y;
+        out.NormalZ[k] = normal.z;
+    }
+}
+
+void Terrain::CellHeights(int i, int j, float& h00, float& h10, float& h01, float& h11) const {
+    if (m_tiles) {
+        m_tiles->Cell(i, j, h00, h10, h01, h11);
+        return;
+    }
+    h00 = Height(i, j);
+    h10 = Height(i + 1, j);
+    h01 = Height(i, j + 1);
+    h11 = Height(i + 1, j + 1);
+}
+
+void Terrain::UpdateResidency(float x, float z, float radius) {
+    if (m_tiles) m_tiles->Prefetch(x, z, radius);
+}
+
+Terrain Terrain::Resampled(int rows, int cols) const {
+    if (rows < 2 || cols < 2 || verticesPerRow < 2 || verticesPerCol < 2)
+        throw std::runtime_error("Resampled: os terrenos precisam de pelo menos 2x2 amostras.");
+
+    // Mesma posicao de mundo nas duas grades: i' * (width / rows) = i * (width / verticesPerRow).
+    std::vector<float> heights(size_t(rows) * cols);
+    const float stepI = float(verticesPerRow) / rows;
+    const float stepJ = float(verticesPerCol) / cols;
+    for (int i = 0; i < rows; i++) {
+        const float fi = std::min(i * stepI, float(verticesPerRow - 1));
+        const int ci = std::min(int(fi), verticesPerRow - 2);
+        const float fracX = fi - ci;
+        for (int j = 0; j < cols; j++) {
+            const float fj = std::min(j * stepJ, float(verticesPerCol - 1));
+            const int cj = std::min(int(fj), verticesPerCol - 2);
+            const float fracZ = fj - cj;
+
+            float h00, h10, h01, h11;
+            CellHeights(ci, cj, h00, h10, h01, h11);
+            float h0 = h00 * (1 - fracX) + h10 * fracX;
+            float h1 = h01 * (1 - fracX) + h11 * fracX;
+            heights[size_t(i) * cols + j] = h0 * (1 - fracZ) + h1 * fracZ;
+        }
+    }
+    return Terrain(width, depth, rows, cols, std::move(heights));
+}
+
+Model Terrain::GenerateTerrainMesh() {
+    Model terrainModel;
+    terrainModel.vertices.reserve(size_t(verticesPerRow) * verticesPerCol);
+    terrainModel.indices.reserve(size_t(std::max(verticesPerRow - 1, 0)) * std::max(verticesPerCol - 1, 0) * 6);
+
+    for (int i = 0; i < verticesPerRow; i++) {
+        for (int j = 0; j < verticesPerCol; j++) {
+            Vertex vertex;
+            vertex.Pos.x = (i - verticesPerRow / 2.0f) * (width / verticesPerRow);
+            vertex.Pos.y = Height(i, j);
+            vertex.Pos.z = (j - verticesPerCol / 2.0f) * (depth / verticesPerCol);
+
+            vertex.Normal = NormalAt(i, j);
+
+            terrainModel.vertices.push_back(vertex);
+        }
+    }
+
+    for (int i = 0; i < verticesPerRow - 1; i++) {
+        for (int j = 0; j < verticesPerCol - 1; j++) {
+            const unsigned int topLeft = unsigned(i * verticesPerCol + j);
+            const unsigned int topRight = topLeft + 1;
+            const unsigned int bottomLeft = unsigned((i + 1) * verticesPerCol + j);
+            const unsigned int bottomRight = bottomLeft + 1;
+            terrainModel.indices.insert(terrainModel.indices.end(), { topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight });
+        }
+    }
+
+    terrainModel.materials.push_back(GroundMaterial());
+
+    return terrainModel;
+}
+
+Material Terrain::GroundMaterial() {
+    Material ground;
+    ground.Albedo = { 0.4f, 0.3f, 0.1f };
+    ground.Metallic = 0.0f;
+    ground.Roughness = 0.9f;
+    ground.AO = 1.0f;
+    return ground;
+}
+
+void Terrain::ComputeNormals(unsigned threadCount) {
+    if (m_tiles)
+        throw std::runtime_error("ComputeNormals: o terreno em blocos nao guarda as alturas em memoria.");
+
+    normalMap.resize(size_t(verticesPerRow) * verticesPerCol);
+    TerrainRegion all;
+    all.EndI = verticesPerRow;
+    all.EndJ = verticesPerCol;
+    ComputeNormalRows(all, threadCount);
+}
+
+TerrainRegion Terrain::UpdateNormals(const TerrainRegion& dirty, unsigned threadCount) {
+    if (normalMap.size() != size_t(verticesPerRow) * verticesPerCol) {
+        ComputeNormals(threadCount);
+        TerrainRegion all;
+        all.EndI = verticesPerRow;
+        all.EndJ = verticesPerCol;
+        return all;
+    }
+
+    // A normal de (i, j) le as alturas vizinhas, entao a borda da regiao tambem muda.
+    TerrainRegion region;
+    region.BeginI = std::max(dirty.BeginI - 1, 0);
+    region.BeginJ = std::max(dirty.BeginJ - 1, 0);
+    region.EndI = std::min(dirty.EndI + 1, verticesPerRow);
+    region.EndJ = std::min(dirty.EndJ + 1, verticesPerCol);
+    if (dirty.Empty() || region.Empty()) return TerrainRegion();
+
+    ComputeNormalRows(region, threadCount);
+    return region;
+}
+
+void Terrain::ComputeNormalRows(const TerrainRegion& region, unsigned threadCount) {
+    const int blockRows = 16;
+    const int rowCount = std::max(region.EndI - region.BeginI, 0);
+    ParallelForBlocks((rowCount + blockRows - 1) / blockRows, threadCount, [&](int block) {
+        const int begin = region.BeginI + block * blockRows;
+        const int end = std::min(region.EndI, begin + blockRows);
+        // Quantizado: janela de tres linhas decodificadas (so nas colunas lidas), na
+        // posicao i % 3. Linhas vizinhas nunca dividem posicao, entao cada linha do
+        // bloco e decodificada uma vez.
+        const int readBegin = std::max(region.BeginJ - 1, 0);
+        const int readEnd = std::min(region.EndJ + 1, verticesPerCol);
+        std::unique_ptr<float[]> window;
+        int rowIndex[3] = { -1, -1, -1 };
+        auto row = [&](int i) -> const float* {
+            if (m_quantized.Empty()) return heightMap.data() + size_t(i) * verticesPerCol;
+            if (!window) window.reset(new float[size_t(3) * verticesPerCol]);
+            const int slot = i % 3;
+            float* decoded = window.get() + size_t(slot) * verticesPerCol;
+            if (rowIndex[slot] != i) {
+                m_quantized.DecodeRow(i, readBegin, readEnd, decoded + readBegin);
+                rowIndex[slot] = i;
+            }
+            return decoded;
+        };
+        for (int i = begin; i < end; i++) {
+            const int iL = std::max(i - 1, 0);
+            const int iR = std::min(i + 1, verticesPerRow - 1);
+            NormalRow(row(iL), row(i), row(iR), verticesPerCol, InvStep(iR - iL, SpacingX()), SpacingZ(),
+                region.BeginJ, region.EndJ, normalMap.data() + size_t(i) * verticesPerCol);
+        }
+    });
+}
+
+DirectX::XMFLOAT3 Terrain::NormalAt(int i, int j) const {
+    const int iL = std::max(i - 1, 0);
+    const int iR = std::min(i + 1, verticesPerRow - 1);
+    const int jD = std::max(j - 1, 0);
+    const int jU = std::min(j + 1, verticesPerCol - 1);
+
+    DirectX::XMFLOAT3 normal;
+    NormalFromDifferences(Height(iL, j), Height(iR, j), Height(i, jD), Height(i, jU),
+        InvStep(iR - iL, SpacingX()), InvStep(jU - jD, SpacingZ()), normal.x, normal.y, normal.z);
+    return normal;
+}
+
+DirectX::XMFLOAT3 Terrain::UnpackNormal(uint32_t packed) {
+    const float x = std::max(int16_t(packed & 0xFFFFu) / 32767.0f, -1.0f);
+    const float z = std::max(int16_t(packed >> 16) / 32767.0f, -1.0f);
+    return { x, std::sqrt(std::max(1.0f - x * x - z * z, 0.0f)), z };
+}
+
+void TerrainRegion::Include(const TerrainRegion& other) {
+    if (other.Empty()) return;
+    if (Empty()) {
+        *this = other;
+        return;
+    }
+    BeginI = std::min(BeginI, other.BeginI);
+    BeginJ = std::min(BeginJ, other.BeginJ);
+    EndI = std::max(EndI, other.EndI);
+    EndJ = std::max(EndJ, other.EndJ);
+}
+
+TerrainStamp MakeCraterStamp(float radius, float depth, float rimHeight, float spacing) {
+    if (radius <= 0.0f || spacing <= 0.0f)
+        throw std::runtime_error("MakeCraterStamp: raio e espacamento precisam ser positivos.");
+
+    // A borda vai ate 1.6 raios e chega a zero suavemente, sem deixar degrau no terreno.
+    const int half = int(std::ceil(radius * 1.6f / spacing));
+    TerrainStamp stamp;
+    stamp.Rows = stamp.Cols = 2 * half + 1;
+    stamp.Spacing = spacing;
+    stamp.Heights.resize(size_t(stamp.Rows) * stamp.Cols);
+    for (int i = 0; i < stamp.Rows; i++) {
+        for (int j = 0; j < stamp.Cols; j++) {
+            const float dx = (i - half) * spacing;
+            const float dz = (j - half) * spacing;
+            const float r = std::sqrt(dx * dx + dz * dz) / radius;
+            const float rim = (r - 1.0f) / 0.3f;
+            float h = rimHeight * std::exp(-rim * rim);
+            if (r < 1.0f) h += depth * (r * r - 1.0f);
+            stamp.Heights[size_t(i) * stamp.Cols + j] = h * (1.0f - SmoothStep(1.3f, 1.6f, r));
+        }
+    }
+    return stamp;
+}
+
+TerrainRegion Terrain::RegionAround(float x, float z, float radius) const {
+    TerrainRegion region;
+    region.BeginI = std::max(int(std::ceil((x - radius - OriginX()) / SpacingX())), 0);
+    region.BeginJ = std::max(int(std::ceil((z - radius - OriginZ()) / SpacingZ())), 0);
+    region.EndI = std::min(int(std::floor((x + radius - OriginX()) / SpacingX())) + 1, verticesPerRow);
+    region.EndJ = std::min(int(std::floor((z + radius - OriginZ()) / SpacingZ())) + 1, verticesPerCol);
+    return region.Empty() ? TerrainRegion() : region;
+}
+
+TerrainRegion Terrain::ApplyBrush(const TerrainBrush& brush) {
+    if (m_tiles)
+        throw std::runtime_error("ApplyBrush: o terreno em blocos nao pode ser editado.");
+    if (!(brush.Radius > 0.0f)) return TerrainRegion();
+
+    const TerrainRegion region = RegionAround(brush.X, brush.Z, brush.Radius);
+    if (region.Empty()) return region;
+
+    // As alturas novas vao para values e so sao gravadas no final, entao Smooth
+    // le os vizinhos como estavam antes da pincelada.
+    const int regionCols = region.EndJ - region.BeginJ;
+    std::vector<float> values(size_t(region.EndI - region.BeginI) * regionCols);
+    for (int i = region.BeginI; i < region.EndI; i++) {
+        ReadHeightRow(i, region.BeginJ, region.EndJ, values.data() + size_t(i - region.BeginI) * regionCols);
+    }
+    auto old = [&](int i, int j) {
+        return Height(std::clamp(i, 0, verticesPerRow - 1), std::clamp(j, 0, verticesPerCol - 1));
+    };
+
+    const float inner = 1.0f - std::clamp(brush.Falloff, 0.0f, 1.0f);
+    for (int i = region.BeginI; i < region.EndI; i++) {
+        const float dx = OriginX() + i * SpacingX() - brush.X;
+        for (int j = region.BeginJ; j < region.EndJ; j++) {
+            const float dz = OriginZ() + j * SpacingZ() - brush.Z;
+            const float d = std::sqrt(dx * dx + dz * dz) / brush.Radius;
+            if (d >= 1.0f) continue;
+
+            const float weight = 1.0f - SmoothStep(inner, 1.0f, d);
+            float& h = values[size_t(i - region.BeginI) * regionCols + (j - region.BeginJ)];
+            switch (brush.Mode) {
+            case TerrainBrushMode::Raise:
+                h += brush.Strength * weight;
+                break;
+            case TerrainBrushMode::Lower:
+                h -= brush.Strength * weight;
+                break;
+            case TerrainBrushMode::Flatten:
+                h += (brush.TargetHeight - h) * std::min(brush.Strength * weight, 1.0f);
+                break;
+            case TerrainBrushMode::Smooth: {
+                const float average = (old(i - 1, j) + old(i + 1, j) + old(i, j - 1) + old(i, j + 1)) * 0.25f;
+                h += (average - h) * std::min(brush.Strength * weight, 1.0f);
+                break;
+            }
+            }
+        }
+    }
+    return StoreRegion(region, values);
+}
+
+TerrainRegion Terrain::ApplyStamp(const TerrainStamp& stamp, float x, float z, float scale) {
+    if (m_tiles)
+        throw std::runtime_error("ApplyStamp: o terreno em blocos nao pode ser editado.");
+    if (stamp.Rows < 2 || stamp.Cols < 2 || stamp.Heights.size() != size_t(stamp.Rows) * stamp.Cols)
+        throw std::runtime_error("ApplyStamp: o carimbo precisa de pelo menos 2x2 alturas.");
+
+    const TerrainRegion region = RegionAround(x, z, stamp.HalfExtent());
+    if (region.Empty()) return region;
+
+    const int regionCols = region.EndJ - region.BeginJ;
+    std::vector<float> values(size_t(region.EndI - region.BeginI) * regionCols);
+    for (int i = region.BeginI; i < region.EndI; i++) {
+        ReadHeightRow(i, region.BeginJ, region.EndJ, values.data() + size_t(i - region.BeginI) * regionCols);
+    }
+    const float centerI = (stamp.Rows - 1) * 0.5f;
+    const float centerJ = (stamp.Cols - 1) * 0.5f;
+    for (int i = region.BeginI; i < region.EndI; i++) {
+        const float si = (OriginX() + i * SpacingX() - x) / stamp.Spacing + centerI;
+        if (si < 0.0f || si > stamp.Rows - 1) continue;
+        const int ci = std::min(int(si), stamp.Rows - 2);
+        const float fracI = si - ci;
+        for (int j = region.BeginJ; j < region.EndJ; j++) {
+            const float sj = (OriginZ() + j * SpacingZ() - z) / stamp.Spacing + centerJ;
+            if (sj < 0.0f || sj > stamp.Cols - 1) continue;
+            const int cj = std::min(int(sj), stamp.Cols - 2);
+            const float fracJ = sj - cj;
+
+            const float* cell = stamp.Heights.data() + size_t(ci) * stamp.Cols + cj;
+            const float h0 = cell[0] * (1 - fracI) + cell[stamp.Cols] * fracI;
+            const float h1 = cell[1] * (1 - fracI) + cell[stamp.Cols + 1] * fracI;
+            values[size_t(i - region.BeginI) * regionCols + (j - region.BeginJ)] += scale * (h0 * (1 - fracJ) + h1 * fracJ);
+        }
+    }
+    return StoreRegion(region, values);
+}
+
+TerrainRegion Terrain::StoreRegion(const TerrainRegion& region, const std::vector<float>& values) {
+    if (!m_quantized.Empty()) {
+        // So os blocos cuja faixa cresceu mudam (pouco) fora do retangulo editado.
+        TerrainRegion changed = region;
+        const int size = m_quantized.TileSize();
+        for (const auto& [ti, tj] : m_quantized.Store(region.BeginI, region.BeginJ, region.EndI, region.EndJ, values.data())) {
+            TerrainRegion tile;
+            tile.BeginI = ti * size;
+            tile.BeginJ = tj * size;
+            tile.EndI = std::min(tile.BeginI + size, verticesPerRow);
+            tile.EndJ = std::min(tile.BeginJ + size, verticesPerCol);
+            changed.Include(tile);
+        }
+        m_dirty.Include(changed);
+        return changed;
+    }
+
+    const int regionCols = region.EndJ - region.BeginJ;
+    for (int i = region.BeginI; i < region.EndI; i++) {
+        const float* row = values.data() + size_t(i - region.BeginI) * regionCols;
+        std::copy(row, row + regionCols, heightMap.begin() + size_t(i) * verticesPerCol + region.BeginJ);
+    }
+    m_dirty.Include(region);
+    return region;
+}
+
+TerrainRegion Terrain::TakeDirtyRegion() {
+    return std::exchange(m_dirty, TerrainRegion());
+}
+
+void Terrain::Quantize(int tileSize) {
+    if (m_tiles)
+        throw std::runtime_error("Quantize: o terreno em blocos nao guarda as alturas em memoria.");
+    if (!m_quantized.Empty() && m_quantized.TileSize() == tileSize) return;
+
+    if (!m_quantized.Empty()) {
+        heightMap.resize(size_t(verticesPerRow) * verticesPerCol);
+        for (int i = 0; i < verticesPerRow; i++) ReadHeightRow(i, 0, verticesPerCol, heightMap.data() + size_t(i) * verticesPerCol);
+    }
+    m_quantized = QuantizedHeights(heightMap, verticesPerRow, verticesPerCol, tileSize);
+    heightMap.clear();
+    heightMap.shrink_to_fit();
+}
+
+void Terrain::ReadHeightRow(int i, int beginJ, int endJ, float* out) const {
+    if (!m_quantized.Empty()) {
+        m_quantized.DecodeRow(i, beginJ, endJ, out);
+    } else if (!m_tiles) {
+        std::copy(heightMap.begin() + size_t(i) * verticesPerCol + beginJ, heightMap.begin() + size_t(i) * verticesPerCol + endJ, out);
+    } else {
+        for (int j = beginJ; j < endJ; j++) out[j - beginJ] = m_tiles->Height(i, j);
+    }
+}
@@ -0,0 +1,166 @@
+#pragma once
+#include "HeightTiles.h"
+#include "Mesh.h"
+#include "Noise.h"
+#include "QuantizedHeights.h"
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// Saidas de GetSurfacesAt em SoA: um span por componente, do tamanho da entrada.
+struct TerrainSurfaceOutput
+{
+    std::span<float> Height;
+    std::span<float> NormalX;
+    std::span<float> NormalY;
+    std::span<float> NormalZ;
+};
+
+// Retangulo de amostras [BeginI, EndI) x [BeginJ, EndJ).
+struct TerrainRegion
+{
+    int BeginI = 0;
+    int BeginJ = 0;
+    int EndI = 0;
+    int EndJ = 0;
+
+    bool Empty() const { return EndI <= BeginI || EndJ <= BeginJ; }
+    // Cresce para cobrir tambem 'other'.
+    void Include(const TerrainRegion& other);
+};
+
+enum class TerrainBrushMode
+{
+    Raise,
+    Lower,
+    Flatten,   // aproxima de TargetHeight
+    Smooth,    // aproxima da media dos quatro vizinhos
+};
+
+struct TerrainBrush
+{
+    TerrainBrushMode Mode = TerrainBrushMode::Raise;
+    float X = 0.0f;            // centro, em coordenadas de mundo
+    float Z = 0.0f;
+    float Radius = 10.0f;
+    float Strength = 1.0f;     // metros em Raise/Lower; fracao do caminho (0..1) em Flatten/Smooth
+    float TargetHeight = 0.0f;
+    float Falloff = 0.5f;      // fracao do raio, na borda, em que o peso cai suavemente ate 0
+};
+
+// Alturas somadas ao terreno em volta de um ponto, amostradas bilinearmente.
+struct TerrainStamp
+{
+    int Rows = 0;              // amostras em x
+    int Cols = 0;              // amostras em z
+    float Spacing = 1.0f;
+    std::vector<float> Heights;   // [i * Cols + j], com o centro no meio
+
+    float HalfExtent() const { return (std::max(Rows, Cols) - 1) * Spacing * 0.5f; }
+};
+
+// Cratera: bacia de 'depth' ate 'radius' e uma borda elevada de 'rimHeight' em volta.
+TerrainStamp MakeCraterStamp(float radius, float depth, float rimHeight, float spacing);
+
+class Terrain {
+public:
+    float width, depth;
+    int verticesPerRow, verticesPerCol;
+
+    Terrain(float w = 200.0f, float d = 200.0f, int rows = 50, int cols = 50);
+    // Alturas de GenerateHeightMap(noise) em vez do seno.
+    Terrain(float w, float d, int rows, int cols, const NoiseSettings& noise);
+    // Terreno lido de um .xht (ImportRawHeightmap). Os blocos sao mapeados sob demanda
+    // e no maximo memoryBudget bytes ficam residentes; Height, GetHeightAt e
+    // GetHeightsAt funcionam igual, mas Heights() fica vazio.
+    Terrain(const std::string& tilePath, size_t memoryBudget);
+    // Terreno sobre alturas ja quantizadas (por exemplo lidas de um arquivo de QuantizedHeights::Save).
+    Terrain(float w, float d, QuantizedHeights heights);
+
+    void GenerateHeightMap();
+    // Ruido fractal em todas as amostras, em blocos de linhas paralelos e SIMD.
+    void GenerateHeightMap(const NoiseSettings& noise, unsigned threadCount = 0);
+    const NoiseStats& GenerationStats() const { return m_generationStats; }
+    float GetHeightAt(float x, float z) const;
+    // Mesmo resultado de GetHeightAt para cada (x[k], z[k]), 8 pontos por vez.
+    // Os tres spans precisam ter o mesmo tamanho.
+    void GetHeightsAt(std::span<const float> x, std::span<const float> z, std::span<float> out) const;
+    Model GenerateTerrainMesh();
+    // Altura exata do triangulo desenhado (grade e diagonal de GenerateTerrainMesh)
+    // em (x, z) e a normal dessa face, para colisao. Fora do mapa: 0 e (0, 1, 0).
+    float GetSurfaceAt(float x, float z, DirectX::XMFLOAT3& normal) const;
+    // GetSurfaceAt para cada (x[k], z[k]), 8 pontos por vez, sem custo por chamada:
+    // um lote de contatos inteiro de uma vez.
+    void GetSurfacesAt(std::span<const float> x, std::span<const float> z, const TerrainSurfaceOutput& out) const;
+
+    // Normais de todas as amostras por diferencas centrais (de um lado so na borda),
+    // em blocos de linhas paralelos e SIMD. Ficam empacotadas para a GPU: x e z em
+    // snorm16 (x nos 16 bits baixos), e y > 0 sai de sqrt(1 - x^2 - z^2).
+    void ComputeNormals(unsigned threadCount = 0);
+    // Depois de editar as alturas em 'dirty', recalcula so as normais que dependem
+    // delas (a regiao mais uma amostra de cada lado) e devolve essa regiao.
+    TerrainRegion UpdateNormals(const TerrainRegion& dirty, unsigned threadCount = 1);
+    const std::vector<uint32_t>& PackedNormals() const { return normalMap; }
+    // A mesma normal de ComputeNormals, sem o empacotamento.
+    DirectX::XMFLOAT3 NormalAt(int i, int j) const;
+    static DirectX::XMFLOAT3 UnpackNormal(uint32_t packed);
+    static Material GroundMaterial();
+
+    // Edicoes de altura em tempo de execucao. Cada uma devolve as amostras que mudou
+    // e as acumula numa regiao suja; depois das edicoes de um frame, TakeDirtyRegion
+    // entrega essa regiao (para UpdateNormals e o upload parcial) e a esvazia.
+    // Nao disponivel no modo em blocos.
+    TerrainRegion ApplyBrush(const TerrainBrush& brush);
+    TerrainRegion ApplyStamp(const TerrainStamp& stamp, float x, float z, float scale = 1.0f);
+    TerrainRegion TakeDirtyRegion();
+
+    // Troca as alturas em float por codigos de 16 bits com minimo e escala por bloco:
+    // metade da memoria, com erro de ate Quantized().MaxError(). Consultas, normais e
+    // edicoes continuam funcionando e decodificam na hora; Heights() fica vazio.
+    void Quantize(int tileSize = QuantizedHeights::DefaultTileSize);
+    bool IsQuantized() const { return !m_quantized.Empty(); }
+    const QuantizedHeights& Quantized() const { return m_quantized; }
+    // out[k] = Height(i, beginJ + k), em qualquer modo.
+    void ReadHeightRow(int i, int beginJ, int endJ, float* out) const;
+
+    bool IsStreamed() const { return m_tiles != nullptr; }
+    // Deixa residentes os blocos a ate 'radius' de (x, z). Sem efeito fora do modo em blocos.
+    void UpdateResidency(float x, float z, float radius);
+    HeightTileCache* Tiles() const { return m_tiles.get(); }
+    // Copia em memoria com rows x cols amostras cobrindo a mesma area, por interpolacao bilinear.
+    Terrain Resampled(int rows, int cols) const;
+
+    // Grade das amostras, a mesma de GenerateTerrainMesh: a amostra (i, j) fica em
+    // x = OriginX() + i * SpacingX(), z = OriginZ() + j * SpacingZ().
+    float OriginX() const { return -(verticesPerRow / 2.0f) * SpacingX(); }
+    float OriginZ() const { return -(verticesPerCol / 2.0f) * SpacingZ(); }
+    float SpacingX() const { return width / verticesPerRow; }
+    float SpacingZ() const { return depth / verticesPerCol; }
+    float Height(int i, int j) const
+    {
+        if (m_tiles) return m_tiles->Height(i, j);
+        return m_quantized.Empty() ? heightMap[size_t(i) * verticesPerCol + j] : m_quantized.Height(i, j);
+    }
+    // Vazio nos modos em blocos e quantizado.
+    const std::vector<float>& Heights() const { return heightMap; }
+
+private:
+    Terrain(float w, float d, int rows, int cols, std::vector<float> heights);
+    void CellHeights(int i, int j, float& h00, float& h10, float& h01, float& h11) const;
+    void ComputeNormalRows(const TerrainRegion& region, unsigned threadCount);
+    // Amostras a ate 'radius' de (x, z), presas ao mapa.
+    TerrainRegion RegionAround(float x, float z, float radius) const;
+    // Grava values (a regiao linha a linha) no armazenamento atual e marca como suja a
+    // regiao que mudou: quantizado, tambem os blocos inteiros que foram recodificados.
+    TerrainRegion StoreRegion(const TerrainRegion& region, const std::vector<float>& values);
+
+    // Alturas num unico bloco, uma linha (i, eixo x) apos a outra: [i * verticesPerCol + j].
+    std::vector<float> heightMap;
+    std::vector<uint32_t> normalMap;   // mesmo layout de heightMap, vazio ate ComputeNormals
+    QuantizedHeights m_quantized;      // no lugar de heightMap depois de Quantize
+    std::unique_ptr<HeightTileCache> m_tiles;
+    NoiseStats m_generationStats;
+    TerrainRegion m_dirty;
+};
@@ -0,0 +1,296 @@
+#include "pch.h"
+#include "TerrainQuadtree.h"
+#include "Meshlet.h"
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace
+{
+    // O AABB alcanca a esfera (centro, raio)?
+    bool BoundsInRange(const MeshBounds& bounds, const XMFLOAT3& center, float radius)
+    {
+        const float dx = std::max({ bounds.Min.x - center.x, 0.0f, center.x - bounds.Max.x });
+        const float dy = std::max({ bounds.Min.y - center.y, 0.0f, center.y - bounds.Max.y });
+        const float dz = std::max({ bounds.Min.z - center.z, 0.0f, center.z - bounds.Max.z });
+        return dx * dx + dy * dy + dz * dz <= radius * radius;
+    }
+
+    size_t CountQuarters(uint32_t quarterMask)
+    {
+        return (quarterMask & 1) + ((quarterMask >> 1) & 1) + ((quarterMask >> 2) & 1) + ((quarterMask >> 3) & 1);
+    }
+}
+
+TerrainPatchMesh BuildTerrainPatchMesh(int patchQuads)
+{
+    // (q + 1)^2 vertices da grade mais 4q das saias precisam caber em 16 bits.
+    if (patchQuads < 2 || patchQuads % 2 != 0 || patchQuads > 252) {
+        throw std::runtime_error("PatchQuads precisa ser par e estar entre 2 e 252.");
+    }
+
+    TerrainPatchMesh mesh;
+    const int side = patchQuads + 1;
+    mesh.Vertices.reserve(size_t(side) * side + size_t(patchQuads) * 4);
+    for (int i = 0; i < side; ++i) {
+        for (int j = 0; j < side; ++j) {
+            mesh.Vertices.push_back({ { float(i) / patchQuads, float(j) / patchQuads }, 0.0f });
+        }
+    }
+
+    // Copias dos vertices da borda, criadas na primeira vez que uma saia as usa.
+    std::vector<uint16_t> skirtOf(mesh.Vertices.size(), 0);
+    auto skirt = [&](uint16_t vertex) {
+        if (skirtOf[vertex] == 0) {
+            skirtOf[vertex] = uint16_t(mesh.Vertices.size());
+            mesh.Vertices.push_back({ mesh.Vertices[vertex].Grid, 1.0f });
+        }
+        return skirtOf[vertex];
+    };
+    // A aresta p -> q da borda, no sentido em que o triangulo de cima a percorre;
+    // a saia a percorre ao contrario, mantendo a orientacao da superficie.
+    auto addSkirt = [&](int pi, int pj, int qi, int qj) {
+        const uint16_t p = uint16_t(pi * side + pj);
+        const uint16_t q = uint16_t(qi * side + qj);
+        const uint16_t pDown = skirt(p);
+        const uint16_t qDown = skirt(q);
+        mesh.Indices.insert(mesh.Indices.end(), { q, p, pDown, q, pDown, qDown });
+    };
+
+    // Mesma divisao dos quads e mesmo sentido de GenerateTerrainMesh.
+    const int half = patchQuads / 2;
+    mesh.Indices.reserve(size_t(patchQuads) * (patchQuads + 4) * 6);
+    for (int q = 0; q < 4; ++q) {
+        const int i0 = (q & 1) * half;
+        const int j0 = (q >> 1) * half;
+        for (int i = i0; i < i0 + half; ++i) {
+            for (int j = j0; j < j0 + half; ++j) {
+                const uint16_t topLeft = uint16_t(i * side + j);
+                const uint16_t topRight = uint16_t(topLeft + 1);
+                const uint16_t bottomLeft = uint16_t(topLeft + side);
+                const uint16_t bottomRight = uint16_t(bottomLeft + 1);
+                mesh.Indices.insert(mesh.Indices.end(), { topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight });
+            }
+        }
+
+        // Cada quarto toca duas bordas do patch.
+        for (int k = 0; k < half; ++k) {
+            if (j0 == 0) addSkirt(i0 + k, 0, i0 + k + 1, 0);
+            else addSkirt(i0 + k + 1, patchQuads, i0 + k, patchQuads);
+            if (i0 == 0) addSkirt(0, j0 + k + 1, 0, j0 + k);
+            else addSkirt(patchQuads, j0 + k, patchQuads, j0 + k + 1);
+        }
+    }
+    mesh.QuarterIndexCount = unsigned((half * half + 2 * half) * 6);
+    return mesh;
+}
+
+TerrainHeightLayout MakeTerrainHeightLayout(const Terrain& terrain, const TerrainLodSettings& settings)
+{
+    TerrainHeightLayout layout;
+    layout.OriginX = terrain.OriginX();
+    layout.OriginZ = terrain.OriginZ();
+    layout.InvSpacingX = 1.0f / terrain.SpacingX();
+    layout.InvSpacingZ = 1.0f / terrain.SpacingZ();
+    layout.CountX = uint32_t(terrain.verticesPerRow);
+    layout.CountZ = uint32_t(terrain.verticesPerCol);
+    layout.PatchQuads = float(settings.PatchQuads);
+    layout.SkirtDepth = settings.SkirtDepth;
+    return layout;
+}
+
+void TerrainQuadtree::Build(const Terrain& terrain, const TerrainLodSettings& settings)
+{
+    BuildTerrainPatchMesh(settings.PatchQuads);   // so valida PatchQuads
+    if (terrain.verticesPerRow < 2 || terrain.verticesPerCol < 2) {
+        throw std::runtime_error("O terreno precisa de pelo menos 2x2 amostras.");
+    }
+
+    m_settings = settings;
+    m_originX = terrain.OriginX();
+    m_originZ = terrain.OriginZ();
+    m_levels.clear();
+
+    // Folhas: PatchQuads celulas por lado, incluindo as amostras da borda.
+    const int quads = settings.PatchQuads;
+    Level leaves;
+    leaves.NodesX = (terrain.verticesPerRow - 1 + quads - 1) / quads;
+    leaves.NodesZ = (terrain.verticesPerCol - 1 + quads - 1) / quads;
+    leaves.SizeX = quads * terrain.SpacingX();
+    leaves.SizeZ = quads * terrain.SpacingZ();
+    leaves.MinY.resize(size_t(leaves.NodesX) * leaves.NodesZ);
+    leaves.MaxY.resize(leaves.MinY.size());
+    m_levels.push_back(std::move(leaves));
+    for (int x = 0; x < m_levels[0].NodesX; ++x) {
+        for (int z = 0; z < m_levels[0].NodesZ; ++z) ComputeLeafBounds(terrain, x, z);
+    }
+
+    // Sobe ate um unico no cobrir o mapa inteiro.
+    while (m_levels.back().NodesX > 1 || m_levels.back().NodesZ > 1) {
+        const Level& child = m_levels.back();
+        Level parent;
+        parent.NodesX = (child.NodesX + 1) / 2;
+        parent.NodesZ = (child.NodesZ + 1) / 2;
+        parent.SizeX = child.SizeX * 2.0f;
+        parent.SizeZ = child.SizeZ * 2.0f;
+        parent.MinY.resize(size_t(parent.NodesX) * parent.NodesZ);
+        parent.MaxY.resize(parent.MinY.size());
+        m_levels.push_back(std::move(parent));
+        const size_t level = m_levels.size() - 1;
+        for (int x = 0; x < m_levels[level].NodesX; ++x) {
+            for (int z = 0; z < m_levels[level].NodesZ; ++z) ComputeParentBounds(level, x, z);
+        }
+    }
+
+    const float leafSide = std::max(m_levels[0].SizeX, m_levels[0].SizeZ);
+    float previousRange = 0.0f;
+    for (size_t l = 0; l < m_levels.size(); ++l) {
+        Level& level = m_levels[l];
+        level.Range = settings.RangeFactor * leafSide * float(1u << l);
+        level.MorphStart = previousRange + (level.Range - previousRange) * settings.MorphRatio;
+        previousRange = level.Range;
+    }
+}
+
+void TerrainQuadtree::UpdateBounds(const Terrain& terrain, const TerrainRegion& region)
+{
+    if (m_levels.empty() || region.Empty()) return;
+
+    // A folha x cobre as amostras [x * q, (x + 1) * q]; a amostra da borda entre
+    // duas folhas pertence as duas.
+    const int quads = m_settings.PatchQuads;
+    int xBegin = std::max((region.BeginI - 1) / quads, 0);
+    int zBegin = std::max((region.BeginJ - 1) / quads, 0);
+    int xEnd = std::min((region.EndI - 1) / quads, m_levels[0].NodesX - 1);
+    int zEnd = std::min((region.EndJ - 1) / quads, m_levels[0].NodesZ - 1);
+    for (int x = xBegin; x <= xEnd; ++x) {
+        for (int z = zBegin; z <= zEnd; ++z) ComputeLeafBounds(terrain, x, z);
+    }
+    for (size_t level = 1; level < m_levels.size(); ++level) {
+        xBegin /= 2;
+        zBegin /= 2;
+        xEnd /= 2;
+        zEnd /= 2;
+        for (int x = xBegin; x <= xEnd; ++x) {
+            for (int z = zBegin; z <= zEnd; ++z) ComputeParentBounds(level, x, z);
+        }
+    }
+}
+
+void TerrainQuadtree::ComputeLeafBounds(const Terrain& terrain, int x, int z)
+{
+    Level& leaves = m_levels[0];
+    const int quads = m_settings.PatchQuads;
+    const int iEnd = std::min((x + 1) * quads, terrain.verticesPerRow - 1);
+    const int jEnd = std::min((z + 1) * quads, terrain.verticesPerCol - 1);
+    float minY = terrain.Height(x * quads, z * quads);
+    float maxY = minY;
+    for (int i = x * quads; i <= iEnd; ++i) {
+        for (int j = z * quads; j <= jEnd; ++j) {
+            minY = std::min(minY, terrain.Height(i, j));
+            maxY = std::max(maxY, terrain.Height(i, j));
+        }
+    }
+    leaves.MinY[size_t(x) * leaves.NodesZ + z] = minY;
+    leaves.MaxY[size_t(x) * leaves.NodesZ + z] = maxY;
+}
+
+void TerrainQuadtree::ComputeParentBounds(size_t level, int x, int z)
+{
+    const Level& child = m_levels[level - 1];
+    Level& parent = m_levels[level];
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    for (int cx = 2 * x; cx < std::min(2 * x + 2, child.NodesX); ++cx) {
+        for (int cz = 2 * z; cz < std::min(2 * z + 2, child.NodesZ); ++cz) {
+            minY = std::min(minY, child.MinY[size_t(cx) * child.NodesZ + cz]);
+            maxY = std::max(maxY, child.MaxY[size_t(cx) * child.NodesZ + cz]);
+        }
+    }
+    parent.MinY[size_t(x) * parent.NodesZ + z] = minY;
+    parent.MaxY[size_t(x) * parent.NodesZ + z] = maxY;
+}
+
+MeshBounds TerrainQuadtree::NodeBounds(size_t level, int x, int z) const
+{
+    const Level& l = m_levels[level];
+    const size_t node = size_t(x) * l.NodesZ + z;
+    MeshBounds bounds;
+    bounds.Min = { m_originX + x * l.SizeX, l.MinY[node], m_originZ + z * l.SizeZ };
+    bounds.Max = { bounds.Min.x + l.SizeX, l.MaxY[node], bounds.Min.z + l.SizeZ };
+    return bounds;
+}
+
+struct TerrainQuadtree::SelectContext
+{
+    XMFLOAT4 Planes[6];
+    XMFLOAT3 CameraPos;
+    std::vector<TerrainPatch>* Patches;
+    TerrainLodStats* Stats;
+
+    void Add(const TerrainQuadtree& tree, size_t level, int x, int z, uint32_t quarterMask)
+    {
+        const Level& l = tree.m_levels[level];
+        TerrainPatch patch;
+        patch.OriginX = tree.m_originX + x * l.SizeX;
+        patch.OriginZ = tree.m_originZ + z * l.SizeZ;
+        patch.SizeX = l.SizeX;
+        patch.SizeZ = l.SizeZ;
+        patch.MorphStart = l.MorphStart;
+        patch.MorphEnd = l.Range;
+        patch.Lod = uint32_t(level);
+        patch.QuarterMask = quarterMask;
+        Patches->push_back(patch);
+
+        const size_t quarters = CountQuarters(quarterMask);
+        const size_t half = size_t(tree.m_settings.PatchQuads / 2);
+        Stats->Patches++;
+        Stats->Quarters += quarters;
+        Stats->Triangles += quarters * half * half * 2;
+    }
+};
+
+// Retorna false quando o no esta alem da faixa do seu nivel; o pai desenha a
+// area dele com a propria resolucao.
+bool TerrainQuadtree::SelectNode(SelectContext& context, size_t level, int x, int z) const
+{
+    const MeshBounds bounds = NodeBounds(level, x, z);
+    if (BoundsOutside(context.Planes, bounds)) return true;
+    if (!BoundsInRange(bounds, context.CameraPos, m_levels[level].Range)) return false;
+
+    if (level == 0 || !BoundsInRange(bounds, context.CameraPos, m_levels[level - 1].Range)) {
+        context.Add(*this, level, x, z, 0xF);
+        return true;
+    }
+
+    const Level& children = m_levels[level - 1];
+    uint32_t quarterMask = 0;
+    for (uint32_t q = 0; q < 4; ++q) {
+        const int childX = x * 2 + int(q & 1);
+        const int childZ = z * 2 + int(q >> 1);
+        if (childX >= children.NodesX || childZ >= children.NodesZ) continue;   // alem da borda do mapa
+        if (!SelectNode(context, level - 1, childX, childZ)) quarterMask |= 1u << q;
+    }
+    if (quarterMask != 0) context.Add(*this, level, x, z, quarterMask);
+    return true;
+}
+
+void TerrainQuadtree::Select(FXMMATRIX viewProj, const XMFLOAT3& cameraPos,
+    std::vector<TerrainPatch>& patches, TerrainLodStats& stats) const
+{
+    patches.clear();
+    stats = TerrainLodStats();
+    if (m_levels.empty()) return;
+
+    SelectContext context;
+    ExtractFrustumPlanes(viewProj, context.Planes);
+    context.CameraPos = cameraPos;
+    context.Patches = &patches;
+    context.Stats = &stats;
+
+    // A raiz sempre desenha o que nenhum filho cobriu, mesmo fora da sua faixa.
+    const size_t root = m_levels.size() - 1;
+    if (!SelectNode(context, root, 0, 0)) context.Add(*this, root, 0, 0, 0xF);
+}
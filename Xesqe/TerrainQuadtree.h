@@ -0,0 +1,116 @@
+#pragma once
+#include "Terrain.h"
+#include <cstdint>
+#include <vector>
+
+// Terreno em quadtree com LOD continuo (CDLOD, Strugar 2009). Todos os nos usam
+// a mesma grade de PatchQuads x PatchQuads quads; um no de nivel l cobre
+// PatchQuads << l celulas do heightmap. O nivel de cada regiao sai da distancia
+// ate a camera, e perto do fim da faixa de cada LOD os vertices deslizam para a
+// grade do nivel seguinte (no vertex shader), entao nao ha salto nem rachadura.
+// O numero de niveis cresce com o mapa, de modo que os triangulos desenhados
+// dependem da distancia de visao e nao do tamanho do mapa.
+struct TerrainLodSettings
+{
+    int PatchQuads = 32;          // par e no maximo 252, para a grade e as saias caberem em indices de 16 bits
+    float RangeFactor = 2.5f;     // faixa do LOD l = RangeFactor * lado da folha * 2^l
+    float MorphRatio = 0.7f;      // fracao da faixa em que a transicao para o LOD seguinte comeca
+    float SkirtDepth = 2.0f;      // altura das saias, em celulas do patch (cresce com o LOD)
+};
+
+// Um no selecionado, no layout de cbTerrainPatch (terrain_shaders.hlsl).
+struct TerrainPatch
+{
+    float OriginX = 0.0f;
+    float OriginZ = 0.0f;
+    float SizeX = 0.0f;
+    float SizeZ = 0.0f;
+    float MorphStart = 0.0f;
+    float MorphEnd = 0.0f;
+    uint32_t Lod = 0;
+    uint32_t QuarterMask = 0xF;   // quartos da grade a desenhar (bit q = TerrainPatchMesh quarto q)
+};
+
+struct TerrainPatchVertex
+{
+    DirectX::XMFLOAT2 Grid;   // posicao no patch, em [0, 1]^2
+    float Skirt;              // 1 na copia de um vertice da borda que desce como saia
+};
+
+// Grade compartilhada por todos os nos de uma resolucao: a unica malha e o unico
+// indice do terreno, com indices de 16 bits agrupados por quarto (x, z) = (q & 1, q >> 1)
+// para desenhar so parte do no. Cada quarto leva as saias das suas duas bordas
+// externas, que escondem qualquer fresta entre patches vizinhos.
+struct TerrainPatchMesh
+{
+    std::vector<TerrainPatchVertex> Vertices;
+    std::vector<uint16_t> Indices;
+    unsigned int QuarterIndexCount = 0;
+};
+
+TerrainPatchMesh BuildTerrainPatchMesh(int patchQuads);
+
+// Onde ficam as amostras de altura, no layout de cbTerrain (terrain_shaders.hlsl).
+struct TerrainHeightLayout
+{
+    float OriginX = 0.0f;
+    float OriginZ = 0.0f;
+    float InvSpacingX = 0.0f;
+    float InvSpacingZ = 0.0f;
+    uint32_t CountX = 0;
+    uint32_t CountZ = 0;
+    float PatchQuads = 0.0f;
+    float SkirtDepth = 0.0f;
+};
+
+TerrainHeightLayout MakeTerrainHeightLayout(const Terrain& terrain, const TerrainLodSettings& settings);
+
+struct TerrainLodStats
+{
+    size_t Patches = 0;
+    size_t Quarters = 0;
+    size_t Triangles = 0;
+};
+
+class TerrainQuadtree
+{
+public:
+    // Calcula a altura minima e maxima de cada no a partir das amostras de 'terrain'.
+    void Build(const Terrain& terrain, const TerrainLodSettings& settings = TerrainLodSettings());
+
+    // Recalcula a altura minima e maxima das folhas que tocam 'region' e dos seus
+    // ancestrais, depois de editar o terreno.
+    void UpdateBounds(const Terrain& terrain, const TerrainRegion& region);
+
+    // Escolhe os nos a desenhar para a camera em cameraPos, descartando os que
+    // estao fora do frustum de viewProj.
+    void Select(DirectX::FXMMATRIX viewProj, const DirectX::XMFLOAT3& cameraPos,
+        std::vector<TerrainPatch>& patches, TerrainLodStats& stats) const;
+
+    const TerrainLodSettings& Settings() const { return m_settings; }
+    size_t LodCount() const { return m_levels.size(); }
+
+private:
+    struct Level
+    {
+        int NodesX = 0;
+        int NodesZ = 0;
+        float SizeX = 0.0f;     // lado do no em x e z
+        float SizeZ = 0.0f;
+        float Range = 0.0f;
+        float MorphStart = 0.0f;
+        std::vector<float> MinY;
+        std::vector<float> MaxY;
+    };
+
+    struct SelectContext;
+    bool SelectNode(SelectContext& context, size_t level, int x, int z) const;
+    MeshBounds NodeBounds(size_t level, int x, int z) const;
+    void ComputeLeafBounds(const Terrain& terrain, int x, int z);
+    void ComputeParentBounds(size_t level, int x, int z);
+
+    TerrainLodSettings m_settings;
+    float m_originX = 0.0f;
+    float m_originZ = 0.0f;
+    std::vector<Level> m_levels;   // [0] sao as folhas
+};
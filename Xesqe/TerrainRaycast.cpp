@@ -0,0 +1,346 @@
+#include "pch.h"
+#include "TerrainRaycast.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr int RaysPerBlock = 256;
+
+    // Moller-Trumbore dos dois lados; t em unidades da direcao do raio.
+    bool IntersectTriangle(const float origin[3], const float dir[3], const XMFLOAT3& a, const XMFLOAT3& b,
+        const XMFLOAT3& c, float& t)
+    {
+        const float e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+        const float e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+        const float p[3] = { dir[1] * e2[2] - dir[2] * e2[1], dir[2] * e2[0] - dir[0] * e2[2], dir[0] * e2[1] - dir[1] * e2[0] };
+        const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+        if (std::fabs(det) < 1e-12f) return false;
+
+        const float invDet = 1.0f / det;
+        const float s[3] = { origin[0] - a.x, origin[1] - a.y, origin[2] - a.z };
+        const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+        if (u < 0.0f || u > 1.0f) return false;
+
+        const float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+        const float v = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) * invDet;
+        if (v < 0.0f || u + v > 1.0f) return false;
+
+        t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+        return true;
+    }
+
+    XMFLOAT3 UpwardFaceNormal(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c)
+    {
+        const XMVECTOR pa = XMLoadFloat3(&a);
+        XMVECTOR n = XMVector3Normalize(XMVector3Cross(XMVectorSubtract(XMLoadFloat3(&b), pa), XMVectorSubtract(XMLoadFloat3(&c), pa)));
+        if (XMVectorGetY(n) < 0.0f) n = XMVectorNegate(n);
+        XMFLOAT3 normal;
+        XMStoreFloat3(&normal, n);
+        return normal;
+    }
+}
+
+struct TerrainHeightPyramid::RayContext
+{
+    float Origin[3];
+    float Dir[3];
+    float InvDir[3];
+    float MaxT;
+
+    explicit RayContext(const TerrainRay& ray)
+        : Origin{ ray.Origin.x, ray.Origin.y, ray.Origin.z },
+          Dir{ ray.Direction.x, ray.Direction.y, ray.Direction.z },
+          InvDir{}, MaxT(ray.MaxDistance)
+    {
+        for (int a = 0; a < 3; ++a) InvDir[a] = Dir[a] != 0.0f ? 1.0f / Dir[a] : 0.0f;
+    }
+
+    // O trecho [0, MaxT] do raio cruza a caixa [lo, hi]?
+    bool Clip(const float lo[3], const float hi[3]) const
+    {
+        float tNear = 0.0f;
+        float tFar = MaxT;
+        for (int a = 0; a < 3; ++a) {
+            if (Dir[a] == 0.0f) {
+                if (Origin[a] < lo[a] || Origin[a] > hi[a]) return false;
+                continue;
+            }
+            float t0 = (lo[a] - Origin[a]) * InvDir[a];
+            float t1 = (hi[a] - Origin[a]) * InvDir[a];
+            if (t0 > t1) std::swap(t0, t1);
+            tNear = std::max(tNear, t0);
+            tFar = std::min(tFar, t1);
+            if (tNear > tFar) return false;
+        }
+        return true;
+    }
+};
+
+void TerrainHeightPyramid::Build(const Terrain& terrain)
+{
+    if (terrain.verticesPerRow < 2 || terrain.verticesPerCol < 2) {
+        throw std::runtime_error("O terreno precisa de pelo menos 2x2 amostras.");
+    }
+
+    m_terrain = &terrain;
+    m_originX = terrain.OriginX();
+    m_originZ = terrain.OriginZ();
+    m_spacingX = terrain.SpacingX();
+    m_spacingZ = terrain.SpacingZ();
+    m_cellsX = terrain.verticesPerRow - 1;
+    m_cellsZ = terrain.verticesPerCol - 1;
+    m_levels.clear();
+
+    Level leaves;
+    leaves.NodesX = (m_cellsX + LeafCells - 1) / LeafCells;
+    leaves.NodesZ = (m_cellsZ + LeafCells - 1) / LeafCells;
+    leaves.Cells = LeafCells;
+    leaves.MinY.resize(size_t(leaves.NodesX) * leaves.NodesZ);
+    leaves.MaxY.resize(leaves.MinY.size());
+    m_levels.push_back(std::move(leaves));
+    for (int x = 0; x < m_levels[0].NodesX; ++x) {
+        for (int z = 0; z < m_levels[0].NodesZ; ++z) ComputeLeafBounds(x, z);
+    }
+
+    while (m_levels.back().NodesX > 1 || m_levels.back().NodesZ > 1) {
+        Level parent;
+        parent.NodesX = (m_levels.back().NodesX + 1) / 2;
+        parent.NodesZ = (m_levels.back().NodesZ + 1) / 2;
+        parent.Cells = m_levels.back().Cells * 2;
+        parent.MinY.resize(size_t(parent.NodesX) * parent.NodesZ);
+        parent.MaxY.resize(parent.MinY.size());
+        m_levels.push_back(std::move(parent));
+        const size_t level = m_levels.size() - 1;
+        for (int x = 0; x < m_levels[level].NodesX; ++x) {
+            for (int z = 0; z < m_levels[level].NodesZ; ++z) ComputeParentBounds(level, x, z);
+        }
+    }
+}
+
+void TerrainHeightPyramid::Update(const TerrainRegion& region)
+{
+    if (m_levels.empty() || region.Empty()) return;
+
+    // A folha x cobre as amostras [x * LeafCells, (x + 1) * LeafCells].
+    int xBegin = std::max((region.BeginI - 1) / LeafCells, 0);
+    int zBegin = std::max((region.BeginJ - 1) / LeafCells, 0);
+    int xEnd = std::min((region.EndI - 1) / LeafCells, m_levels[0].NodesX - 1);
+    int zEnd = std::min((region.EndJ - 1) / LeafCells, m_levels[0].NodesZ - 1);
+    for (int x = xBegin; x <= xEnd; ++x) {
+        for (int z = zBegin; z <= zEnd; ++z) ComputeLeafBounds(x, z);
+    }
+    for (size_t level = 1; level < m_levels.size(); ++level) {
+        xBegin /= 2;
+        zBegin /= 2;
+        xEnd /= 2;
+        zEnd /= 2;
+        for (int x = xBegin; x <= xEnd; ++x) {
+            for (int z = zBegin; z <= zEnd; ++z) ComputeParentBounds(level, x, z);
+        }
+    }
+}
+
+void TerrainHeightPyramid::ComputeLeafBounds(int x, int z)
+{
+    Level& leaves = m_levels[0];
+    const int iEnd = std::min((x + 1) * LeafCells, m_cellsX);
+    const int jEnd = std::min((z + 1) * LeafCells, m_cellsZ);
+    float minY = m_terrain->Height(x * LeafCells, z * LeafCells);
+    float maxY = minY;
+    for (int i = x * LeafCells; i <= iEnd; ++i) {
+        for (int j = z * LeafCells; j <= jEnd; ++j) {
+            const float h = m_terrain->Height(i, j);
+            minY = std::min(minY, h);
+            maxY = std::max(maxY, h);
+        }
+    }
+    leaves.MinY[size_t(x) * leaves.NodesZ + z] = minY;
+    leaves.MaxY[size_t(x) * leaves.NodesZ + z] = maxY;
+}
+
+void TerrainHeightPyramid::ComputeParentBounds(size_t level, int x, int z)
+{
+    const Level& child = m_levels[level - 1];
+    Level& parent = m_levels[level];
+    float minY = FLT_MAX;
+    float maxY = -FLT_MAX;
+    for (int cx = 2 * x; cx < std::min(2 * x + 2, child.NodesX); ++cx) {
+        for (int cz = 2 * z; cz < std::min(2 * z + 2, child.NodesZ); ++cz) {
+            minY = std::min(minY, child.MinY[size_t(cx) * child.NodesZ + cz]);
+            maxY = std::max(maxY, child.MaxY[size_t(cx) * child.NodesZ + cz]);
+        }
+    }
+    parent.MinY[size_t(x) * parent.NodesZ + z] = minY;
+    parent.MaxY[size_t(x) * parent.NodesZ + z] = maxY;
+}
+
+TerrainHit TerrainHeightPyramid::Raycast(const TerrainRay& ray) const
+{
+    TerrainHit hit;
+    if (m_levels.empty() || !(ray.MaxDistance >= 0.0f)) return hit;
+    const RayContext context(ray);
+    Traverse(context, m_levels.size() - 1, 0, 0, hit);
+    return hit;
+}
+
+unsigned TerrainHeightPyramid::Raycast(std::span<const TerrainRay> rays, std::span<TerrainHit> hits, unsigned threadCount) const
+{
+    if (hits.size() != rays.size())
+        throw std::runtime_error("Raycast: rays e hits precisam ter o mesmo tamanho.");
+
+    const int blockCount = int((rays.size() + RaysPerBlock - 1) / RaysPerBlock);
+    return ParallelForBlocks(blockCount, threadCount, [&](int block) {
+        const size_t end = std::min(rays.size(), size_t(block + 1) * RaysPerBlock);
+        for (size_t k = size_t(block) * RaysPerBlock; k < end; ++k) hits[k] = Raycast(rays[k]);
+    });
+}
+
+bool TerrainHeightPyramid::Traverse(const RayContext& ray, size_t level, int x, int z, TerrainHit& hit) const
+{
+    const Level& l = m_levels[level];
+    const size_t node = size_t(x) * l.NodesZ + z;
+    const float lo[3] = { m_originX + x * l.Cells * m_spacingX, l.MinY[node], m_originZ + z * l.Cells * m_spacingZ };
+    const float hi[3] = { m_originX + std::min((x + 1) * l.Cells, m_cellsX) * m_spacingX, l.MaxY[node],
+        m_originZ + std::min((z + 1) * l.Cells, m_cellsZ) * m_spacingZ };
+    if (!ray.Clip(lo, hi)) return false;
+    if (level == 0) return IntersectLeaf(ray, x, z, hit);
+
+    // Os filhos na ordem em que o raio os cruza em x e z: o quarto de perto, os
+    // dois do meio (ele cruza no maximo um) e o de longe. Como os filhos nao se
+    // sobrepoem em x e z, o primeiro acerto e o mais proximo.
+    const Level& child = m_levels[level - 1];
+    const int nearX = ray.Dir[0] < 0.0f ? 1 : 0;
+    const int nearZ = ray.Dir[2] < 0.0f ? 1 : 0;
+    const int order[4][2] = { { nearX, nearZ }, { 1 - nearX, nearZ }, { nearX, 1 - nearZ }, { 1 - nearX, 1 - nearZ } };
+    for (const auto& quarter : order) {
+        const int cx = 2 * x + quarter[0];
+        const int cz = 2 * z + quarter[1];
+        if (cx < child.NodesX && cz < child.NodesZ && Traverse(ray, level - 1, cx, cz, hit)) return true;
+    }
+    return false;
+}
+
+bool TerrainHeightPyramid::IntersectLeaf(const RayContext& ray, int x, int z, TerrainHit& hit) const
+{
+    // As amostras da folha uma vez so: (LeafCells + 1)^2 pontos.
+    const int i0 = x * LeafCells;
+    const int j0 = z * LeafCells;
+    const int cellsI = std::min(i0 + LeafCells, m_cellsX) - i0;
+    const int cellsJ = std::min(j0 + LeafCells, m_cellsZ) - j0;
+    XMFLOAT3 points[LeafCells + 1][LeafCells + 1];
+    for (int i = 0; i <= cellsI; ++i) {
+        for (int j = 0; j <= cellsJ; ++j) {
+            points[i][j] = { m_originX + (i0 + i) * m_spacingX, m_terrain->Height(i0 + i, j0 + j), m_originZ + (j0 + j) * m_spacingZ };
+        }
+    }
+
+    // Poucas celulas por folha: testa as que o raio cruza e fica com a mais proxima.
+    float best = ray.MaxT;
+    XMFLOAT3 bestTriangle[3];
+    bool found = false;
+    for (int i = 0; i < cellsI; ++i) {
+        for (int j = 0; j < cellsJ; ++j) {
+            // Mesma divisao de GenerateTerrainMesh: diagonal de (i + 1, j) a (i, j + 1).
+            const XMFLOAT3& topLeft = points[i][j];
+            const XMFLOAT3& bottomLeft = points[i + 1][j];
+            const XMFLOAT3& topRight = points[i][j + 1];
+            const XMFLOAT3& bottomRight = points[i + 1][j + 1];
+            const float lo[3] = { topLeft.x, std::min({ topLeft.y, bottomLeft.y, topRight.y, bottomRight.y }), topLeft.z };
+            const float hi[3] = { bottomRight.x, std::max({ topLeft.y, bottomLeft.y, topRight.y, bottomRight.y }), bottomRight.z };
+            if (!ray.Clip(lo, hi)) continue;
+
+            const XMFLOAT3 triangles[2][3] = { { topLeft, bottomLeft, topRight }, { topRight, bottomLeft, bottomRight } };
+            for (const auto& triangle : triangles) {
+                float t;
+                if (IntersectTriangle(ray.Origin, ray.Dir, triangle[0], triangle[1], triangle[2], t) && t >= 0.0f && t <= best) {
+                    best = t;
+                    std::copy(std::begin(triangle), std::end(triangle), bestTriangle);
+                    found = true;
+                }
+            }
+        }
+    }
+    if (!found) return false;
+
+    hit.Hit = true;
+    hit.Distance = best;
+    hit.Position = { ray.Origin[0] + best * ray.Dir[0], ray.Origin[1] + best * ray.Dir[1], ray.Origin[2] + best * ray.Dir[2] };
+    hit.Normal = UpwardFaceNormal(bestTriangle[0], bestTriangle[1], bestTriangle[2]);
+    return true;
+}
+
+std::string TerrainRaycastBenchmarkResult::ToString() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    for (const TerrainRaycastBenchmarkRun& run : Runs) {
+        ss << run.Samples << "x" << run.Samples << ": piramide em " << run.BuildSeconds * 1000.0 << " ms, "
+            << run.Rays << " raios, " << run.Hits << " acertos\n";
+        ss << "  um a um: " << run.SingleRaysPerSecond() / 1e6 << " M raios/s\n";
+        ss << "  lote (" << run.Threads << " threads): " << run.BatchRaysPerSecond() / 1e6 << " M raios/s ("
+            << (run.BatchMatches ? "igual ao um a um" : "DIFERENTE do um a um") << ")\n";
+    }
+    return ss.str();
+}
+
+TerrainRaycastBenchmarkResult BenchmarkTerrainRaycasts(std::span<const int> mapSamples, size_t rayCount)
+{
+    using Clock = std::chrono::steady_clock;
+
+    TerrainRaycastBenchmarkResult result;
+    for (int samples : mapSamples) {
+        NoiseSettings noise;
+        noise.Amplitude = 60.0f;
+        const float extent = float(samples);   // uma unidade entre amostras
+        const Terrain terrain(extent, extent, samples, samples, noise);
+
+        TerrainRaycastBenchmarkRun run;
+        run.Samples = samples;
+        run.Rays = rayCount;
+
+        auto t0 = Clock::now();
+        TerrainHeightPyramid pyramid;
+        pyramid.Build(terrain);
+        run.BuildSeconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+        // Raios de cima do relevo, em qualquer direcao, de quase vertical a quase rasante.
+        std::mt19937 rng(1234);
+        std::uniform_real_distribution<float> across(0.0f, float(samples - 1));
+        std::uniform_real_distribution<float> height(100.0f, 200.0f);
+        std::uniform_real_distribution<float> yaw(0.0f, XM_2PI);
+        std::uniform_real_distribution<float> pitch(XMConvertToRadians(2.0f), XM_PIDIV2);
+        std::vector<TerrainRay> rays(rayCount);
+        for (TerrainRay& ray : rays) {
+            const float a = yaw(rng);
+            const float b = pitch(rng);
+            ray.Origin = { terrain.OriginX() + across(rng), height(rng), terrain.OriginZ() + across(rng) };
+            ray.Direction = { std::cos(b) * std::cos(a), -std::sin(b), std::cos(b) * std::sin(a) };
+        }
+
+        std::vector<TerrainHit> single(rayCount);
+        t0 = Clock::now();
+        for (size_t k = 0; k < rayCount; ++k) single[k] = pyramid.Raycast(rays[k]);
+        run.SingleSeconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+        std::vector<TerrainHit> batch(rayCount);
+        t0 = Clock::now();
+        run.Threads = pyramid.Raycast(rays, batch);
+        run.BatchSeconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+        run.BatchMatches = std::equal(single.begin(), single.end(), batch.begin(), [](const TerrainHit& a, const TerrainHit& b) {
+            return a.Hit == b.Hit && a.Distance == b.Distance;
+        });
+        run.Hits = size_t(std::count_if(single.begin(), single.end(), [](const TerrainHit& h) { return h.Hit; }));
+        result.Runs.push_back(run);
+    }
+    return result;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "Terrain.h"
+#include <cfloat>
+#include <span>
+#include <string>
+#include <vector>
+
+struct TerrainRay
+{
+    DirectX::XMFLOAT3 Origin = { 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 Direction = { 0.0f, -1.0f, 0.0f };   // nao precisa ser unitaria
+    float MaxDistance = FLT_MAX;                          // em unidades de Direction
+};
+
+struct TerrainHit
+{
+    bool Hit = false;
+    float Distance = 0.0f;   // Origin + Distance * Direction = Position
+    DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+    DirectX::XMFLOAT3 Normal = { 0.0f, 1.0f, 0.0f };   // do triangulo atingido, para cima
+};
+
+// Piramide de altura minima e maxima sobre as celulas do terreno, para raios
+// contra a mesma superficie que e desenhada: os dois triangulos de cada celula
+// de GenerateTerrainMesh, na grade OriginX/SpacingX. O nivel 0 guarda blocos de
+// LeafCells x LeafCells celulas e cada nivel acima junta 2x2 do anterior. O raio
+// desce so nos nos cuja caixa ele atravessa, na ordem em que os cruza, e para no
+// primeiro acerto.
+class TerrainHeightPyramid
+{
+public:
+    static constexpr int LeafCells = 4;
+
+    // O terreno precisa viver mais que a piramide. Funciona tambem no modo em
+    // blocos, mas cada celula testada passa pelo cache de blocos.
+    void Build(const Terrain& terrain);
+    // Depois de editar as alturas em 'region', atualiza os nos que a tocam.
+    void Update(const TerrainRegion& region);
+
+    TerrainHit Raycast(const TerrainRay& ray) const;
+    // hits[k] = Raycast(rays[k]), com os raios divididos em blocos entre
+    // threadCount threads (0 = todos os nucleos). Devolve quantas threads usou.
+    unsigned Raycast(std::span<const TerrainRay> rays, std::span<TerrainHit> hits, unsigned threadCount = 0) const;
+
+    size_t LevelCount() const { return m_levels.size(); }
+
+private:
+    struct Level
+    {
+        int NodesX = 0;
+        int NodesZ = 0;
+        int Cells = 0;   // celulas por lado de um no
+        std::vector<float> MinY;
+        std::vector<float> MaxY;
+    };
+
+    struct RayContext;
+    bool Traverse(const RayContext& ray, size_t level, int x, int z, TerrainHit& hit) const;
+    bool IntersectLeaf(const RayContext& ray, int x, int z, TerrainHit& hit) const;
+    void ComputeLeafBounds(int x, int z);
+    void ComputeParentBounds(size_t level, int x, int z);
+
+    const Terrain* m_terrain = nullptr;
+    float m_originX = 0.0f;
+    float m_originZ = 0.0f;
+    float m_spacingX = 1.0f;
+    float m_spacingZ = 1.0f;
+    int m_cellsX = 0;
+    int m_cellsZ = 0;
+    std::vector<Level> m_levels;   // [0] sao as folhas, o ultimo e a raiz
+};
+
+struct TerrainRaycastBenchmarkRun
+{
+    int Samples = 0;           // o mapa tem Samples x Samples amostras
+    size_t Rays = 0;
+    size_t Hits = 0;
+    double BuildSeconds = 0.0;
+    double SingleSeconds = 0.0;
+    double BatchSeconds = 0.0;
+    unsigned Threads = 0;
+    bool BatchMatches = false;
+
+    double SingleRaysPerSecond() const { return SingleSeconds > 0.0 ? Rays / SingleSeconds : 0.0; }
+    double BatchRaysPerSecond() const { return BatchSeconds > 0.0 ? Rays / BatchSeconds : 0.0; }
+};
+
+struct TerrainRaycastBenchmarkResult
+{
+    std::vector<TerrainRaycastBenchmarkRun> Runs;
+    std::string ToString() const;
+};
+
+// Para cada tamanho de mapa gera um terreno de ruido, monta a piramide e mede
+// rayCount raios aleatorios (de cima, do ingreme ao rasante) um a um e em lote.
+TerrainRaycastBenchmarkResult BenchmarkTerrainRaycasts(std::span<const int> mapSamples, size_t rayCount = 200000);
@@ -0,0 +1,44 @@
+#pragma once
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Threads fixas consumindo uma fila de tarefas, para os carregamentos em
+// segundo plano. "co_await pool.Schedule()" continua a corrotina numa delas.
+class ThreadPool
+{
+public:
+    // threadCount == 0 usa os nucleos menos um (a thread da janela), no minimo 1.
+    explicit ThreadPool(unsigned threadCount = 0);
+    ThreadPool(const ThreadPool& rhs) = delete;
+    ThreadPool& operator=(const ThreadPool& rhs) = delete;
+    // Executa o que ainda estiver na fila (inclusive tarefas postadas por elas) e junta as threads.
+    ~ThreadPool();
+
+    void Post(std::function<void()> job);
+
+    struct ScheduleAwaiter
+    {
+        ThreadPool& Pool;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { Pool.Post([handle]() { handle.resume(); }); }
+        void await_resume() const noexcept {}
+    };
+    ScheduleAwaiter Schedule() { return { *this }; }
+
+    size_t ThreadCount() const { return m_threads.size(); }
+
+private:
+    void WorkerLoop();
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};
@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "UploadQueue.h"
+#include <cstring>
+
+UploadQueue::UploadQueue(ID3D12Device* device, ThreadPool& pool) : m_device(device), m_pool(pool)
+{
+    D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+    queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+    queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+    ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_queue)));
+    ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY, IID_PPV_ARGS(&m_allocator)));
+    ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY, m_allocator.Get(), nullptr, IID_PPV_ARGS(&m_commandList)));
+    ThrowIfFailed(m_commandList->Close());
+    ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+
+    m_fenceEvent = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+    if (!m_fenceEvent) throw std::runtime_error("Nao foi possivel criar o evento da fila de copia");
+}
+
+UploadQueue::~UploadQueue()
+{
+    if (m_fence->GetCompletedValue() < m_fenceValue) {
+        m_fence->SetEventOnCompletion(m_fenceValue, m_fenceEvent);
+        WaitForSingleObject(m_fenceEvent, INFINITE);
+    }
+    CloseHandle(m_fenceEvent);
+}
+
+Task<void> UploadQueue::UploadBuffers(std::vector<BufferUpload>& uploads)
+{
+    co_await m_pool.Schedule();
+
+    // Criacao de recursos e o memcpy para o heap de upload rodam em paralelo entre cargas.
+    std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> staging(uploads.size());
+    auto heapPropsDefault = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+    auto heapPropsUpload = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+    for (size_t i = 0; i < uploads.size(); ++i) {
+        auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uploads[i].Size);
+        ThrowIfFailed(m_device->CreateCommittedResource(&heapPropsDefault, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+            D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&uploads[i].Resource)));
+        ThrowIfFailed(m_device->CreateCommittedResource(&heapPropsUpload, D3D12_HEAP_FLAG_NONE, &bufferDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&staging[i])));
+
+        void* mapped = nullptr;
+        const CD3DX12_RANGE noRead(0, 0);
+        ThrowIfFailed(staging[i]->Map(0, &noRead, &mapped));
+        std::memcpy(mapped, uploads[i].Data, static_cast<size_t>(uploads[i].Size));
+        staging[i]->Unmap(0, nullptr);
+    }
+
+    // A espera pela fence ocupa esta thread do pool so durante a copia na GPU.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ThrowIfFailed(m_allocator->Reset());
+    ThrowIfFailed(m_commandList->Reset(m_allocator.Get(), nullptr));
+    for (size_t i = 0; i < uploads.size(); ++i) {
+        m_commandList->CopyBufferRegion(uploads[i].Resource.Get(), 0, staging[i].Get(), 0, uploads[i].Size);
+    }
+    ThrowIfFailed(m_commandList->Close());
+
+    ID3D12CommandList* cmdsLists[] = { m_commandList.Get() };
+    m_queue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+    ThrowIfFailed(m_queue->Signal(m_fence.Get(), ++m_fenceValue));
+    if (m_fence->GetCompletedValue() < m_fenceValue) {
+        ThrowIfFailed(m_fence->SetEventOnCompletion(m_fenceValue, m_fenceEvent));
+        WaitForSingleObject(m_fenceEvent, INFINITE);
+    }
+}
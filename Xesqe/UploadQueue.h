@@ -0,0 +1,40 @@
+#pragma once
+#include "Task.h"
+#include "ThreadPool.h"
+#include <mutex>
+#include <vector>
+
+// Fila de copia propria (D3D12_COMMAND_LIST_TYPE_COPY) para as threads de
+// carregamento enviarem buffers a GPU sem passar pela command list do frame.
+class UploadQueue
+{
+public:
+    UploadQueue(ID3D12Device* device, ThreadPool& pool);
+    UploadQueue(const UploadQueue& rhs) = delete;
+    UploadQueue& operator=(const UploadQueue& rhs) = delete;
+    ~UploadQueue();
+
+    struct BufferUpload
+    {
+        const void* Data = nullptr;
+        UINT64 Size = 0;
+        Microsoft::WRL::ComPtr<ID3D12Resource> Resource;   // preenchido pelo upload
+    };
+
+    // Cria um buffer DEFAULT por item e copia os dados; so retoma quando a GPU
+    // terminar a copia. Os buffers ficam em COMMON e sao promovidos implicitamente
+    // no primeiro uso pela fila de desenho, entao nao precisam de barreira.
+    // Os dados precisam continuar validos ate o co_await retornar.
+    Task<void> UploadBuffers(std::vector<BufferUpload>& uploads);
+
+private:
+    ID3D12Device* m_device = nullptr;
+    ThreadPool& m_pool;
+    Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_queue;
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_allocator;
+    Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_commandList;
+    Microsoft::WRL::ComPtr<ID3D12Fence> m_fence;
+    UINT64 m_fenceValue = 0;
+    HANDLE m_fenceEvent = nullptr;
+    std::mutex m_mutex;   // uma copia por vez na command list
+};
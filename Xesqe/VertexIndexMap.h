@@ -0,0 +1,103 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tabela hash de enderecamento aberto (sondagem linear) que associa o trio
+// (v, vt, vn) de um canto de face ao indice do vertice gerado.
+// Os slots ficam num unico vetor contiguo, sem alocacao por entrada.
+class VertexIndexMap
+{
+public:
+    struct Key
+    {
+        int v, vt, vn;
+    };
+
+    explicit VertexIndexMap(size_t expectedCount = 0)
+    {
+        Reserve(expectedCount);
+    }
+
+    // Garante espaco para 'count' entradas sem rehash.
+    void Reserve(size_t count)
+    {
+        size_t capacity = 16;
+        while (capacity * MaxLoadNum < count * MaxLoadDen) capacity *= 2;
+        if (capacity > m_slots.size()) Rehash(capacity);
+    }
+
+    // Retorna o indice associado a 'key'. Se a chave nao existir, associa
+    // 'newIndex' a ela e marca 'inserted'.
+    unsigned int FindOrInsert(const Key& key, unsigned int newIndex, bool& inserted)
+    {
+        if ((m_count + 1) * MaxLoadDen > m_slots.size() * MaxLoadNum) Rehash(m_slots.size() * 2);
+
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = Hash(key) & mask;; i = (i + 1) & mask) {
+            Slot& slot = m_slots[i];
+            if (slot.v == EmptySlot) {
+                slot = { key.v, key.vt, key.vn, newIndex };
+                m_count++;
+                inserted = true;
+                return newIndex;
+            }
+            if (slot.v == key.v && slot.vt == key.vt && slot.vn == key.vn) {
+                inserted = false;
+                return slot.index;
+            }
+        }
+    }
+
+    // Esvazia a tabela mantendo a capacidade.
+    void Clear()
+    {
+        for (Slot& slot : m_slots) slot.v = EmptySlot;
+        m_count = 0;
+    }
+
+    size_t Size() const { return m_count; }
+    size_t MemoryBytes() const { return m_slots.capacity() * sizeof(Slot); }
+
+private:
+    // v nunca e negativo numa chave valida, entao -1 marca slot livre.
+    static constexpr int EmptySlot = -1;
+    static constexpr size_t MaxLoadNum = 7;
+    static constexpr size_t MaxLoadDen = 10;
+
+    struct Slot
+    {
+        int v, vt, vn;
+        unsigned int index;
+    };
+
+    static size_t Hash(const Key& key)
+    {
+        uint64_t h = static_cast<uint32_t>(key.v) | (static_cast<uint64_t>(static_cast<uint32_t>(key.vt)) << 32);
+        h ^= static_cast<uint64_t>(static_cast<uint32_t>(key.vn)) * 0x9E3779B97F4A7C15ull;
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+
+    void Rehash(size_t capacity)
+    {
+        std::vector<Slot> old;
+        old.swap(m_slots);
+        m_slots.assign(capacity, Slot{ EmptySlot, 0, 0, 0 });
+
+        size_t mask = capacity - 1;
+        for (const Slot& slot : old) {
+            if (slot.v == EmptySlot) continue;
+            size_t i = Hash({ slot.v, slot.vt, slot.vn }) & mask;
+            while (m_slots[i].v != EmptySlot) i = (i + 1) & mask;
+            m_slots[i] = slot;
+        }
+    }
+
+    std::vector<Slot> m_slots;
+    size_t m_count = 0;
+};
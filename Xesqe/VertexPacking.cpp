@@ -0,0 +1,146 @@
+#include "pch.h"
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+    float Saturate(float x)
+    {
+        return std::min(std::max(x, 0.0f), 1.0f);
+    }
+
+    uint16_t ToUnorm16(float x)
+    {
+        return static_cast<uint16_t>(std::lround(Saturate(x) * 65535.0f));
+    }
+
+    int16_t ToSnorm16(float x)
+    {
+        return static_cast<int16_t>(std::lround(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f));
+    }
+
+    // Mesma conversao da GPU: -32768 e -32767 viram -1.
+    float FromSnorm16(int16_t x)
+    {
+        return std::max(x / 32767.0f, -1.0f);
+    }
+
+    float SignNotZero(float x)
+    {
+        return x >= 0.0f ? 1.0f : -1.0f;
+    }
+
+    const float NormalAngleBound = 0.0001f;
+}
+
+VertexQuantization MakeVertexQuantization(const MeshBounds& bounds)
+{
+    VertexQuantization quantization;
+    quantization.Scale = { bounds.Max.x - bounds.Min.x, bounds.Max.y - bounds.Min.y, bounds.Max.z - bounds.Min.z, 0.0f };
+    quantization.Bias = { bounds.Min.x, bounds.Min.y, bounds.Min.z, 0.0f };
+    return quantization;
+}
+
+DirectX::XMFLOAT2 EncodeOctahedral(const DirectX::XMFLOAT3& normal)
+{
+    const float sum = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+    if (sum == 0.0f) return { 0.0f, 0.0f };
+
+    float x = normal.x / sum;
+    float y = normal.y / sum;
+    if (normal.z < 0.0f) {
+        const float foldedX = (1.0f - std::fabs(y)) * SignNotZero(x);
+        const float foldedY = (1.0f - std::fabs(x)) * SignNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+    return { x, y };
+}
+
+DirectX::XMFLOAT3 DecodeOctahedral(const DirectX::XMFLOAT2& encoded)
+{
+    float x = encoded.x;
+    float y = encoded.y;
+    const float z = 1.0f - std::fabs(x) - std::fabs(y);
+    const float t = Saturate(-z);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+
+    const float length = std::sqrt(x * x + y * y + z * z);
+    return { x / length, y / length, z / length };
+}
+
+PackedVertex PackVertex(const Vertex& vertex, const VertexQuantization& quantization)
+{
+    const VertexQuantization& q = quantization;
+    PackedVertex packed;
+    packed.Pos[0] = q.Scale.x > 0.0f ? ToUnorm16((vertex.Pos.x - q.Bias.x) / q.Scale.x) : 0;
+    packed.Pos[1] = q.Scale.y > 0.0f ? ToUnorm16((vertex.Pos.y - q.Bias.y) / q.Scale.y) : 0;
+    packed.Pos[2] = q.Scale.z > 0.0f ? ToUnorm16((vertex.Pos.z - q.Bias.z) / q.Scale.z) : 0;
+    packed.Pos[3] = 0;
+
+    const DirectX::XMFLOAT2 octahedral = EncodeOctahedral(vertex.Normal);
+    packed.Normal[0] = ToSnorm16(octahedral.x);
+    packed.Normal[1] = ToSnorm16(octahedral.y);
+    return packed;
+}
+
+Vertex UnpackVertex(const PackedVertex& vertex, const VertexQuantization& quantization)
+{
+    const VertexQuantization& q = quantization;
+    Vertex unpacked;
+    unpacked.Pos = {
+        q.Bias.x + vertex.Pos[0] / 65535.0f * q.Scale.x,
+        q.Bias.y + vertex.Pos[1] / 65535.0f * q.Scale.y,
+        q.Bias.z + vertex.Pos[2] / 65535.0f * q.Scale.z
+    };
+    unpacked.Normal = DecodeOctahedral({ FromSnorm16(vertex.Normal[0]), FromSnorm16(vertex.Normal[1]) });
+    return unpacked;
+}
+
+void PackVertices(const Vertex* vertices, size_t count, const VertexQuantization& quantization, std::vector<PackedVertex>& out)
+{
+    out.resize(count);
+    for (size_t i = 0; i < count; ++i) out[i] = PackVertex(vertices[i], quantization);
+}
+
+bool VertexPackingError::WithinBounds() const
+{
+    return MaxPositionError <= 1.0f && MaxNormalAngle <= NormalAngleBound;
+}
+
+VertexPackingError MeasureVertexPackingError(const Vertex* vertices, size_t count, const VertexQuantization& quantization)
+{
+    VertexPackingError error;
+    const float* scale = &quantization.Scale.x;
+    const float* bias = &quantization.Bias.x;
+
+    for (size_t i = 0; i < count; ++i) {
+        const Vertex& original = vertices[i];
+        const Vertex decoded = UnpackVertex(PackVertex(original, quantization), quantization);
+
+        const float* p0 = &original.Pos.x;
+        const float* p1 = &decoded.Pos.x;
+        for (int axis = 0; axis < 3; ++axis) {
+            // Meio passo de quantizacao mais o arredondamento do float na decodificacao.
+            const float bound = scale[axis] / 65535.0f * 0.5f +
+                4.0f * FLT_EPSILON * (std::fabs(bias[axis]) + std::fabs(scale[axis]));
+            const float delta = std::fabs(p0[axis] - p1[axis]);
+            if (bound > 0.0f) error.MaxPositionError = std::max(error.MaxPositionError, delta / bound);
+        }
+
+        const DirectX::XMFLOAT3& n0 = original.Normal;
+        if (n0.x != 0.0f || n0.y != 0.0f || n0.z != 0.0f) {
+            // atan2(|a x b|, a . b) e preciso para angulos pequenos, ao contrario de acos.
+            const DirectX::XMFLOAT3& n1 = decoded.Normal;
+            const float cx = n0.y * n1.z - n0.z * n1.y;
+            const float cy = n0.z * n1.x - n0.x * n1.z;
+            const float cz = n0.x * n1.y - n0.y * n1.x;
+            const float angle = std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), n0.x * n1.x + n0.y * n1.y + n0.z * n1.z);
+            error.MaxNormalAngle = std::max(error.MaxNormalAngle, angle);
+        }
+    }
+    return error;
+}
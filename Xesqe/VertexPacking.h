@@ -0,0 +1,44 @@
+#pragma once
+#include "Mesh.h"
+#include <cstdint>
+
+// Formato de vertice da GPU (12 bytes em vez dos 24 de Vertex). Vertex continua
+// sendo o formato de trabalho na CPU; a conversao acontece no upload e no .xmesh.
+// O material vem da tabela do modelo, por faixa de desenho.
+struct PackedVertex
+{
+    uint16_t Pos[4];        // R16G16B16A16_UNORM, relativo ao AABB da mesh (w sem uso)
+    int16_t Normal[2];      // R16G16_SNORM, normal em codificacao octaedrica
+};
+static_assert(sizeof(PackedVertex) == 12, "PackedVertex deve ter 12 bytes");
+
+// Posicao = Bias + Pos * Scale por eixo. Mesmo layout do cbuffer cbQuantization
+// do pbr_shaders.hlsl (8 constantes de 32 bits).
+struct VertexQuantization
+{
+    DirectX::XMFLOAT4 Scale = { 1.0f, 1.0f, 1.0f, 0.0f };
+    DirectX::XMFLOAT4 Bias = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+VertexQuantization MakeVertexQuantization(const MeshBounds& bounds);
+
+// Normal unitaria <-> octaedro em [-1, 1]^2.
+DirectX::XMFLOAT2 EncodeOctahedral(const DirectX::XMFLOAT3& normal);
+DirectX::XMFLOAT3 DecodeOctahedral(const DirectX::XMFLOAT2& encoded);
+
+PackedVertex PackVertex(const Vertex& vertex, const VertexQuantization& quantization);
+Vertex UnpackVertex(const PackedVertex& vertex, const VertexQuantization& quantization);
+void PackVertices(const Vertex* vertices, size_t count, const VertexQuantization& quantization, std::vector<PackedVertex>& out);
+
+// Maior erro de ida e volta encontrado. Os limites teoricos sao:
+// posicao <= Scale / 65535 / 2 por eixo (mais o arredondamento do float)
+// e normal < 0.0001 rad (passo de 2 / 32767 no octaedro).
+struct VertexPackingError
+{
+    float MaxPositionError = 0.0f;   // maior erro relativo ao limite do eixo (<= 1 esta dentro)
+    float MaxNormalAngle = 0.0f;     // radianos
+
+    bool WithinBounds() const;
+};
+
+VertexPackingError MeasureVertexPackingError(const Vertex* vertices, size_t count, const VertexQuantization& quantization);
@@ -1,8 +1,10 @@
 #include "pch.h"
 #include "Application.h"
 #include "Exception.h"
+#include "ObjLoader.h"
+#include "TerrainRaycast.h"
 
-int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
+int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int)
 {
 #if defined(DEBUG) || defined(_DEBUG)
     _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
@@ -10,6 +12,33 @@ int CALLBACK WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
 
     try
     {
+        // Xesqe.exe --bench-obj [arquivo.obj] compara os parsers de OBJ e sai.
+        const std::string cmdLine = lpCmdLine ? lpCmdLine : "";
+        const std::string benchObjFlag = "--bench-obj";
+        if (cmdLine.compare(0, benchObjFlag.size(), benchObjFlag) == 0)
+        {
+            std::string path = cmdLine.substr(benchObjFlag.size());
+            path.erase(0, path.find_first_not_of(" \t\""));
+            path.erase(path.find_last_not_of(" \t\"") + 1);
+            if (path.empty()) path = "Models/mustang.obj";
+
+            std::string report = BenchmarkObjParsers(path).ToString();
+            OutputDebugStringA(report.c_str());
+            MessageBoxA(nullptr, report.c_str(), "OBJ benchmark", MB_OK);
+            return 0;
+        }
+
+        // Xesqe.exe --bench-raycast mede os raios contra o terreno em varios tamanhos de mapa e sai.
+        const std::string benchRaycastFlag = "--bench-raycast";
+        if (cmdLine.compare(0, benchRaycastFlag.size(), benchRaycastFlag) == 0)
+        {
+            const int mapSamples[] = { 257, 1025, 4097 };
+            std::string report = BenchmarkTerrainRaycasts(mapSamples).ToString();
+            OutputDebugStringA(report.c_str());
+            MessageBoxA(nullptr, report.c_str(), "Raycast benchmark", MB_OK);
+            return 0;
+        }
+
         Application theApp(hInstance);
         if (!theApp.Initialize())
             return 0;
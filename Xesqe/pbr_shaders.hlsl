@@ -26,14 +26,27 @@ cbuffer cbWorldMatrix : register(b4)
     float4x4 gWorld;
 };
 
+// Posicao = gPosBias + PosQ * gPosScale (ver VertexQuantization).
+cbuffer cbQuantization : register(b5)
+{
+    float4 gPosScale;
+    float4 gPosBias;
+};
+
+// Material da faixa sendo desenhada (mesmo layout de Material em Mesh.h).
+cbuffer cbMaterial : register(b6)
+{
+    float3 gAlbedo;
+    float gMetallic;
+    float gRoughness;
+    float gAO;
+};
+
+// Mesmo layout de PackedVertex.
 struct VertexIn
 {
-    float3 PosL : POSITION;
-    float3 NormalL : NORMAL;
-    float3 Albedo : ALBEDO;
-    float Metallic : METALLIC;
-    float Roughness : ROUGHNESS;
-    float AO : AO;
+    float4 PosQ : POSITION;
+    float2 NormalOct : NORMAL;
 };
 
 struct VertexOut
@@ -41,22 +54,24 @@ struct VertexOut
     float4 PosH : SV_POSITION;
     float3 PosW : POSITION;
     float3 NormalW : NORMAL;
-    float3 Albedo : ALBEDO;
-    float Metallic : METALLIC;
-    float Roughness : ROUGHNESS;
-    float AO : AO;
 };
 
+float3 DecodeOctahedral(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += (n.xy >= 0.0) ? -t : t;
+    return normalize(n);
+}
+
 VertexOut VS(VertexIn vin)
 {
     VertexOut vout;
-    vout.PosW = mul(float4(vin.PosL, 1.0f), gWorld).xyz;
-    vout.PosH = mul(float4(vin.PosL, 1.0f), gWorldViewProj);
-    vout.NormalW = mul(vin.NormalL, (float3x3) gWorld);
-    vout.Albedo = vin.Albedo;
-    vout.Metallic = vin.Metallic;
-    vout.Roughness = vin.Roughness;
-    vout.AO = vin.AO;
+    float3 posL = gPosBias.xyz + vin.PosQ.xyz * gPosScale.xyz;
+    float3 normalL = DecodeOctahedral(vin.NormalOct);
+    vout.PosW = mul(float4(posL, 1.0f), gWorld).xyz;
+    vout.PosH = mul(float4(posL, 1.0f), gWorldViewProj);
+    vout.NormalW = mul(normalL, (float3x3) gWorld);
     return vout;
 }
 
@@ -97,10 +112,10 @@ float3 FresnelSchlick(float cosTheta, float3 F0)
 
 float4 PS(VertexOut pin) : SV_Target
 {
-    float3 albedo = pin.Albedo;
-    float metallic = pin.Metallic;
-    float roughness = pin.Roughness;
-    float ao = pin.AO;
+    float3 albedo = gAlbedo;
+    float metallic = gMetallic;
+    float roughness = gRoughness;
+    float ao = gAO;
 
     float3 N = normalize(pin.NormalW);
     float3 V = normalize(gCameraPos - pin.PosW);
@@ -1,6 +1,9 @@
 #pragma once
 
 // --- Windows e DirectX ---
+// Fora do Windows (ex.: ObjBench no Linux) so os importadores sao compilados,
+// e eles dependem apenas do DirectXMath.
+#ifdef _WIN32
 #include <windows.h>
 #include <wrl.h>
 #include <dxgi1_6.h>
@@ -9,6 +12,9 @@
 #include <d3dcompiler.h>
 #include <DirectXColors.h>
 #include "d3dx12.h" // Utilitrios do DirectX 12 (d3dx12.h)
+#else
+#include <DirectXMath.h>
+#endif
 
 // --- Biblioteca Padro C++ ---
 #include <string>
@@ -24,10 +30,11 @@
 #include <tuple> // Includo para std::tuple usado no parser de OBJ
 
 // --- Depurao ---
-#if defined(DEBUG) || defined(_DEBUG)
+#if defined(_WIN32) && (defined(DEBUG) || defined(_DEBUG))
 #include <dxgidebug.h>
 #endif
 
+#ifdef _WIN32
 // --- Utilitrios do Projeto ---
 #include "Exception.h" // Sua classe de exceo personalizada
 
@@ -35,4 +42,5 @@
 #pragma comment(lib, "d3d12.lib")
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3dcompiler.lib")
-#pragma comment(lib, "dxguid.lib")
\ No newline at end of file
+#pragma comment(lib, "dxguid.lib")
+#endif
\ No newline at end of file
@@ -0,0 +1,94 @@
+// Terreno CDLOD: a mesma grade de patch para todos os nos, com as alturas
+// lidas de gHeights. Usa os cbuffers e o PS de pbr_shaders.hlsl; gWorldViewProj
+// recebe so view * proj (o terreno ja esta em coordenadas de mundo).
+#include "pbr_shaders.hlsl"
+
+// Mesmo layout de TerrainPatch (TerrainQuadtree.h).
+cbuffer cbTerrainPatch : register(b7)
+{
+    float2 gPatchOrigin;
+    float2 gPatchSize;
+    float gMorphStart;
+    float gMorphEnd;
+    uint gPatchLod;
+    uint gPatchQuarters;
+};
+
+// A amostra (i, j) fica em gHeightOrigin + (i, j) / gHeightInvSpacing.
+cbuffer cbTerrain : register(b8)
+{
+    float2 gHeightOrigin;
+    float2 gHeightInvSpacing;
+    uint2 gHeightCount;
+    float gPatchQuads;
+    float gSkirtDepth;        // em celulas do patch
+};
+
+// Uma linha de amostras (eixo x) apos a outra, como em Terrain.
+StructuredBuffer<float> gHeights : register(t0);
+// Normais de Terrain::ComputeNormals no mesmo layout: x e z em snorm16, y > 0.
+StructuredBuffer<uint> gNormals : register(t1);
+
+struct TerrainVertexIn
+{
+    float2 Grid : POSITION;   // posicao na grade do patch, em [0, 1]
+    float Skirt : SKIRT;      // 1 nos vertices das saias
+};
+
+float LoadHeight(int2 coord)
+{
+    coord = clamp(coord, int2(0, 0), int2(gHeightCount) - 1);
+    return gHeights[coord.x * gHeightCount.y + coord.y];
+}
+
+float SampleHeight(float2 xz)
+{
+    float2 grid = (xz - gHeightOrigin) * gHeightInvSpacing;
+    float2 cell = floor(grid);
+    float2 f = grid - cell;
+    int2 i = int2(cell);
+    float h0 = lerp(LoadHeight(i), LoadHeight(i + int2(1, 0)), f.x);
+    float h1 = lerp(LoadHeight(i + int2(0, 1)), LoadHeight(i + int2(1, 1)), f.x);
+    return lerp(h0, h1, f.y);
+}
+
+float3 LoadNormal(int2 coord)
+{
+    coord = clamp(coord, int2(0, 0), int2(gHeightCount) - 1);
+    uint packed = gNormals[coord.x * gHeightCount.y + coord.y];
+    float2 xz = max(float2(int2(packed << 16, packed) >> 16) / 32767.0, -1.0);
+    return float3(xz.x, sqrt(saturate(1.0 - dot(xz, xz))), xz.y);
+}
+
+float3 SampleNormal(float2 xz)
+{
+    float2 grid = (xz - gHeightOrigin) * gHeightInvSpacing;
+    float2 cell = floor(grid);
+    float2 f = grid - cell;
+    int2 i = int2(cell);
+    float3 n0 = lerp(LoadNormal(i), LoadNormal(i + int2(1, 0)), f.x);
+    float3 n1 = lerp(LoadNormal(i + int2(0, 1)), LoadNormal(i + int2(1, 1)), f.x);
+    return normalize(lerp(n0, n1, f.y));
+}
+
+VertexOut TerrainVS(TerrainVertexIn vin)
+{
+    float2 xz = gPatchOrigin + vin.Grid * gPatchSize;
+    float3 posW = float3(xz.x, SampleHeight(xz), xz.y);
+
+    // Perto do fim da faixa do LOD os vertices impares deslizam ate a grade do
+    // nivel seguinte (metade da resolucao); em gMorphEnd o patch ja e igual ao do pai.
+    float morph = saturate((distance(posW, gCameraPos) - gMorphStart) / (gMorphEnd - gMorphStart));
+    float2 oddOffset = frac(vin.Grid * gPatchQuads * 0.5) * 2.0 / gPatchQuads;
+    xz -= oddOffset * gPatchSize * morph;
+    posW = float3(xz.x, SampleHeight(xz), xz.y);
+
+    // A saia desce da borda na mesma posicao, mais fundo quanto maior a celula do patch.
+    posW.y -= vin.Skirt * gSkirtDepth * gPatchSize.x / gPatchQuads;
+
+    VertexOut vout;
+    vout.PosW = posW;
+    vout.PosH = mul(float4(posW, 1.0f), gWorldViewProj);
+    vout.NormalW = SampleNormal(xz);
+    return vout;
+}